@@ -0,0 +1,78 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Per-thread 64-bit monotonic counters with lock-free snapshots
+
+	A counter block is written by a single thread and read by any other
+	thread. Counters are never reset, readers compute differences between
+	snapshots. 64b words are not written atomically on 32b hosts, so each
+	block carries a sequence number that is odd while the owner updates it
+	and readers retry until they get a copy taken between two updates.
+	Blocks are aligned on cache lines so that two threads updating their own
+	counters do not share a line.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _COUNTERS_H
+#define _COUNTERS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define COUNTERS_CACHE_LINE	64 /* bytes, covers ARM9/Cortex-A and x86 hosts */
+#define COUNTERS_MAX		40 /* max number of counters in one block */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct counters_s {
+	volatile uint32_t seq; /* odd while the owner thread is updating the block */
+	volatile uint64_t value[COUNTERS_MAX]; /* monotonic counters */
+} __attribute__ ((aligned (COUNTERS_CACHE_LINE)));
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open an update of a block, only called by the thread owning the block
+*/
+static inline void counters_begin(struct counters_s * c) {
+	c->seq += 1;
+	__sync_synchronize();
+}
+
+/**
+@brief Add a value to a counter, only between counters_begin and counters_end
+*/
+static inline void counters_add(struct counters_s * c, int idx, uint64_t value) {
+	c->value[idx] += value;
+}
+
+/**
+@brief Close an update of a block
+*/
+static inline void counters_end(struct counters_s * c) {
+	__sync_synchronize();
+	c->seq += 1;
+}
+
+/**
+@brief Get a consistent copy of the first counters of a block, can be called from any thread
+@param c pointer to the block
+@param out array receiving the counter values
+@param nb number of counters to copy (max COUNTERS_MAX)
+*/
+void counters_snapshot(const struct counters_s * c, uint64_t * out, int nb);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
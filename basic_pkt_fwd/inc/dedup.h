@@ -0,0 +1,68 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Short time-window detection of duplicate uplinks
+
+	The concentrator may report the same frame on two IF chains (adjacent
+	channels) with nearly the same timestamp. Recent frames are kept in a
+	small fixed-size open-addressing table keyed by payload CRC and size: a
+	key is looked up in DEDUP_WAYS consecutive slots, and a new entry takes an
+	empty or expired slot, or the oldest one. A frame is a duplicate if an
+	entry with the same key has a timestamp (count_us) within the window.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _DEDUP_H
+#define _DEDUP_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define DEDUP_SLOTS		64 /* power of two, a few times the frames received in a window */
+#define DEDUP_WAYS		4 /* slots probed for a key */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct dedup_entry_s {
+	uint32_t count_us; /* timestamp of the frame */
+	uint16_t crc; /* payload CRC */
+	uint16_t size; /* payload size, 0 = empty slot */
+};
+
+struct dedup_s {
+	uint32_t window_us; /* max timestamp difference of two copies of a frame */
+	struct dedup_entry_s slot[DEDUP_SLOTS];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty a table and set its time window
+*/
+void dedup_init(struct dedup_s * d, uint32_t window_us);
+
+/**
+@brief Check if a frame is a copy of a recent one, and remember it otherwise
+@param d pointer to the table (only used by one thread)
+@param crc payload CRC of the frame
+@param size payload size of the frame
+@param count_us concentrator timestamp of the frame
+@return true if a frame with the same CRC and size was seen within the window
+*/
+bool dedup_check(struct dedup_s * d, uint16_t crc, uint16_t size, uint32_t count_us);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
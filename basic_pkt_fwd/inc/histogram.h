@@ -0,0 +1,95 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Log-linear histograms for latency measurements
+
+	A histogram is written by a single thread and read by any other thread
+	without lock: bucket counters only ever increase (32b words are read and
+	written atomically), readers take a snapshot and compute the difference
+	with a previous snapshot to get the distribution over an interval.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define HIST_SUB_BITS	4 /* 16 linear sub-buckets per power of 2, ~6% resolution */
+#define HIST_SUB_NB		(1 << HIST_SUB_BITS)
+#define HIST_BUCKET_NB	((32 - HIST_SUB_BITS + 1) * HIST_SUB_NB) /* covers the whole 32b range */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct hist_s {
+	volatile uint32_t count[HIST_BUCKET_NB]; /* monotonic bucket counters */
+	volatile uint32_t sum_seq; /* odd while sum is being updated */
+	volatile uint64_t sum; /* monotonic sum of the recorded values */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Record one value (only one thread must record in a given histogram)
+@param h pointer to the histogram
+@param value value to record (typ. a duration in microseconds)
+*/
+void hist_record(struct hist_s * h, uint32_t value);
+
+/**
+@brief Copy the current state of a histogram, can be called from any thread
+*/
+void hist_snapshot(const struct hist_s * h, struct hist_s * snap);
+
+/**
+@brief Compute the distribution between two snapshots of the same histogram
+@param cur latest snapshot
+@param prev older snapshot (can be the same structure as out)
+@param out histogram receiving cur - prev
+*/
+void hist_delta(const struct hist_s * cur, const struct hist_s * prev, struct hist_s * out);
+
+/**
+@brief Add the content of a histogram to another one (eg. merge per-thread histograms)
+*/
+void hist_merge(struct hist_s * acc, const struct hist_s * h);
+
+/**
+@brief Count the number of values recorded in a histogram (or snapshot)
+*/
+uint32_t hist_total(const struct hist_s * h);
+
+/**
+@brief Get the sum of the values recorded in a histogram (or snapshot)
+*/
+uint64_t hist_sum(const struct hist_s * h);
+
+/**
+@brief Get a percentile of the recorded values
+@param h pointer to the histogram (or snapshot)
+@param pct percentile, between 0 and 100 (100 = max)
+@return highest value equivalent to the bucket containing the percentile, 0 if empty
+*/
+uint32_t hist_percentile(const struct hist_s * h, double pct);
+
+/**
+@brief Get the lowest and highest values counted in a bucket
+*/
+uint32_t hist_bucket_low(int bucket);
+uint32_t hist_bucket_high(int bucket);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,96 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Bloom filter of EUIs (JoinEUI or DevEUI) gating join requests
+
+	The filter is a bit array of a power of two size and a number of hash
+	functions, derived from one 64-bit mix of the EUI (double hashing). It has
+	no false negatives: an EUI that was added is always found, an EUI that was
+	not added is found with a probability set by the number of bits per EUI
+	(about 1% with 10 bits and 7 hashes).
+
+	File format (little endian): "JBF1" magic, number of hashes (1 byte),
+	3 reserved bytes, number of bits (4 bytes), number of EUIs added (4 bytes,
+	informative), then the bit array.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _JOIN_FILTER_H
+#define _JOIN_FILTER_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define JOIN_FILTER_SUCCESS		0
+#define JOIN_FILTER_ERROR		-1
+
+#define JOIN_FILTER_HDR_SIZE	16 /* size of the file header, the bit array follows */
+#define JOIN_FILTER_BITS_MIN	64
+#define JOIN_FILTER_BITS_MAX	(1u << 30) /* 128 MB */
+#define JOIN_FILTER_HASH_MAX	16
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct join_filter_s {
+	uint8_t * bits; /* bit array, NULL if the filter is empty */
+	uint32_t nb_bits; /* power of two */
+	uint32_t nb_keys; /* number of EUIs added */
+	unsigned nb_hash;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Allocate an empty filter
+@param f pointer to the filter
+@param nb_bits size of the bit array, rounded up to a power of two
+@param nb_hash number of hash functions
+@return JOIN_FILTER_SUCCESS, or JOIN_FILTER_ERROR if a parameter is out of range or memory cannot be allocated
+*/
+int join_filter_init(struct join_filter_s * f, uint32_t nb_bits, unsigned nb_hash);
+
+/**
+@brief Free the memory of a filter, it becomes empty
+*/
+void join_filter_free(struct join_filter_s * f);
+
+/**
+@brief Add an EUI to a filter
+*/
+void join_filter_add(struct join_filter_s * f, uint64_t eui);
+
+/**
+@brief Check if an EUI may be in a filter
+@return false if the EUI was never added, true if it was (or for a false positive)
+*/
+bool join_filter_contains(const struct join_filter_s * f, uint64_t eui);
+
+/**
+@brief Load a filter from a file, the filter is only modified on success
+@param f pointer to the filter, its previous content must be freed by the caller
+@param path path of the filter file
+@return JOIN_FILTER_SUCCESS, or JOIN_FILTER_ERROR if the file cannot be read or is malformed
+*/
+int join_filter_load(struct join_filter_s * f, const char * path);
+
+/**
+@brief Save a filter to a file (written to a temporary file, then renamed)
+@return JOIN_FILTER_SUCCESS, or JOIN_FILTER_ERROR if the file cannot be written
+*/
+int join_filter_save(const struct join_filter_s * f, const char * path);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,84 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	LZ77 compression of the JSON body of PUSH_DATA datagrams, with a preset
+	dictionary of the keys and common values of the rxpk objects
+
+	The dictionary is virtually placed before the data, so even the first
+	object of a datagram is coded with back-references to it. The stream is a
+	sequence of literal runs and matches (see PROTOCOL.TXT). The compressor
+	looks for matches in hash chains of 4-byte sequences, the level is the
+	max number of candidates tried at each position: 1 is the fastest, higher
+	levels find longer matches for more CPU.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _JSON_LZ_H
+#define _JSON_LZ_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define JSON_LZ_DICT_RXPK	1 /* identifier of the rxpk dictionary, carried by the datagrams */
+#define JSON_LZ_WINDOW		8192 /* dictionary + data, max data size is that minus the dictionary size */
+#define JSON_LZ_HASH_BITS	11
+#define JSON_LZ_LEVEL_MAX	32
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* compressor state, about 32 kB, not shared between threads */
+struct json_lz_s {
+	unsigned level; /* max number of match candidates per position */
+	unsigned dict_len;
+	uint16_t dict_head[1 << JSON_LZ_HASH_BITS]; /* hash chains of the dictionary alone */
+	uint16_t head[1 << JSON_LZ_HASH_BITS]; /* last position of each hash */
+	uint16_t prev[JSON_LZ_WINDOW]; /* previous position with the same hash */
+	uint8_t buff[JSON_LZ_WINDOW]; /* dictionary followed by the data */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Load the rxpk dictionary in a compressor
+@param lz pointer to the compressor state
+@param level max number of match candidates per position (1 to JSON_LZ_LEVEL_MAX)
+*/
+void json_lz_init(struct json_lz_s * lz, unsigned level);
+
+/**
+@brief Compress a buffer
+@param lz pointer to the compressor state
+@param src data to compress
+@param size size of the data
+@param dst buffer receiving the compressed stream
+@param dst_max size of that buffer
+@return size of the compressed stream, -1 if the data is too large or does not fit in dst
+*/
+int json_lz_compress(struct json_lz_s * lz, const uint8_t * src, int size, uint8_t * dst, int dst_max);
+
+/**
+@brief Decompress a stream
+@param dict dictionary identifier (JSON_LZ_DICT_RXPK)
+@param src compressed stream
+@param size size of the stream
+@param dst buffer receiving the data
+@param dst_max size of that buffer
+@return size of the data, -1 if the stream is invalid or the data does not fit in dst
+*/
+int json_lz_decompress(int dict, const uint8_t * src, int size, uint8_t * dst, int dst_max);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
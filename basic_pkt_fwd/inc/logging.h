@@ -1,6 +1,5 @@
 /* #define PRINTF 1 */
 /* #define SYSLOG 1 */
-/* #define LOG_LEVEL LOG_DEBUG */
 
 /* #define	LOG_EMERG	0	/\* system is unusable *\/ */
 /* #define	LOG_ALERT	1	/\* action must be taken immediately *\/ */
@@ -11,25 +10,67 @@
 /* #define	LOG_INFO	6	/\* informational *\/ */
 /* #define	LOG_DEBUG	7	/\* debug-level messages *\/ */
 
+#ifndef _LOGGING_H
+#define _LOGGING_H
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
 #include <syslog.h>
+
+/* messages less important than LOG_LEVEL are removed at compile time (eg. -DLOG_LEVEL=LOG_INFO) */
+#ifndef LOG_LEVEL
+	#define LOG_LEVEL LOG_DEBUG
+#endif
+
+/*
+While the logging thread runs, LOG only copies the format pointer and the
+arguments (strings included) in a ring of fixed-size records, the formatting
+and the output to stderr/syslog are done by the logging thread. A message with
+more arguments or longer strings than a record holds takes several records,
+up to 8 kB of strings; beyond that its strings are cut and counted. When the
+ring is full, the message is dropped and counted. Before logging_start and
+after logging_stop, messages are formatted and written by the caller.
+*/
 #define LOG(LEVEL, MESSAGE,...)            \
-	if (logging_level >= LEVEL) {          \
-            if (use_syslog) syslog(LEVEL, MESSAGE, ##__VA_ARGS__);     \
-            if (use_printf) fprintf(stderr,"[%s](%s:%d) " MESSAGE ,logging_names[LEVEL], __FILE__, __LINE__,##__VA_ARGS__); \
-	}
-
-
-const char * const logging_names[] = {
-        "EMERGENCY",
-        "ALERT",
-        "PANIC",
-        "ERROR",
-        "WARNING",
-        "NOTICE",
-        "INFO",
-        "DEBUG"
+	do { \
+		if (((LEVEL) <= LOG_LEVEL) && (logging_level >= (LEVEL))) { \
+			logging_push((LEVEL), __FILE__, __LINE__, MESSAGE, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+#define LOG_ENABLED(LEVEL)	(((LEVEL) <= LOG_LEVEL) && (logging_level >= (LEVEL)))
+
+struct logging_counters_s {
+	uint32_t queued; /* messages handed to the logging thread */
+	uint32_t dropped; /* messages lost because the ring was full */
+	uint32_t truncated; /* messages cut, strings or arguments beyond what the records of a message hold */
 };
 
-bool use_syslog = true; //overwritten by configuration file
-bool use_printf = true;// as well
-int logging_level = LOG_DEBUG; //this one also
+extern const char * const logging_names[];
+
+extern bool use_syslog; //overwritten by configuration file
+extern bool use_printf;// as well
+extern int logging_level; //this one also
+
+/**
+@brief Start the logging thread, messages are then written asynchronously
+@return 0 if the thread was started, -1 otherwise (logging stays synchronous)
+*/
+int logging_start(void);
+
+/**
+@brief Write all pending messages, stop the logging thread and go back to synchronous logging
+*/
+void logging_stop(void);
+
+/**
+@brief Queue a message (called by the LOG macro), the format must be a string literal
+*/
+void logging_push(int level, const char * file, int line, const char * format, ...) __attribute__ ((format (printf, 4, 5)));
+
+/**
+@brief Read the logging counters (monotonic, can be called from any thread)
+*/
+void logging_get_counters(struct logging_counters_s * cnt);
+
+#endif
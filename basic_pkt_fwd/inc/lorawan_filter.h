@@ -0,0 +1,131 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	LoRaWAN header pre-parser and DevAddr filter for uplinks
+
+	The MHDR and FHDR of a received frame are parsed in place, without
+	decoding the payload, to get the DevAddr of data frames and the
+	JoinEUI/DevEUI of join requests. A DevAddr is checked against the
+	DevAddr prefixes of a few NetIDs, then against allow and deny lists kept
+	as sorted arrays (binary search). The filter is built once from the
+	configuration and only read afterwards, by any thread.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _LORAWAN_FILTER_H
+#define _LORAWAN_FILTER_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LORAWAN_SUCCESS		0
+#define LORAWAN_ERROR		-1
+
+#define NETID_MAX			16 /* max number of NetIDs accepted by a filter */
+
+#define FCTRL_UP_CLASS_B	0x10 /* uplink FCtrl bit: the device is in class B */
+#define FCTRL_FOPTS_LEN		0x0F /* FCtrl bits: length of the MAC commands in FOpts */
+
+/* message types (MHDR bits 7 to 5) */
+#define MTYPE_JOIN_REQUEST	0
+#define MTYPE_JOIN_ACCEPT	1
+#define MTYPE_UNCONF_UP		2
+#define MTYPE_UNCONF_DOWN	3
+#define MTYPE_CONF_UP		4
+#define MTYPE_CONF_DOWN		5
+#define MTYPE_REJOIN		6
+#define MTYPE_PROPRIETARY	7
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct lorawan_hdr_s {
+	uint8_t mtype; /* message type */
+	uint32_t devaddr; /* device address, data frames only */
+	uint8_t fctrl; /* frame control, data frames only */
+	int fport; /* FPort, -1 if there is no FRMPayload, data frames only */
+	uint64_t join_eui; /* JoinEUI (AppEUI), join requests only */
+	uint64_t dev_eui; /* DevEUI, join requests only */
+};
+
+struct addr_set_s {
+	uint32_t * addr; /* sorted, no duplicates */
+	unsigned nb;
+};
+
+enum devaddr_verdict_e {
+	DEVADDR_PASS, /* allowed, or in one of our NetIDs */
+	DEVADDR_FOREIGN, /* in none of our NetIDs */
+	DEVADDR_DENIED /* in the deny list */
+};
+
+struct devaddr_filter_s {
+	unsigned nb_netid;
+	uint32_t prefix[NETID_MAX]; /* DevAddr prefix of each NetID, left aligned */
+	uint32_t mask[NETID_MAX]; /* bits of the prefix */
+	struct addr_set_s allow; /* DevAddr always forwarded (eg. roaming devices) */
+	struct addr_set_s deny; /* DevAddr never forwarded */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Parse the LoRaWAN header of a frame
+@param payload pointer to the PHYPayload
+@param size size of the PHYPayload in bytes
+@param hdr pointer to the structure receiving the header fields
+@return LORAWAN_SUCCESS, or LORAWAN_ERROR if it is not a LoRaWAN R1 frame of a valid size for its type
+*/
+int lorawan_parse(const uint8_t * payload, unsigned size, struct lorawan_hdr_s * hdr);
+
+/**
+@brief Build a set from an array of addresses (sorted and deduplicated in a copy)
+@return LORAWAN_SUCCESS, or LORAWAN_ERROR if memory cannot be allocated
+*/
+int addr_set_init(struct addr_set_s * set, const uint32_t * addr, unsigned nb);
+
+/**
+@brief Free the memory of a set
+*/
+void addr_set_free(struct addr_set_s * set);
+
+/**
+@brief Look for an address in a set (binary search)
+*/
+bool addr_set_contains(const struct addr_set_s * set, uint32_t addr);
+
+/**
+@brief Get the DevAddr prefix of a NetID
+@param netid 24-bit NetID (3-bit type, then the NwkID in the least significant bits)
+@param prefix pointer receiving the prefix, left aligned
+@param mask pointer receiving the mask of the prefix bits
+*/
+void netid_devaddr_prefix(uint32_t netid, uint32_t * prefix, uint32_t * mask);
+
+/**
+@brief Add the DevAddr prefix of a NetID to a filter
+@param f pointer to the filter
+@param netid 24-bit NetID (3-bit type, then the NwkID in the least significant bits)
+@return LORAWAN_SUCCESS, or LORAWAN_ERROR if there are already NETID_MAX NetIDs
+*/
+int devaddr_filter_add_netid(struct devaddr_filter_s * f, uint32_t netid);
+
+/**
+@brief Check a DevAddr: deny list first, then allow list, then NetID prefixes (all pass if there is none)
+*/
+enum devaddr_verdict_e devaddr_filter_check(const struct devaddr_filter_s * f, uint32_t devaddr);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,94 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Local metrics export, minimal HTTP listener serving the forwarder
+	counters, gauges and histograms in the Prometheus text format
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+#include "histogram.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define METRICS_SUCCESS	0
+#define METRICS_ERROR	-1
+
+#define METRICS_BUFF_SIZE	32768 /* initial size of the exposition page, doubled when needed */
+#define METRICS_BUFF_MAX	1048576 /* max size of one exposition page */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct metrics_buf_s {
+	char * data; /* allocated, kept from one scrape to the next */
+	int size; /* size of data */
+	int len; /* number of bytes used in data */
+	bool full; /* data could not grow, the rest of the page is dropped */
+};
+
+/**
+@brief Callback filling the exposition page, called by the listener thread for each scrape
+*/
+typedef void (*metrics_render_t)(struct metrics_buf_s * mb);
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open a TCP listener on the loopback interface and start serving metrics
+@param port TCP port number (string)
+@param render callback that fills the page, must not take any mutex of the packet path
+@return METRICS_SUCCESS, or METRICS_ERROR if the listener could not be started
+*/
+int metrics_start(const char * port, metrics_render_t render);
+
+/**
+@brief Stop the listener thread and close its socket
+*/
+void metrics_stop(void);
+
+/**
+@brief Get the number of pages cut because the page buffer could not grow (monotonic)
+*/
+uint32_t metrics_truncated(void);
+
+/**
+@brief Append printf-formatted text to the page (the page grows as needed, it is cut between two appends if it cannot)
+*/
+void metrics_printf(struct metrics_buf_s * mb, const char * format, ...);
+
+/**
+@brief Append the HELP and TYPE lines of a metric family
+@param type "counter", "gauge" or "histogram"
+*/
+void metrics_family(struct metrics_buf_s * mb, const char * name, const char * type, const char * help);
+
+/**
+@brief Append one sample of a counter or gauge family
+@param labels label set without braces (eg. "stage=\"up\""), NULL for none
+*/
+void metrics_sample(struct metrics_buf_s * mb, const char * name, const char * labels, uint64_t value);
+
+/**
+@brief Append one histogram series from a snapshot of microsecond values, exported in seconds
+@param labels label set without braces, NULL for none
+*/
+void metrics_histogram(struct metrics_buf_s * mb, const char * name, const char * labels, const struct hist_s * snap);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
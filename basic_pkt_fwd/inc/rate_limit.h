@@ -0,0 +1,102 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Per-device uplink rate limiting with token buckets
+
+	Each DevAddr has a bucket of tokens, refilled at a constant rate up to a
+	burst size, and a packet takes one token. Buckets are kept in a bounded
+	hash table (chaining by index, no allocation): when the table is full, the
+	least recently used bucket is evicted, so a device that comes back starts
+	with a full bucket. Tokens are counted in thousandths (fixed point).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _RATE_LIMIT_H
+#define _RATE_LIMIT_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RATE_TABLE_SIZE		1024 /* max number of devices tracked */
+#define RATE_HASH_SIZE		1024 /* power of two */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct rate_limit_s {
+	uint32_t per_hour; /* packets per hour in the long run */
+	uint32_t burst; /* packets accepted at once after a silence */
+	uint32_t downsample; /* over the limit, forward 1 packet in N, 0 = drop them all */
+};
+
+enum rate_verdict_e {
+	RATE_PASS, /* under the limit */
+	RATE_SAMPLED, /* over the limit, forwarded by the downsampling */
+	RATE_DROP /* over the limit, dropped */
+};
+
+struct rate_bucket_s {
+	uint32_t devaddr;
+	uint32_t mtokens; /* tokens available, in thousandths */
+	uint64_t last_ms; /* time of the last refill */
+	uint32_t over; /* packets over the limit since the bucket was created */
+	uint32_t dropped; /* packets dropped since the last report */
+	uint16_t hash_next; /* next bucket of the same hash chain */
+	uint16_t lru_prev; /* more recently used bucket */
+	uint16_t lru_next; /* less recently used bucket */
+};
+
+struct rate_table_s {
+	struct rate_bucket_s b[RATE_TABLE_SIZE];
+	uint16_t head[RATE_HASH_SIZE]; /* first bucket of each hash chain */
+	uint16_t lru_first; /* most recently used */
+	uint16_t lru_last; /* least recently used, evicted first */
+	unsigned nb; /* buckets in use */
+	uint32_t evictions;
+};
+
+struct rate_offender_s {
+	uint32_t devaddr;
+	uint32_t dropped;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty a table
+*/
+void rate_table_init(struct rate_table_s * t);
+
+/**
+@brief Take a token from the bucket of a device (created full if needed)
+@param t pointer to the table
+@param devaddr device address
+@param lim limits that apply to the device
+@param now_ms monotonic time in ms
+@return RATE_PASS, or RATE_SAMPLED/RATE_DROP for a packet over the limit
+*/
+enum rate_verdict_e rate_check(struct rate_table_s * t, uint32_t devaddr, const struct rate_limit_s * lim, uint64_t now_ms);
+
+/**
+@brief Get the devices with the most packets dropped since the last call, and reset those counts
+@param t pointer to the table
+@param top array receiving the offenders, most packets dropped first
+@param nb_max size of the array
+@return number of offenders written
+*/
+unsigned rate_top_offenders(struct rate_table_s * t, struct rate_offender_s * top, unsigned nb_max);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
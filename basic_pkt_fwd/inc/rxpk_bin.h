@@ -0,0 +1,73 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Compact binary encoding of the received packets carried by PUSH_DATA_BIN
+	datagrams (see PROTOCOL.TXT for the record layout)
+
+	A record is a fixed 7-byte header (status, modulation, channel, datarate,
+	coding rate, RSSI, SNR), followed by varint fields and the raw payload.
+	Timestamps and frequency are coded as differences with the previous
+	record of the datagram, so the encoder keeps a small state that must be
+	reset at the start of each datagram.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _RXPK_BIN_H
+#define _RXPK_BIN_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RXPK_BIN_MAX_SIZE	300 /* max size of the record of one packet (255-byte payload) */
+
+/* record header, byte 0 */
+#define RXPK_BIN_STAT_OK	0x00 /* CRC OK, "stat":1 in JSON */
+#define RXPK_BIN_STAT_BAD	0x01 /* CRC error, "stat":-1 */
+#define RXPK_BIN_STAT_NOCRC	0x02 /* no CRC, "stat":0 */
+#define RXPK_BIN_STAT_MASK	0x03
+#define RXPK_BIN_FSK		0x04 /* FSK modulation, Lora otherwise */
+#define RXPK_BIN_TIME		0x08 /* the record has a UTC time */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* fields of the previous record of the datagram */
+struct rxpk_bin_s {
+	uint32_t tmst;
+	uint64_t time_us;
+	uint32_t freq_hz;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Reset the encoder state, before the first record of a datagram
+*/
+void rxpk_bin_reset(struct rxpk_bin_s * ctx);
+
+/**
+@brief Encode the metadata and payload of a packet as a binary record
+@param ctx encoder state of the datagram, updated
+@param p pointer to the received packet
+@param time_us UTC reception time in microseconds since 1970, 0 if unknown
+@param buff buffer receiving the record, RXPK_BIN_MAX_SIZE bytes at least
+@return size of the record, or -1 if a field has a value that cannot be encoded
+*/
+int rxpk_bin_serialize(struct rxpk_bin_s * ctx, const struct lgw_pkt_rx_s * p, uint64_t time_us, uint8_t * buff);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
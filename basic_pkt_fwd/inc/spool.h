@@ -0,0 +1,79 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Persistent store-and-forward queue for upstream datagrams
+
+	Datagrams are stored in a ring inside a memory-mapped file of bounded
+	size, so they survive a restart of the program. When the ring is full the
+	oldest datagrams are discarded. Only one thread must use the spool.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _SPOOL_H
+#define _SPOOL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define SPOOL_SUCCESS	0
+#define SPOOL_ERROR		-1
+
+#define SPOOL_SIZE_MIN	65536 /* bytes, smallest data area accepted */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open (or create) the spool file and map it in memory
+@param path path of the spool file
+@param size size of the data area in bytes (rounded down to a multiple of 4)
+@return SPOOL_SUCCESS, or SPOOL_ERROR if the file cannot be created or mapped
+
+Datagrams stored by a previous run are kept if the file was created with the
+same size, otherwise the spool is emptied.
+*/
+int spool_open(const char * path, uint32_t size);
+
+/**
+@brief Flush and unmap the spool file
+*/
+void spool_close(void);
+
+/**
+@brief Store a datagram at the end of the queue, discarding the oldest ones if needed
+@param dgram pointer to the datagram
+@param size size of the datagram in bytes (max a quarter of the data area)
+@return number of datagrams discarded to make room, SPOOL_ERROR if not stored
+*/
+int spool_push(const uint8_t * dgram, int size);
+
+/**
+@brief Copy the oldest datagram of the queue, without removing it
+@param dgram buffer receiving the datagram
+@param max_size size of the buffer
+@return size of the datagram, 0 if the queue is empty, SPOOL_ERROR if the buffer is too small
+*/
+int spool_peek(uint8_t * dgram, int max_size);
+
+/**
+@brief Remove the oldest datagram of the queue
+*/
+void spool_pop(void);
+
+/**
+@brief Get the number of datagrams in the queue (0 if the spool is not open)
+*/
+uint32_t spool_count(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
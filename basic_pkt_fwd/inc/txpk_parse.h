@@ -0,0 +1,99 @@
+/*
+  (C)2013 Semtech-Cycleo, decoding code moved from basic_pkt_fwd.c
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Decoding of the JSON "txpk" object carried by PULL_RESP datagrams
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _TXPK_PARSE_H
+#define _TXPK_PARSE_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+#include "parson.h"
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define MIN_LORA_PREAMB	6 /* minimum Lora preamble length for this application */
+
+/* return codes of the decoding functions, see txpk_strerror() for meaning */
+enum txpk_status {
+	TXPK_OK = 0,
+	TXPK_ERR_JSON,
+	TXPK_ERR_NO_TXPK,
+	TXPK_ERR_TX_MODE,
+	TXPK_ERR_NO_FREQ,
+	TXPK_ERR_NO_RFCH,
+	TXPK_ERR_NO_MODU,
+	TXPK_ERR_MODU,
+	TXPK_ERR_FSK,
+	TXPK_ERR_NO_DATR,
+	TXPK_ERR_DATR,
+	TXPK_ERR_DATR_SF,
+	TXPK_ERR_DATR_BW,
+	TXPK_ERR_NO_CODR,
+	TXPK_ERR_CODR,
+	TXPK_ERR_NO_SIZE,
+	TXPK_ERR_NO_DATA,
+	TXPK_STATUS_NB
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Decode a Lora "datr" string (eg. "SF7BW125") into datarate & bandwidth
+@param str null-terminated "datr" string
+@param txpkt pointer to the TX structure that receives datarate and bandwidth
+@return TXPK_OK, or TXPK_ERR_DATR* in case of format error
+*/
+int txpk_parse_datr(const char * str, struct lgw_pkt_tx_s * txpkt);
+
+/**
+@brief Decode a Lora "codr" string (eg. "4/5") into a coderate
+@param str null-terminated "codr" string
+@param coderate pointer to the variable that receives the coderate
+@return TXPK_OK, or TXPK_ERR_CODR in case of format error
+*/
+int txpk_parse_codr(const char * str, uint8_t * coderate);
+
+/**
+@brief Fill a TX structure from an already parsed "txpk" JSON object
+@param txpk_obj pointer to the "txpk" JSON object
+@param txpkt pointer to the TX structure to fill (reset by the function)
+@param data_size pointer to the variable receiving the number of decoded payload bytes (can differ from txpkt->size)
+@return TXPK_OK, or an error code if a mandatory field is missing or invalid
+
+The TX mode is set to IMMEDIATE or TIMESTAMPED depending on the "imme" and
+"tmst" fields.
+*/
+int txpk_parse_obj(const JSON_Object * txpk_obj, struct lgw_pkt_tx_s * txpkt, int * data_size);
+
+/**
+@brief Fill a TX structure from the JSON payload of a PULL_RESP datagram
+@param json null-terminated JSON string (PULL_RESP datagram minus its 4-byte header)
+@param txpkt pointer to the TX structure to fill (reset by the function)
+@param data_size pointer to the variable receiving the number of decoded payload bytes (can differ from txpkt->size)
+@return TXPK_OK, or an error code describing why the datagram was rejected
+*/
+int txpk_parse(const char * json, struct lgw_pkt_tx_s * txpkt, int * data_size);
+
+/**
+@brief Get a human-readable description of a decoding return code
+*/
+const char * txpk_strerror(int status);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
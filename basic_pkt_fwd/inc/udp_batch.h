@@ -0,0 +1,51 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Batched UDP send and receive, one sendmmsg/recvmmsg system call for
+	several datagrams when the C library and the kernel support it
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _UDP_BATCH_H
+#define _UDP_BATCH_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <sys/socket.h>	/* msghdr */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UDP_BATCH_MAX	16 /* max nb of datagrams per system call */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Send several datagrams on a socket, with as few system calls as possible
+@param msgs messages to send (a failed message does not prevent the next ones from being sent)
+@param nb number of messages
+@param flags send flags (eg. MSG_DONTWAIT)
+@param syscalls incremented by the number of system calls made
+@return number of datagrams sent
+*/
+int udp_send_batch(int sock, struct msghdr * msgs, int nb, int flags, unsigned * syscalls);
+
+/**
+@brief Receive the datagrams already waiting on a socket, without blocking
+@param msgs messages to fill (msg_iov must point to the receive buffers)
+@param lens filled with the size of each datagram received
+@param nb max number of datagrams to receive
+@param syscalls incremented by the number of system calls made
+@return number of datagrams received, less than nb if there is no more to read
+*/
+int udp_recv_batch(int sock, struct msghdr * msgs, int * lens, int nb, unsigned * syscalls);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
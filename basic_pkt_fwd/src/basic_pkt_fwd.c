@@ -31,7 +31,7 @@ Maintainer: Sylvain Miermont
 
 #include <string.h>		/* memset */
 #include <signal.h>		/* sigaction */
-#include <time.h>		/* time, clock_gettime, strftime, gmtime */
+#include <time.h>		/* time, clock_gettime, strftime, gmtime, nanosleep */
 #include <sys/time.h>	/* timeval */
 #include <unistd.h>		/* getopt, access */
 #include <stdlib.h>		/* atoi, exit */
@@ -39,6 +39,9 @@ Maintainer: Sylvain Miermont
 
 
 #include <sys/socket.h> /* socket specific definitions */
+#include <sys/uio.h>	/* iovec */
+#include <sys/stat.h>	/* stat */
+#include <poll.h>		/* poll */
 #include <netinet/in.h> /* INET constants and stuff */
 #include <arpa/inet.h>  /* IP address conversion stuff */
 #include <netdb.h>		/* gai_strerror */
@@ -51,6 +54,19 @@ Maintainer: Sylvain Miermont
 #include "loragw_hal.h"
 #include "loragw_aux.h"
 #include "logging.h"
+#include "txpk_parse.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "counters.h"
+#include "spool.h"
+#include "udp_batch.h"
+#include "lorawan_filter.h"
+#include "join_filter.h"
+#include "dedup.h"
+#include "rate_limit.h"
+#include "rxpk_bin.h"
+#include "json_lz.h"
+#include "timestamp.h"
 
 
 /* -------------------------------------------------------------------------- */
@@ -76,7 +92,18 @@ Maintainer: Sylvain Miermont
 #define DEFAULT_STAT		30	/* default time interval for statistics */
 #define PUSH_TIMEOUT_MS		100
 #define PULL_TIMEOUT_MS		200
-#define FETCH_SLEEP_MS		10	/* nb of ms waited when a fetch return no packets */
+#define DW_BATCH			8	/* max nb of downstream datagrams read per system call */
+#define FETCH_SLEEP_MS		10	/* default max nb of ms waited between two fetches when no packets are received */
+#define POLL_SPIN			2	/* nb of fetches done without waiting after a fetch that returned packets */
+#define POLL_MIN_US			500	/* first wait after those, then doubled at each empty fetch */
+#define DEFAULT_PUSH_RETRIES	2	/* nb of retransmissions of an unacknowledged PUSH_DATA */
+#define PUSH_POOL_MAX		256	/* max nb of PUSH_DATA datagrams waiting for an acknowledge (size of the arrays) */
+#define DEFAULT_PUSH_POOL	64	/* default nb of PUSH_DATA datagrams waiting for an acknowledge */
+#define DEST_MAX			4	/* max nb of upstream destinations, primary server included */
+#define DEFAULT_SPOOL_SIZE	4194304	/* size of the spool for unacknowledged datagrams, in bytes */
+#define DEFAULT_REPLAY_RATE	10	/* max nb of spooled datagrams replayed per second */
+#define PUSH_PROBE_MS		60000	/* interval between two probes of a destination that does not accept the configured encoding */
+#define DEFAULT_LZ_LEVEL	4	/* max number of match candidates per position of the PUSH_DATA compression */
 
 #define	PROTOCOL_VERSION	1
 
@@ -85,10 +112,40 @@ Maintainer: Sylvain Miermont
 #define PKT_PULL_DATA	2
 #define PKT_PULL_RESP	3
 #define PKT_PULL_ACK	4
+#define PKT_PUSH_DATA_BIN	6
+#define PKT_PUSH_DATA_LZ	7
 
-#define	NB_PKT_MAX		8 /* max number of packets per fetch/send cycle */
-
-#define MIN_LORA_PREAMB	6 /* minimum Lora preamble length for this application */
+#ifdef LGW_PKT_FIFO_SIZE
+	#define NB_PKT_MAX	LGW_PKT_FIFO_SIZE /* max number of packets per fetch: the whole concentrator FIFO */
+#else
+	#define NB_PKT_MAX	16
+#endif
+#define DEFAULT_FETCH_BATCH	8 /* default number of packets per fetch */
+#define FETCH_BATCH_MIN	2 /* smallest batch in adaptive mode */
+#define UP_BUFF_SIZE	5000 /* max size of an upstream datagram */
+#define RXPK_MAX_SIZE	600 /* max size of the JSON object of one packet (255-byte payload) */
+#define RXPK_FRAG_NB	16 /* pre-rendered rxpk fragments, a gateway sees 8 to 10 channel/datarate combinations */
+#define RXPK_FRAG_SIZE	96 /* max size of a fragment, from "chan" to "codr" */
+#define DEFAULT_COALESCE_SIZE	1400 /* max size of a coalesced datagram, under a typical path MTU */
+
+#define DEFAULT_DEDUP_WINDOW	3000 /* max count_us difference of two copies of a frame, in us */
+
+#define RATE_RULES_MAX		8 /* max number of per-device rate limit rules */
+#define TOP_OFFENDERS		5 /* devices listed in the report */
+
+/* uplink priority classes, the lowest number is served first */
+enum prio_e {
+	PRIO_HIGH, /* join requests, uplinks carrying MAC commands */
+	PRIO_MEDIUM, /* confirmed data */
+	PRIO_LOW, /* unconfirmed data, CRC error or no CRC, not LoRaWAN */
+	PRIO_NB
+};
+#define DEFAULT_MTU		1500 /* path MTU assumed when the kernel does not know it */
+#define MIN_DGRAM_SIZE	512 /* smallest accepted datagram size limit */
+#define MTU_REFRESH_MS	10000 /* interval between two reads of the path MTU */
+
+#define LORA_MIN_PREAMB	6 /* shortest Lora preamble received by the concentrator, in symbols */
+#define FSK_MIN_BITS	96 /* shortest FSK packet: 5-byte preamble, 3-byte sync word, length, 1-byte payload, CRC */
 
 #define DOWNSTREAM 1
 #define UPSTREAM 0
@@ -112,44 +169,246 @@ static char serv_port_up[8] = STR(DEFAULT_PORT_UP); /* server port for upstream
 static char serv_port_down[8] = STR(DEFAULT_PORT_DW); /* server port for downstream traffic */
 static int keepalive_time = DEFAULT_KEEPALIVE; /* send a PULL_DATA request every X seconds, negative = disabled */
 
+/* upstream encoding configuration variables */
+static uint8_t push_alt = 0; /* PKT_PUSH_DATA_BIN or PKT_PUSH_DATA_LZ, sent once every destination acknowledged a probe of that type, 0 = JSON PUSH_DATA only */
+static unsigned push_lz_level = DEFAULT_LZ_LEVEL; /* compression level of PUSH_DATA_LZ */
+static struct json_lz_s push_lz; /* PUSH_DATA_LZ compressor, only used by the upstream thread */
+
+/* store-and-forward configuration variables */
+static char spool_path[256] = ""; /* file keeping unacknowledged datagrams, empty = disabled */
+static uint32_t spool_size = DEFAULT_SPOOL_SIZE; /* max size of the spool, in bytes */
+static unsigned replay_rate = DEFAULT_REPLAY_RATE; /* max nb of spooled datagrams replayed per second */
+
+/* uplink coalescing configuration variables */
+static unsigned coalesce_ms = 0; /* max time a packet waits for the next ones to share a datagram, 0 = no coalescing */
+static unsigned coalesce_size = UP_BUFF_SIZE; /* byte budget of a datagram (DEFAULT_COALESCE_SIZE when coalescing) */
+
+/* duplicate and ghost suppression configuration variables */
+static uint32_t dedup_window_us = DEFAULT_DEDUP_WINDOW; /* 0 = duplicates are forwarded */
+static bool fwd_ghosts = false; /* Lora packets without coding rate (mostly false syncs) are forwarded */
+
+/* congestion control configuration variables, thresholds in PUSH_DATA datagrams waiting for an acknowledge */
+static int shed_low_pending = 0; /* low priority packets are dropped from that number, 0 = never */
+static int shed_medium_pending = 0; /* medium priority packets are dropped from that number, 0 = never */
+
+/* LoRaWAN filter configuration variables */
+static bool lorawan_filter_on = false; /* parse the LoRaWAN header of the uplinks to filter them */
+static bool fwd_non_lorawan = true; /* frames that cannot be parsed as LoRaWAN are forwarded */
+static struct devaddr_filter_s devaddr_filter; /* NetIDs, DevAddr allow and deny lists */
+static char join_filter_path[256] = ""; /* Bloom filter of the JoinEUI/DevEUI of our devices, empty = joins not filtered */
+
+/* per-device rate limits of the data uplinks, the first matching rule applies */
+static struct {
+	uint32_t prefix; /* DevAddr prefix of the NetID, 0 with a 0 mask for any NetID */
+	uint32_t mask;
+	int class_b; /* 1: class B devices, 0: the others, -1: any */
+	struct rate_limit_s lim;
+} rate_rule[RATE_RULES_MAX];
+static int nb_rate_rule = 0; /* 0 = no rate limiting */
+
+/* packet fetch configuration variables */
+static bool fetch_adaptive = false; /* size each fetch from the recent FIFO occupancy */
+static volatile unsigned fetch_batch = DEFAULT_FETCH_BATCH; /* max number of packets per fetch, updated by thread_up in adaptive mode */
+
+/* packet polling configuration variables */
+static uint32_t poll_max_us = 1000 * FETCH_SLEEP_MS; /* max wait between two fetches when idle */
+static bool poll_airtime = false; /* max wait set to the shortest airtime of a packet on the enabled channels */
+static uint32_t airtime_min_us = 0; /* shortest airtime of a packet on the enabled channels, 0 = unknown */
+
+/* datagram size configuration variables */
+static unsigned dgram_size_cfg = 0; /* configured max size of an upstream datagram (UDP payload), 0 = from the path MTU */
+static volatile unsigned dgram_size_max = DEFAULT_MTU - 28; /* size limit in use, updated by thread_up */
+
 /* statistics collection configuration variables */
 static unsigned stat_interval = DEFAULT_STAT; /* time interval (in sec) at which statistics are collected and displayed */
+static char metrics_port[8] = ""; /* local TCP port of the metrics listener, empty = disabled */
 
 /* gateway <-> MAC protocol variables */
 static uint32_t net_mac_h; /* Most Significant Nibble, network order */
 static uint32_t net_mac_l; /* Least Significant Nibble, network order */
 
 /* network sockets */
-static int sock_up; /* socket for upstream traffic */
 static int sock_down; /* socket for downstream traffic */
 
 /* network protocol variables */
-static struct timeval push_timeout_half = {0, (PUSH_TIMEOUT_MS * 500)}; /* cut in half, critical for throughput */
-static struct timeval pull_timeout = {0, (PULL_TIMEOUT_MS * 1000)}; /* non critical for throughput */
+static unsigned push_timeout_ms = PUSH_TIMEOUT_MS; /* time-out of the first emission, doubled at each retransmission */
+static unsigned push_retries = DEFAULT_PUSH_RETRIES; /* nb of retransmissions before giving up */
+static int push_pool_size = DEFAULT_PUSH_POOL; /* nb of PUSH_DATA datagrams kept until acknowledged, per destination */
+
+/* server reachability */
+static volatile time_t last_pull_ack = 0; /* time of the last PULL_ACK received (written by thread_down) */
+static bool link_up = true; /* last PUSH_DATA was acknowledged (only used by thread_up) */
+static time_t link_down_time = 0; /* time when a PUSH_DATA was last given up (only used by thread_up) */
+
+/* PUSH_DATA datagrams waiting for an acknowledge (only used by thread_up, no allocation) */
+struct push_slot_s {
+	bool used;
+	bool replay; /* datagram read from the spool */
+	bool queued; /* waiting in the emission queue of its destination */
+	uint8_t hdr[12]; /* header with the token of that destination, kept for retransmissions */
+	int body; /* index of the datagram in push_body */
+	unsigned attempts; /* nb of emissions so far */
+	uint64_t deadline_ms; /* retransmit or give up after that time */
+	struct timespec send_time; /* first emission */
+};
+static struct {
+	int refs; /* nb of slots (all destinations) sending that datagram */
+	uint32_t seq; /* allocation order, the oldest datagram is evicted first */
+	int size;
+	uint8_t * dgram; /* stored once, whatever the nb of destinations */
+} push_body[PUSH_POOL_MAX];
+static uint8_t push_buff[PUSH_POOL_MAX + 3][UP_BUFF_SIZE]; /* datagram buffers, exchanged between push_body and the ones thread_up fills (pending, compressed, replayed datagram) */
+static uint32_t push_body_seq = 0;
+static bool replay_in_flight = false; /* the head of the spool is in the pool */
+
+/* upstream destinations: dest[0] is the primary server (also used for downstream and for the spool), the others receive a copy of the uplinks */
+static struct {
+	char addr[64]; /* host name or IPv4/IPv6 */
+	char port_up[8];
+	int sock; /* connected socket for upstream traffic */
+	struct push_slot_s pool[PUSH_POOL_MAX]; /* tokens are unique per destination */
+	int pool_used;
+	int out[PUSH_POOL_MAX]; /* slots to send at the next flush, in order */
+	int out_nb;
+	bool alt_ok; /* a probe of the configured encoding was acknowledged, and no datagram in that encoding given up since */
+	bool probe_pending; /* probe sent, waiting for its acknowledge */
+	uint8_t probe_hdr[12]; /* header of the last probe, with its token */
+	uint64_t next_probe_ms; /* time of the next probe */
+	struct counters_s cnt; /* written by thread_up */
+} dest[DEST_MAX];
+static int nb_dest = 1;
+
+/* pre-rendered JSON of the channel, RF chain, frequency, status, modulation, datarate and coding rate of the packets (only used by thread_up) */
+static struct {
+	bool used;
+	uint8_t if_chain;
+	uint8_t rf_chain;
+	uint32_t freq_hz;
+	uint8_t status;
+	uint8_t modulation;
+	uint32_t datarate;
+	uint8_t bandwidth;
+	uint8_t coderate;
+	int size;
+	uint8_t json[RXPK_FRAG_SIZE];
+} rxpk_frag[RXPK_FRAG_NB];
+static int rxpk_frag_next = 0; /* entry replaced when they are all used */
+static uint32_t rxpk_frag_plan = 0; /* channel plan the fragments were rendered for */
+static volatile uint32_t channel_plan = 0; /* incremented at each load of the channel plan, empties the fragments */
 
 /* hardware access control and correction */
 static pthread_mutex_t mx_concent = PTHREAD_MUTEX_INITIALIZER; /* control access to the concentrator */
 
-/* measurements to establish statistics */
-static pthread_mutex_t mx_meas_up = PTHREAD_MUTEX_INITIALIZER; /* control access to the upstream measurements */
-static uint32_t meas_nb_rx_rcv = 0; /* count packets received */
-static uint32_t meas_nb_rx_ok = 0; /* count packets received with PAYLOAD CRC OK */
-static uint32_t meas_nb_rx_bad = 0; /* count packets received with PAYLOAD CRC ERROR */
-static uint32_t meas_nb_rx_nocrc = 0; /* count packets received with NO PAYLOAD CRC */
-static uint32_t meas_up_pkt_fwd = 0; /* number of radio packet forwarded to the server */
-static uint32_t meas_up_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_up_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_up_dgram_sent = 0; /* number of datagrams sent for upstream traffic */
-static uint32_t meas_up_ack_rcv = 0; /* number of datagrams acknowledged for upstream traffic */
-
-static pthread_mutex_t mx_meas_dw = PTHREAD_MUTEX_INITIALIZER; /* control access to the downstream measurements */
-static uint32_t meas_dw_pull_sent = 0; /* number of PULL requests sent for downstream traffic */
-static uint32_t meas_dw_ack_rcv = 0; /* number of PULL requests acknowledged for downstream traffic */
-static uint32_t meas_dw_dgram_rcv = 0; /* count PULL response packets received for downstream traffic */
-static uint32_t meas_dw_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_dw_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_nb_tx_ok = 0; /* count packets emitted successfully */
-static uint32_t meas_nb_tx_fail = 0; /* count packets were TX failed for other reasons */
+/* join filter, (re)loaded by the main thread and read by thread_up */
+static pthread_mutex_t mx_join_filter = PTHREAD_MUTEX_INITIALIZER; /* control access to the join filter */
+static struct join_filter_s join_filter; /* empty (all joins forwarded) until a file is loaded */
+static struct stat join_filter_stat; /* identity of the loaded file, to detect a new version */
+static volatile uint32_t join_filter_loads = 0; /* number of successful loads */
+
+/* per-device token buckets, written by thread_up, offenders read by the main thread */
+static pthread_mutex_t mx_rate_table = PTHREAD_MUTEX_INITIALIZER; /* control access to the token buckets */
+static struct rate_table_s rate_table;
+
+/* measurements to establish statistics (each block is only written by its own thread, no mutex) */
+enum cnt_up_e {
+	CNT_RX_RCV, /* count packets received */
+	CNT_RX_OK, /* count packets received with PAYLOAD CRC OK */
+	CNT_RX_BAD, /* count packets received with PAYLOAD CRC ERROR */
+	CNT_RX_NOCRC, /* count packets received with NO PAYLOAD CRC */
+	CNT_UP_PKT_FWD, /* number of radio packet forwarded to the server */
+	CNT_UP_NETWORK_BYTE, /* sum of UDP bytes sent for upstream traffic */
+	CNT_UP_PAYLOAD_BYTE, /* sum of radio payload bytes sent for upstream traffic */
+	CNT_UP_DGRAM_SENT, /* number of datagrams sent for upstream traffic */
+	CNT_UP_ACK_RCV, /* number of datagrams acknowledged for upstream traffic */
+	CNT_UP_ACK_FIRST, /* number of datagrams acknowledged at the first emission */
+	CNT_UP_ACK_RETRY, /* number of datagrams acknowledged after a retransmission */
+	CNT_UP_RETRANSMIT, /* number of retransmissions */
+	CNT_UP_GIVE_UP, /* number of datagrams never acknowledged */
+	CNT_UP_EVICT, /* number of datagrams dropped from the full pool before their time-out */
+	CNT_UP_SPOOLED, /* number of unacknowledged datagrams stored in the spool */
+	CNT_UP_REPLAYED, /* number of spooled datagrams replayed and acknowledged */
+	CNT_UP_SPOOL_LOST, /* number of spooled datagrams discarded because the spool was full */
+	CNT_UP_SYSCALL, /* number of system calls sending or receiving datagrams (waits excluded) */
+	CNT_UP_IO_DGRAM, /* number of datagrams sent or received by those system calls */
+	CNT_UP_PPD_1, /* number of datagrams carrying 1 packet */
+	CNT_UP_PPD_2, /* number of datagrams carrying 2 packets */
+	CNT_UP_PPD_3_4, /* number of datagrams carrying 3 or 4 packets */
+	CNT_UP_PPD_5_8, /* number of datagrams carrying 5 to 8 packets */
+	CNT_UP_PPD_9_MORE, /* number of datagrams carrying 9 packets or more */
+	CNT_UP_DGRAM_SPLIT, /* number of datagrams closed early so the next packet does not exceed the size limit */
+	CNT_UP_DGRAM_OVERSIZE, /* number of datagrams over the size limit (a single packet too large), fragmented by IP */
+	CNT_UP_WAKEUP, /* number of fetches (the upstream thread wakes up for each of them) */
+	CNT_UP_FETCH, /* number of fetches that returned packets */
+	CNT_UP_FETCH_FULL, /* number of fetches that filled the batch (more packets were probably waiting in the FIFO) */
+	CNT_UP_JSON_PKT, /* number of packets sent in JSON PUSH_DATA datagrams */
+	CNT_UP_BIN_PKT, /* number of packets sent in binary PUSH_DATA_BIN datagrams */
+	CNT_UP_BIN_BYTE, /* sum of UDP bytes of the PUSH_DATA_BIN datagrams */
+	CNT_UP_LZ_PKT, /* number of packets sent in compressed PUSH_DATA_LZ datagrams */
+	CNT_UP_LZ_BYTE, /* sum of UDP bytes of the PUSH_DATA_LZ datagrams */
+	CNT_UP_LZ_JSON_BYTE, /* sum of the sizes of the same datagrams as JSON PUSH_DATA */
+	CNT_UP_COPY_BYTE, /* bytes copied from buffer to buffer once encoded (headers of each destination and compressed datagram) */
+	CNT_UP_NB
+};
+enum cnt_dw_e {
+	CNT_DW_PULL_SENT, /* number of PULL requests sent for downstream traffic */
+	CNT_DW_ACK_RCV, /* number of PULL requests acknowledged for downstream traffic */
+	CNT_DW_DGRAM_RCV, /* count PULL response packets received for downstream traffic */
+	CNT_DW_NETWORK_BYTE, /* sum of UDP bytes received for downstream traffic */
+	CNT_DW_PAYLOAD_BYTE, /* sum of radio payload bytes received for downstream traffic */
+	CNT_TX_OK, /* count packets emitted successfully */
+	CNT_TX_FAIL, /* count packets were TX failed for other reasons */
+	CNT_DW_SYSCALL, /* number of system calls sending or receiving datagrams (waits excluded) */
+	CNT_DW_IO_DGRAM, /* number of datagrams sent or received by those system calls */
+	CNT_DW_NB
+};
+enum cnt_dest_e {
+	CNT_DEST_SENT, /* number of datagrams sent to that destination (retransmissions excluded) */
+	CNT_DEST_NETWORK_BYTE, /* sum of UDP bytes sent to that destination */
+	CNT_DEST_ACK_RCV, /* number of datagrams acknowledged */
+	CNT_DEST_ACK_FIRST, /* number of datagrams acknowledged at the first emission */
+	CNT_DEST_ACK_RETRY, /* number of datagrams acknowledged after a retransmission */
+	CNT_DEST_RETRANSMIT, /* number of retransmissions */
+	CNT_DEST_GIVE_UP, /* number of datagrams never acknowledged */
+	CNT_DEST_EVICT, /* number of datagrams dropped from the full pool before their time-out */
+	CNT_DEST_NB
+};
+enum cnt_flt_e {
+	CNT_FLT_GHOST, /* number of Lora packets without coding rate (CR "OFF", false syncs) */
+	CNT_FLT_DUP, /* number of packets dropped as copies of a recent one */
+	CNT_FLT_NOT_LORAWAN, /* number of frames that could not be parsed as LoRaWAN */
+	CNT_FLT_FOREIGN, /* number of data frames dropped because their DevAddr is in none of our NetIDs */
+	CNT_FLT_DENIED, /* number of data frames dropped because their DevAddr is in the deny list */
+	CNT_FLT_JOIN_FWD, /* number of join requests whose JoinEUI or DevEUI is in the join filter */
+	CNT_FLT_JOIN_DROP, /* number of join requests dropped by the join filter */
+	CNT_FLT_RATE_SAMPLED, /* number of data uplinks over their device limit, forwarded by the downsampling */
+	CNT_FLT_RATE_DROP, /* number of data uplinks dropped because their device is over its limit */
+	CNT_FLT_NB
+};
+static struct counters_s cnt_up; /* written by thread_up */
+static struct counters_s cnt_flt; /* filtering stages, written by thread_up */
+enum cnt_prio_e {
+	CNT_PRIO_FWD = 0, /* number of packets forwarded, + priority class */
+	CNT_PRIO_SHED = PRIO_NB, /* number of packets dropped because of the congestion, + priority class */
+	CNT_PRIO_NB = 2 * PRIO_NB
+};
+static struct counters_s cnt_prio; /* packets by priority class, written by thread_up */
+static struct counters_s cnt_dw; /* written by thread_down */
+static time_t start_time; /* for uptime */
+
+/* latency measurements, in microseconds (each set is only written by its own thread, no mutex) */
+static struct {
+	struct hist_s receive; /* duration of lgw_receive */
+	struct hist_s fetch_send; /* from the end of a fetch to the send of the datagram */
+	struct hist_s push_ack; /* PUSH_DATA to PUSH_ACK round trip */
+	struct hist_s concent; /* wait for the concentrator mutex */
+	struct hist_s poll; /* time between a fetch that returned packets and the previous fetch (max time a packet waited in the FIFO) */
+	struct hist_s compress; /* compression of a PUSH_DATA_LZ */
+} lat_up;
+static struct {
+	struct hist_s pull_ack; /* PULL_DATA to PULL_ACK round trip */
+	struct hist_s pull_resp; /* from PULL_RESP arrival to lgw_send return */
+	struct hist_s concent; /* wait for the concentrator mutex */
+} lat_dw;
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
@@ -164,8 +423,76 @@ static void dump_json(uint8_t * json_buff, int header_size);
 
 static void dump_packet(const uint8_t* payload,int payload_size, uint8_t * json_buff, int header_size, uint8_t stream);
 
+static void dump_payload(const uint8_t* payload,int payload_size, uint8_t stream);
+
+static int render_rxpk_fragment(const struct lgw_pkt_rx_s * p, uint8_t * buff);
+
+static int copy_rxpk_fragment(const struct lgw_pkt_rx_s * p, uint8_t * buff);
+
+static int serialize_rxpk(const struct lgw_pkt_rx_s * p, const char * timestamp, uint8_t * buff_up);
+
+static int start_push_data(uint8_t * buff, uint8_t type);
+
+static void send_push_data(uint8_t ** buff, int size, unsigned nb_pkt, const struct timespec * hold_start);
+
 static int parse_logging_configuration(const char * conf_file);
 
+static uint32_t elapsed_us(const struct timespec * start, const struct timespec * stop);
+
+static void report_latency(const char * name, const struct hist_s * h, struct hist_s * prev, int nb_hist);
+
+static void render_metrics(struct metrics_buf_s * mb);
+
+static uint64_t monotonic_ms(void);
+
+static unsigned fetch_batch_adapt(unsigned batch, int nb_pkt, unsigned * occupancy);
+
+static int parse_addr_list(JSON_Object * obj, const char * name, unsigned nb_digits, struct addr_set_s * set);
+
+static bool uplink_filter(const struct lgw_pkt_rx_s * p, struct dedup_s * dedup, uint64_t now_ms);
+
+static void join_filter_reload(void);
+
+static enum prio_e uplink_priority(const struct lgw_pkt_rx_s * p);
+
+static uint32_t lora_min_airtime_us(uint32_t bw_hz, unsigned sf);
+
+static void airtime_update(uint32_t airtime_us);
+
+static void poll_wait_us(uint32_t wait_us, bool * acks_read);
+
+static int open_socket_up(const char * addr, const char * port);
+
+static unsigned path_mtu_payload(void);
+
+static void push_send(uint8_t ** dgram, int size, bool replay);
+
+static int push_body_alloc(void);
+
+static void push_slot_send(int d, int b, bool replay);
+
+static void push_transmit(int d, int idx);
+
+static void push_flush(void);
+
+static void push_release(int d, int idx);
+
+static void push_give_up(int d, int idx);
+
+static void push_evict(int d, int idx);
+
+static void push_reclaim(int d, int idx, uint64_t now_ms);
+
+static int push_slot_free(int d);
+
+static void push_receive_acks(int timeout_ms);
+
+static void push_retransmit(void);
+
+static void push_probe(void);
+
+static bool push_alt_agreed(void);
+
 /* threads */
 void thread_up(void);
 void thread_down(void);
@@ -264,6 +591,7 @@ int parse_SX1301_configuration(const char * conf_file) {
 	} else {
 		LOG(LOG_DEBUG,"%s does contain a JSON object named %s, parsing SX1301 parameters\n", conf_file, conf_obj_name);
 	}
+	__sync_add_and_fetch(&channel_plan, 1); /* pre-rendered rxpk fragments are now stale */
 	
 	/* set configuration for RF chains */
 	for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
@@ -321,6 +649,7 @@ int parse_SX1301_configuration(const char * conf_file) {
 			ifconf.freq_hz = (int32_t)json_object_dotget_number(conf_obj, param_name);
 			// TODO: handle individual SF enabling and disabling (spread_factor)
 			LOG(LOG_DEBUG,"Lora multi-SF channel %i>  radio %i, IF %i Hz, 125 kHz bw, SF 7 to 12\n", i, ifconf.rf_chain, ifconf.freq_hz);
+			airtime_update(lora_min_airtime_us(125000, 7));
 		}
 		/* all parameters parsed, submitting configuration to the HAL */
 		if (lgw_rxif_setconf(i, ifconf) != LGW_HAL_SUCCESS) {
@@ -363,6 +692,9 @@ int parse_SX1301_configuration(const char * conf_file) {
 				default: ifconf.datarate = DR_UNDEFINED;
 			}
 			LOG(LOG_NOTICE,"Lora std channel> radio %i, IF %i Hz, %u Hz bw, SF %u\n", ifconf.rf_chain, ifconf.freq_hz, bw, sf);
+			if ((ifconf.bandwidth != BW_UNDEFINED) && (ifconf.datarate != DR_UNDEFINED)) {
+				airtime_update(lora_min_airtime_us(bw, sf));
+			}
 		}
 		if (lgw_rxif_setconf(8, ifconf) != LGW_HAL_SUCCESS) {
 			LOG(LOG_WARNING,"invalid configuration for Lora standard channel\n");
@@ -397,6 +729,9 @@ int parse_SX1301_configuration(const char * conf_file) {
 			else ifconf.bandwidth = BW_UNDEFINED;
 			ifconf.datarate = (uint32_t)json_object_dotget_number(conf_obj, "chan_FSK.datarate");
 			LOG(LOG_DEBUG, "FSK channel> radio %i, IF %i Hz, %u Hz bw, %u bps datarate\n", ifconf.rf_chain, ifconf.freq_hz, bw, ifconf.datarate);
+			if (ifconf.datarate > 0) {
+				airtime_update((uint32_t)(((uint64_t)FSK_MIN_BITS * 1000000) / ifconf.datarate));
+			}
 		}
 		if (lgw_rxif_setconf(9, ifconf) != LGW_HAL_SUCCESS) {
                 LOG(LOG_WARNING,"invalid configuration for FSK channel\n");
@@ -406,6 +741,44 @@ int parse_SX1301_configuration(const char * conf_file) {
 	return 0;
 }
 
+/* read an array of hexadecimal strings (eg. DevAddr "26011234") into a set, returns the number of valid entries */
+static int parse_addr_list(JSON_Object * obj, const char * name, unsigned nb_digits, struct addr_set_s * set) {
+	JSON_Array *arr;
+	const char *str;
+	char *end;
+	uint32_t *addr;
+	unsigned i, nb = 0;
+	
+	arr = json_object_get_array(obj, name);
+	if ((arr == NULL) || (json_array_get_count(arr) == 0)) {
+		return 0;
+	}
+	addr = malloc(json_array_get_count(arr) * sizeof addr[0]);
+	if (addr == NULL) {
+		LOG(LOG_ERR,"not enough memory for %s\n", name);
+		return 0;
+	}
+	for (i = 0; i < json_array_get_count(arr); ++i) {
+		str = json_array_get_string(arr, i);
+		if ((str == NULL) || (strlen(str) != nb_digits)) {
+			LOG(LOG_WARNING,"%s entry %u is not a %u-digit hexadecimal string, ignored\n", name, i, nb_digits);
+			continue;
+		}
+		addr[nb] = (uint32_t)strtoul(str, &end, 16);
+		if (*end != 0) {
+			LOG(LOG_WARNING,"%s entry %u is not a %u-digit hexadecimal string, ignored\n", name, i, nb_digits);
+			continue;
+		}
+		++nb;
+	}
+	if (addr_set_init(set, addr, nb) != LORAWAN_SUCCESS) {
+		LOG(LOG_ERR,"not enough memory for %s\n", name);
+		nb = 0;
+	}
+	free(addr);
+	return (int)set->nb;
+}
+
 int parse_gateway_configuration(const char * conf_file) {
 	const char conf_obj_name[] = "gateway_conf";
 	JSON_Value *root_val;
@@ -413,6 +786,10 @@ int parse_gateway_configuration(const char * conf_file) {
 	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
 	const char *str; /* pointer to sub-strings in the JSON data */
 	unsigned long long ull = 0;
+	JSON_Array *arr;
+	JSON_Object *obj;
+	JSON_Object *rule;
+	int i;
 	
 	/* try to parse JSON */
 	root_val = json_parse_file_with_comments(conf_file);
@@ -457,6 +834,33 @@ int parse_gateway_configuration(const char * conf_file) {
 		LOG(LOG_DEBUG,"downstream port is configured to \"%s\"\n", serv_port_down);
 	}
 	
+	/* additional upstream destinations, receiving a copy of every uplink (optional) */
+	arr = json_object_get_array(conf_obj, "upstream_servers");
+	if (arr != NULL) {
+		nb_dest = 1;
+		for (i = 0; i < (int)json_array_get_count(arr); ++i) {
+			obj = json_array_get_object(arr, i);
+			str = (obj != NULL) ? json_object_get_string(obj, "server_address") : NULL;
+			if (str == NULL) {
+				LOG(LOG_WARNING,"upstream server %i has no \"server_address\", ignored\n", i);
+				continue;
+			}
+			if (nb_dest == DEST_MAX) {
+				LOG(LOG_WARNING,"too many upstream servers, only %i are used\n", DEST_MAX - 1);
+				break;
+			}
+			snprintf(dest[nb_dest].addr, sizeof dest[nb_dest].addr, "%s", str);
+			val = json_object_get_value(obj, "serv_port_up");
+			if (val != NULL) {
+				snprintf(dest[nb_dest].port_up, sizeof dest[nb_dest].port_up, "%u", (uint16_t)json_value_get_number(val));
+			} else {
+				snprintf(dest[nb_dest].port_up, sizeof dest[nb_dest].port_up, "%u", DEFAULT_PORT_UP);
+			}
+			LOG(LOG_DEBUG,"uplinks will also be sent to \"%s\" (port %s)\n", dest[nb_dest].addr, dest[nb_dest].port_up);
+			++nb_dest;
+		}
+	}
+	
 	/* get keep-alive interval (in seconds) for downstream (optional) */
 	val = json_object_get_value(conf_obj, "keepalive_interval");
 	if (val != NULL) {
@@ -471,11 +875,231 @@ int parse_gateway_configuration(const char * conf_file) {
 		LOG(LOG_DEBUG,"statistics display interval is configured to %u seconds\n", stat_interval);
 	}
 	
+	/* get local TCP port for metrics export (optional) */
+	val = json_object_get_value(conf_obj, "metrics_port");
+	if (val != NULL) {
+		snprintf(metrics_port, sizeof metrics_port, "%u", (uint16_t)json_value_get_number(val));
+		if (strcmp(metrics_port, "0") == 0) {
+			metrics_port[0] = 0; /* 0 disables the listener */
+		}
+		LOG(LOG_DEBUG,"metrics listener port is configured to \"%s\"\n", metrics_port);
+	}
+	
+	/* get upstream encoding (optional) */
+	str = json_object_get_string(conf_obj, "push_format");
+	if (str != NULL) {
+		if (strcmp(str, "binary") == 0) {
+			push_alt = PKT_PUSH_DATA_BIN;
+		} else if (strcmp(str, "compressed") == 0) {
+			push_alt = PKT_PUSH_DATA_LZ;
+		} else if (strcmp(str, "json") != 0) {
+			LOG(LOG_WARNING,"unknown push_format \"%s\", JSON is used\n", str);
+		}
+		LOG(LOG_DEBUG,"upstream datagrams will be %s\n", (push_alt == 0) ? "JSON" : ((push_alt == PKT_PUSH_DATA_BIN) ? "binary, once accepted by every destination" : "compressed JSON, once accepted by every destination"));
+	}
+	val = json_object_get_value(conf_obj, "push_compression_level");
+	if (val != NULL) {
+		push_lz_level = (unsigned)json_value_get_number(val);
+		if (push_lz_level < 1) {
+			push_lz_level = 1;
+		} else if (push_lz_level > JSON_LZ_LEVEL_MAX) {
+			push_lz_level = JSON_LZ_LEVEL_MAX;
+		}
+		LOG(LOG_DEBUG,"PUSH_DATA compression level is configured to %u\n", push_lz_level);
+	}
+	
+	/* get store-and-forward parameters (optional) */
+	str = json_object_get_string(conf_obj, "spool_file");
+	if (str != NULL) {
+		strncpy(spool_path, str, sizeof spool_path);
+		spool_path[sizeof spool_path - 1] = 0;
+		LOG(LOG_DEBUG,"unacknowledged datagrams will be spooled in \"%s\"\n", spool_path);
+	}
+	val = json_object_get_value(conf_obj, "spool_size");
+	if (val != NULL) {
+		spool_size = (uint32_t)json_value_get_number(val);
+		LOG(LOG_DEBUG,"spool size is configured to %u bytes\n", spool_size);
+	}
+	val = json_object_get_value(conf_obj, "spool_replay_rate");
+	if (val != NULL) {
+		replay_rate = (unsigned)json_value_get_number(val);
+		if (replay_rate < 1) {
+			replay_rate = 1;
+		} else if (replay_rate > 1000) {
+			replay_rate = 1000;
+		}
+		LOG(LOG_DEBUG,"spooled datagrams will be replayed at %u datagrams per second max\n", replay_rate);
+	}
+	
+	/* get uplink coalescing parameters (optional) */
+	val = json_object_get_value(conf_obj, "coalesce_max_ms");
+	if (val != NULL) {
+		coalesce_ms = (unsigned)json_value_get_number(val);
+		if (coalesce_ms > 1000) {
+			coalesce_ms = 1000;
+		}
+		coalesce_size = (coalesce_ms > 0) ? DEFAULT_COALESCE_SIZE : UP_BUFF_SIZE;
+		LOG(LOG_DEBUG,"uplink packets will be held %u ms max to share a datagram\n", coalesce_ms);
+	}
+	val = json_object_get_value(conf_obj, "coalesce_max_size");
+	if ((val != NULL) && (coalesce_ms > 0)) {
+		coalesce_size = (unsigned)json_value_get_number(val);
+		if (coalesce_size < 12 + 9 + RXPK_MAX_SIZE + 3) {
+			coalesce_size = 12 + 9 + RXPK_MAX_SIZE + 3; /* room for at least one packet */
+		} else if (coalesce_size > UP_BUFF_SIZE) {
+			coalesce_size = UP_BUFF_SIZE;
+		}
+		LOG(LOG_DEBUG,"coalesced datagrams will be %u bytes max\n", coalesce_size);
+	}
+	
+	/* get duplicate and ghost suppression parameters (optional) */
+	val = json_object_get_value(conf_obj, "dedup_window_us");
+	if (val != NULL) {
+		dedup_window_us = (uint32_t)json_value_get_number(val);
+		LOG(LOG_DEBUG,"duplicate packets window is configured to %u us\n", dedup_window_us);
+	}
+	val = json_object_get_value(conf_obj, "forward_ghosts");
+	if (json_value_get_type(val) == JSONBoolean) {
+		fwd_ghosts = (bool)json_value_get_boolean(val);
+		LOG(LOG_DEBUG,"Lora packets without coding rate will%s be forwarded\n", (fwd_ghosts ? "" : " NOT"));
+	}
+	
+	/* get congestion control parameters (optional) */
+	val = json_object_get_value(conf_obj, "shed_low_pending");
+	if (val != NULL) {
+		shed_low_pending = (int)json_value_get_number(val);
+		LOG(LOG_DEBUG,"low priority uplinks are dropped when %i datagrams wait for an acknowledge\n", shed_low_pending);
+	}
+	val = json_object_get_value(conf_obj, "shed_medium_pending");
+	if (val != NULL) {
+		shed_medium_pending = (int)json_value_get_number(val);
+		LOG(LOG_DEBUG,"medium priority uplinks are dropped when %i datagrams wait for an acknowledge\n", shed_medium_pending);
+	}
+	
+	/* get the LoRaWAN uplink filter (optional) */
+	obj = json_object_get_object(conf_obj, "lorawan_filter");
+	if (obj != NULL) {
+		lorawan_filter_on = true;
+		val = json_object_get_value(obj, "forward_non_lorawan");
+		if (json_value_get_type(val) == JSONBoolean) {
+			fwd_non_lorawan = (bool)json_value_get_boolean(val);
+		}
+		arr = json_object_get_array(obj, "netids");
+		for (i = 0; (arr != NULL) && (i < (int)json_array_get_count(arr)); ++i) {
+			str = json_array_get_string(arr, i);
+			if ((str == NULL) || (devaddr_filter_add_netid(&devaddr_filter, (uint32_t)strtoul(str, NULL, 16)) != LORAWAN_SUCCESS)) {
+				LOG(LOG_WARNING,"NetID entry %i ignored (invalid, or more than %u NetIDs)\n", i, NETID_MAX);
+			}
+		}
+		parse_addr_list(obj, "devaddr_allow", 8, &devaddr_filter.allow);
+		str = json_object_get_string(obj, "join_filter_file");
+		if (str != NULL) {
+			strncpy(join_filter_path, str, sizeof join_filter_path);
+			join_filter_path[sizeof join_filter_path - 1] = 0;
+			LOG(LOG_DEBUG,"join requests will be filtered by JoinEUI/DevEUI with \"%s\"\n", join_filter_path);
+		}
+		parse_addr_list(obj, "devaddr_deny", 8, &devaddr_filter.deny);
+		arr = json_object_get_array(obj, "rate_limits");
+		for (i = 0; (arr != NULL) && (i < (int)json_array_get_count(arr)); ++i) {
+			rule = json_array_get_object(arr, i);
+			if ((rule == NULL) || (json_object_get_number(rule, "max_per_hour") < 1) || (nb_rate_rule >= RATE_RULES_MAX)) {
+				LOG(LOG_WARNING,"rate limit rule %i ignored (no max_per_hour, or more than %u rules)\n", i, RATE_RULES_MAX);
+				continue;
+			}
+			rate_rule[nb_rate_rule].prefix = 0;
+			rate_rule[nb_rate_rule].mask = 0;
+			str = json_object_get_string(rule, "netid");
+			if (str != NULL) {
+				netid_devaddr_prefix((uint32_t)strtoul(str, NULL, 16), &rate_rule[nb_rate_rule].prefix, &rate_rule[nb_rate_rule].mask);
+			}
+			str = json_object_get_string(rule, "class");
+			rate_rule[nb_rate_rule].class_b = (str == NULL) ? -1 : ((str[0] == 'B') || (str[0] == 'b'));
+			rate_rule[nb_rate_rule].lim.per_hour = (uint32_t)json_object_get_number(rule, "max_per_hour");
+			rate_rule[nb_rate_rule].lim.burst = (json_object_get_number(rule, "burst") >= 1) ? (uint32_t)json_object_get_number(rule, "burst") : 1;
+			rate_rule[nb_rate_rule].lim.downsample = (uint32_t)json_object_get_number(rule, "downsample");
+			LOG(LOG_DEBUG,"rate limit rule %i: DevAddr %08X mask %08X, class %s, %u packets per hour, burst of %u, %s over the limit\n", nb_rate_rule, rate_rule[nb_rate_rule].prefix, rate_rule[nb_rate_rule].mask, (rate_rule[nb_rate_rule].class_b < 0) ? "any" : (rate_rule[nb_rate_rule].class_b ? "B" : "A/C"), rate_rule[nb_rate_rule].lim.per_hour, rate_rule[nb_rate_rule].lim.burst, (rate_rule[nb_rate_rule].lim.downsample > 0) ? "1 packet in N forwarded" : "all dropped");
+			++nb_rate_rule;
+		}
+		LOG(LOG_DEBUG,"LoRaWAN filter: %u NetIDs, %u DevAddr allowed, %u DevAddr denied, frames that are not LoRaWAN will%s be forwarded\n", devaddr_filter.nb_netid, devaddr_filter.allow.nb, devaddr_filter.deny.nb, (fwd_non_lorawan ? "" : " NOT"));
+	}
+	
+	/* get the number of packets per fetch (optional), a number or "auto" */
+	val = json_object_get_value(conf_obj, "fetch_batch_size");
+	if (json_value_get_type(val) == JSONString) {
+		if (strcmp(json_value_get_string(val), "auto") == 0) {
+			fetch_adaptive = true;
+			LOG(LOG_DEBUG,"packets per fetch will follow the FIFO occupancy (%u max)\n", NB_PKT_MAX);
+		} else {
+			LOG(LOG_WARNING,"invalid fetch_batch_size \"%s\", using %u\n", json_value_get_string(val), fetch_batch);
+		}
+	} else if (val != NULL) {
+		fetch_batch = (unsigned)json_value_get_number(val);
+		if (fetch_batch < 1) {
+			fetch_batch = 1;
+		} else if (fetch_batch > NB_PKT_MAX) {
+			fetch_batch = NB_PKT_MAX;
+		}
+		LOG(LOG_DEBUG,"%u packets max per fetch\n", fetch_batch);
+	}
+	
+	/* get the max wait between two fetches when no packets are received (optional) */
+	val = json_object_get_value(conf_obj, "fetch_poll_max_ms");
+	if (val != NULL) {
+		poll_max_us = 1000 * (uint32_t)json_value_get_number(val);
+		if (poll_max_us < POLL_MIN_US) {
+			poll_max_us = POLL_MIN_US;
+		} else if (poll_max_us > 1000000) {
+			poll_max_us = 1000000;
+		}
+		LOG(LOG_DEBUG,"idle fetches will be %u ms apart max\n", poll_max_us / 1000);
+	}
+	val = json_object_get_value(conf_obj, "fetch_poll_airtime");
+	if (json_value_get_type(val) == JSONBoolean) {
+		poll_airtime = (bool)json_value_get_boolean(val);
+	}
+	
+	/* get the size limit of upstream datagrams (optional, the path MTU is used by default) */
+	val = json_object_get_value(conf_obj, "max_datagram_size");
+	if (val != NULL) {
+		dgram_size_cfg = (unsigned)json_value_get_number(val);
+		if ((dgram_size_cfg > 0) && (dgram_size_cfg < MIN_DGRAM_SIZE)) {
+			dgram_size_cfg = MIN_DGRAM_SIZE;
+		} else if (dgram_size_cfg > UP_BUFF_SIZE) {
+			dgram_size_cfg = UP_BUFF_SIZE;
+		}
+		LOG(LOG_DEBUG,"upstream datagrams will be %u bytes max (0: path MTU)\n", dgram_size_cfg);
+	}
+	
 	/* get time-out value (in ms) for upstream datagrams (optional) */
 	val = json_object_get_value(conf_obj, "push_timeout_ms");
 	if (val != NULL) {
-		push_timeout_half.tv_usec = 500 * (long int)json_value_get_number(val);
-		LOG(LOG_DEBUG,"upstream PUSH_DATA time-out is configured to %u ms\n", (unsigned)(push_timeout_half.tv_usec / 500));
+		push_timeout_ms = (unsigned)json_value_get_number(val);
+		if (push_timeout_ms < 1) {
+			push_timeout_ms = 1;
+		}
+		LOG(LOG_DEBUG,"upstream PUSH_DATA time-out is configured to %u ms\n", push_timeout_ms);
+	}
+	
+	/* get number of retransmissions of unacknowledged upstream datagrams (optional) */
+	val = json_object_get_value(conf_obj, "push_retries");
+	if (val != NULL) {
+		push_retries = (unsigned)json_value_get_number(val);
+		if (push_retries > 8) {
+			push_retries = 8;
+		}
+		LOG(LOG_DEBUG,"unacknowledged PUSH_DATA will be sent again %u times max\n", push_retries);
+	}
+	
+	/* get the number of upstream datagrams kept until acknowledged (optional) */
+	val = json_object_get_value(conf_obj, "push_pool_size");
+	if (val != NULL) {
+		push_pool_size = (int)json_value_get_number(val);
+		if (push_pool_size < 1) {
+			push_pool_size = 1;
+		} else if (push_pool_size > PUSH_POOL_MAX) {
+			push_pool_size = PUSH_POOL_MAX;
+		}
+		LOG(LOG_DEBUG,"up to %i PUSH_DATA datagrams will wait for an acknowledge\n", push_pool_size);
 	}
 	
 	/* packet filtering parameters */
@@ -501,90 +1125,1417 @@ int parse_gateway_configuration(const char * conf_file) {
 }
 
 
-/*  Print out json to stdout/stderr or syslog, depending on local configuration */
-static void dump_json(uint8_t * json_buff, int header_size){
-        //TODO implement better way to discern between upstream and downstream
-        LOG(LOG_INFO,"[%s] JSON : %s \n", (header_size==4? "down":"up"), (char *)(json_buff + header_size));
+/* time between two CLOCK_MONOTONIC samples, saturated to the 32b range */
+static uint32_t elapsed_us(const struct timespec * start, const struct timespec * stop) {
+	int64_t us;
 
+	us = (int64_t)(stop->tv_sec - start->tv_sec) * 1000000 + (stop->tv_nsec - start->tv_nsec) / 1000;
+	if (us < 0) {
+		return 0;
+	} else if (us > UINT32_MAX) {
+		return UINT32_MAX;
+	}
+	return (uint32_t)us;
 }
 
-/*  Print out json and payload in HEX to stdout/stderr or syslog, depending on local configuration */
-static void dump_packet(const uint8_t* payload,int payload_size, uint8_t * json_buff, int header_size, uint8_t stream){
-        
-        char hex_buff[2*payload_size+1]; // 1 byte is 2 HEX digits (in
-                                      // hex string) +1 for '\0'
-        char *ptr_hex = hex_buff; // moving pointer
-
-        dump_json(json_buff,header_size);
+/* display the latency distribution of the last interval, merging nb_hist per-thread histograms */
+static void report_latency(const char * name, const struct hist_s * h, struct hist_s * prev, int nb_hist) {
+	int i;
+	struct hist_s snap;
+	struct hist_s interval;
+
+	memset(&interval, 0, sizeof interval);
+	for (i = 0; i < nb_hist; ++i) {
+		hist_snapshot(&h[i], &snap);
+		hist_delta(&snap, &prev[i], &prev[i]);
+		hist_merge(&interval, &prev[i]);
+		prev[i] = snap;
+	}
+	LOG(LOG_DEBUG,"# %s: %u samples, p50 %u, p90 %u, p99 %u, max %u\n", name, hist_total(&interval), hist_percentile(&interval, 50.0), hist_percentile(&interval, 90.0), hist_percentile(&interval, 99.0), hist_percentile(&interval, 100.0));
+}
 
-        // convert payload to hex string
-        for (int i = 0; i <  payload_size; i++)
-		{
-                ptr_hex += sprintf(ptr_hex,"%02X", payload[i]);
+/* metrics page, called by the metrics listener thread: only lock-free reads */
+static void render_metrics(struct metrics_buf_s * mb) {
+	struct hist_s snap;
+	struct logging_counters_s log_cnt;
+	uint64_t tot[CNT_UP_NB + CNT_DW_NB];
+	static const char * const tot_names[CNT_UP_NB + CNT_DW_NB][2] = {
+		{"pkt_fwd_rx_received_total", "RF packets received by concentrator"},
+		{"pkt_fwd_rx_crc_ok_total", "RF packets received with PAYLOAD CRC OK"},
+		{"pkt_fwd_rx_crc_bad_total", "RF packets received with PAYLOAD CRC ERROR"},
+		{"pkt_fwd_rx_no_crc_total", "RF packets received with NO PAYLOAD CRC"},
+		{"pkt_fwd_up_packets_forwarded_total", "RF packets forwarded to the server"},
+		{"pkt_fwd_up_network_bytes_total", "UDP bytes sent for upstream traffic"},
+		{"pkt_fwd_up_payload_bytes_total", "radio payload bytes sent for upstream traffic"},
+		{"pkt_fwd_up_datagrams_sent_total", "PUSH_DATA datagrams sent"},
+		{"pkt_fwd_up_datagrams_acked_total", "PUSH_DATA datagrams acknowledged"},
+		{"pkt_fwd_up_acked_first_try_total", "PUSH_DATA datagrams acknowledged at the first emission"},
+		{"pkt_fwd_up_acked_after_retry_total", "PUSH_DATA datagrams acknowledged after a retransmission"},
+		{"pkt_fwd_up_retransmissions_total", "PUSH_DATA retransmissions"},
+		{"pkt_fwd_up_given_up_total", "PUSH_DATA datagrams never acknowledged"},
+		{"pkt_fwd_up_evicted_total", "PUSH_DATA datagrams dropped from the full pool before their time-out"},
+		{"pkt_fwd_up_spooled_total", "unacknowledged PUSH_DATA datagrams stored in the spool"},
+		{"pkt_fwd_up_replayed_total", "spooled PUSH_DATA datagrams replayed and acknowledged"},
+		{"pkt_fwd_up_spool_lost_total", "spooled PUSH_DATA datagrams discarded because the spool was full"},
+		{"pkt_fwd_up_syscalls_total", "system calls sending or receiving upstream datagrams"},
+		{"pkt_fwd_up_syscall_datagrams_total", "upstream datagrams sent or received by those system calls"},
+		{NULL, NULL}, {NULL, NULL}, {NULL, NULL}, {NULL, NULL}, {NULL, NULL}, /* packets per datagram, exported below */
+		{"pkt_fwd_up_datagram_splits_total", "PUSH_DATA datagrams closed early to stay under the size limit"},
+		{"pkt_fwd_up_datagram_oversize_total", "PUSH_DATA datagrams over the size limit (IP fragmented)"},
+		{"pkt_fwd_up_wakeups_total", "concentrator fetches, each one is a wake-up of the upstream thread"},
+		{"pkt_fwd_up_fetches_total", "concentrator fetches that returned packets"},
+		{"pkt_fwd_up_fetches_full_total", "concentrator fetches that filled the batch"},
+		{"pkt_fwd_up_json_packets_total", "RF packets sent in JSON PUSH_DATA datagrams"},
+		{"pkt_fwd_up_binary_packets_total", "RF packets sent in binary PUSH_DATA_BIN datagrams"},
+		{"pkt_fwd_up_binary_bytes_total", "UDP bytes of the PUSH_DATA_BIN datagrams"},
+		{"pkt_fwd_up_compressed_packets_total", "RF packets sent in compressed PUSH_DATA_LZ datagrams"},
+		{"pkt_fwd_up_compressed_bytes_total", "UDP bytes of the PUSH_DATA_LZ datagrams"},
+		{"pkt_fwd_up_compressed_json_bytes_total", "size of the PUSH_DATA_LZ datagrams before compression"},
+		{"pkt_fwd_up_copied_bytes_total", "bytes copied between buffers after encoding, for upstream traffic"},
+		{"pkt_fwd_dw_pull_sent_total", "PULL_DATA requests sent"},
+		{"pkt_fwd_dw_pull_acked_total", "PULL_DATA requests acknowledged"},
+		{"pkt_fwd_dw_datagrams_received_total", "valid PULL_RESP datagrams received"},
+		{"pkt_fwd_dw_network_bytes_total", "UDP bytes received for downstream traffic"},
+		{"pkt_fwd_dw_payload_bytes_total", "radio payload bytes received for downstream traffic"},
+		{"pkt_fwd_tx_ok_total", "RF packets emitted successfully"},
+		{"pkt_fwd_tx_fail_total", "RF packets not emitted because lgw_send failed"},
+		{"pkt_fwd_dw_syscalls_total", "system calls sending or receiving downstream datagrams"},
+		{"pkt_fwd_dw_syscall_datagrams_total", "downstream datagrams sent or received by those system calls"}
+	};
+	uint64_t flt_tot[CNT_FLT_NB];
+	static const char * const flt_names[CNT_FLT_NB][2] = {
+		{"pkt_fwd_filter_ghost_total", "Lora packets without coding rate (mostly false syncs)"},
+		{"pkt_fwd_filter_duplicate_total", "RF packets dropped as copies of a recent packet"},
+		{"pkt_fwd_filter_not_lorawan_total", "RF packets that could not be parsed as LoRaWAN"},
+		{"pkt_fwd_filter_foreign_total", "LoRaWAN data uplinks dropped because their DevAddr is in none of our NetIDs"},
+		{"pkt_fwd_filter_denied_total", "LoRaWAN data uplinks dropped because their DevAddr is in the deny list"},
+		{"pkt_fwd_filter_join_forwarded_total", "Join requests forwarded by the join filter"},
+		{"pkt_fwd_filter_join_filtered_total", "Join requests dropped by the join filter"},
+		{"pkt_fwd_filter_rate_downsampled_total", "LoRaWAN data uplinks over their device limit, forwarded by the downsampling"},
+		{"pkt_fwd_filter_rate_dropped_total", "LoRaWAN data uplinks dropped because their device is over its limit"}
+	};
+	uint64_t prio_tot[CNT_PRIO_NB];
+	static const char * const prio_labels[PRIO_NB] = {"high", "medium", "low"};
+	uint64_t dest_tot[DEST_MAX][CNT_DEST_NB];
+	static const char * const dest_names[CNT_DEST_NB][2] = {
+		{"pkt_fwd_server_datagrams_sent_total", "PUSH_DATA datagrams sent to each upstream destination"},
+		{"pkt_fwd_server_network_bytes_total", "UDP bytes sent to each upstream destination"},
+		{"pkt_fwd_server_datagrams_acked_total", "PUSH_DATA datagrams acknowledged by each upstream destination"},
+		{"pkt_fwd_server_acked_first_try_total", "PUSH_DATA datagrams acknowledged at the first emission"},
+		{"pkt_fwd_server_acked_after_retry_total", "PUSH_DATA datagrams acknowledged after a retransmission"},
+		{"pkt_fwd_server_retransmissions_total", "PUSH_DATA retransmissions"},
+		{"pkt_fwd_server_given_up_total", "PUSH_DATA datagrams never acknowledged"},
+		{"pkt_fwd_server_evicted_total", "PUSH_DATA datagrams dropped from the full pool before their time-out"}
+	};
+	static const char * const ppd_labels[] = {"packets=\"1\"", "packets=\"2\"", "packets=\"3-4\"", "packets=\"5-8\"", "packets=\"9+\""};
+	char labels[sizeof dest[0].addr + sizeof dest[0].port_up + 32]; /* fits the server="addr:port" label of any destination */
+	int i, j, k;
+	
+	/* counters are monotonic, export them as they are */
+	counters_snapshot(&cnt_up, tot, CNT_UP_NB);
+	counters_snapshot(&cnt_dw, tot + CNT_UP_NB, CNT_DW_NB);
+	
+	metrics_family(mb, "pkt_fwd_uptime_seconds", "gauge", "time since the packet forwarder started");
+	metrics_sample(mb, "pkt_fwd_uptime_seconds", NULL, (uint64_t)(time(NULL) - start_time));
+	metrics_family(mb, "pkt_fwd_up_spool_datagrams", "gauge", "PUSH_DATA datagrams waiting in the spool");
+	metrics_sample(mb, "pkt_fwd_up_spool_datagrams", NULL, spool_count());
+	metrics_family(mb, "pkt_fwd_up_datagram_size_limit_bytes", "gauge", "max size of a PUSH_DATA datagram (UDP payload)");
+	metrics_sample(mb, "pkt_fwd_up_datagram_size_limit_bytes", NULL, dgram_size_max);
+	metrics_family(mb, "pkt_fwd_up_fetch_batch_size", "gauge", "max number of packets per concentrator fetch");
+	metrics_sample(mb, "pkt_fwd_up_fetch_batch_size", NULL, fetch_batch);
+	metrics_family(mb, "pkt_fwd_up_poll_max_seconds", "gauge", "max wait between two concentrator fetches");
+	metrics_printf(mb, "pkt_fwd_up_poll_max_seconds %.6f\n", (double)poll_max_us / 1e6);
+	for (i = 0; i < (CNT_UP_NB + CNT_DW_NB); ++i) {
+		if (tot_names[i][0] == NULL) {
+			continue;
 		}
-
-        LOG(LOG_INFO,"[%s]The payload in HEX: %s\n",((stream==UPSTREAM)?"up":"down"), hex_buff);
-
-        
-        
+		metrics_family(mb, tot_names[i][0], "counter", tot_names[i][1]);
+		metrics_sample(mb, tot_names[i][0], NULL, tot[i]);
+	}
+	counters_snapshot(&cnt_flt, flt_tot, CNT_FLT_NB);
+	for (i = 0; i < CNT_FLT_NB; ++i) {
+		metrics_family(mb, flt_names[i][0], "counter", flt_names[i][1]);
+		metrics_sample(mb, flt_names[i][0], NULL, flt_tot[i]);
+	}
+	metrics_family(mb, "pkt_fwd_join_filter_loads_total", "counter", "Successful loads of the join filter file");
+	metrics_sample(mb, "pkt_fwd_join_filter_loads_total", NULL, join_filter_loads);
+	counters_snapshot(&cnt_prio, prio_tot, CNT_PRIO_NB);
+	metrics_family(mb, "pkt_fwd_up_priority_packets_total", "counter", "RF packets forwarded or shed because of the congestion, by priority class");
+	for (i = 0; i < PRIO_NB; ++i) {
+		snprintf(labels, sizeof labels, "class=\"%s\",action=\"forwarded\"", prio_labels[i]);
+		metrics_sample(mb, "pkt_fwd_up_priority_packets_total", labels, prio_tot[CNT_PRIO_FWD + i]);
+		snprintf(labels, sizeof labels, "class=\"%s\",action=\"shed\"", prio_labels[i]);
+		metrics_sample(mb, "pkt_fwd_up_priority_packets_total", labels, prio_tot[CNT_PRIO_SHED + i]);
+	}
+	metrics_family(mb, "pkt_fwd_up_datagrams_by_packets_total", "counter", "PUSH_DATA datagrams sent, by number of RF packets carried");
+	for (i = 0; i < (int)ARRAY_SIZE(ppd_labels); ++i) {
+		metrics_sample(mb, "pkt_fwd_up_datagrams_by_packets_total", ppd_labels[i], tot[CNT_UP_PPD_1 + i]);
+	}
+	for (i = 0; i < nb_dest; ++i) {
+		counters_snapshot(&dest[i].cnt, dest_tot[i], CNT_DEST_NB);
+	}
+	for (j = 0; j < CNT_DEST_NB; ++j) {
+		metrics_family(mb, dest_names[j][0], "counter", dest_names[j][1]);
+		for (i = 0; i < nb_dest; ++i) {
+			k = snprintf(labels, sizeof labels, "server=\"%.*s:%.*s\"", (int)sizeof dest[0].addr - 1, dest[i].addr, (int)sizeof dest[0].port_up - 1, dest[i].port_up);
+			if ((k > 0) && (k < (int)sizeof labels)) {
+				metrics_sample(mb, dest_names[j][0], labels, dest_tot[i][j]);
+			}
+		}
+	}
+	
+	logging_get_counters(&log_cnt);
+	metrics_family(mb, "pkt_fwd_log_queued_total", "counter", "log messages handed to the logging thread");
+	metrics_sample(mb, "pkt_fwd_log_queued_total", NULL, log_cnt.queued);
+	metrics_family(mb, "pkt_fwd_log_dropped_total", "counter", "log messages lost because the logging ring was full");
+	metrics_sample(mb, "pkt_fwd_log_dropped_total", NULL, log_cnt.dropped);
+	metrics_family(mb, "pkt_fwd_log_truncated_total", "counter", "log messages cut, strings longer than 8 kB in total or more than 128 arguments");
+	metrics_sample(mb, "pkt_fwd_log_truncated_total", NULL, log_cnt.truncated);
+	
+	metrics_family(mb, "pkt_fwd_latency_seconds", "histogram", "latency of the packet path stages");
+	hist_snapshot(&lat_up.receive, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"lgw_receive\"", &snap);
+	hist_snapshot(&lat_up.poll, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"fetch_interval\"", &snap);
+	hist_snapshot(&lat_up.fetch_send, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"fetch_to_send\"", &snap);
+	hist_snapshot(&lat_up.push_ack, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"push_ack\"", &snap);
+	hist_snapshot(&lat_up.compress, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"compress\"", &snap);
+	hist_snapshot(&lat_dw.pull_ack, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"pull_ack\"", &snap);
+	hist_snapshot(&lat_dw.pull_resp, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"pull_resp_to_send\"", &snap);
+	hist_snapshot(&lat_up.concent, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"concentrator_wait_up\"", &snap);
+	hist_snapshot(&lat_dw.concent, &snap);
+	metrics_histogram(mb, "pkt_fwd_latency_seconds", "stage=\"concentrator_wait_down\"", &snap);
 }
 
+/* filtering stages run before a packet is serialized, returns false to drop the packet (mx_rate_table held by the caller when rate rules are set) */
+static bool uplink_filter(const struct lgw_pkt_rx_s * p, struct dedup_s * dedup, uint64_t now_ms) {
+	struct lorawan_hdr_s hdr;
+	enum devaddr_verdict_e verdict;
+	enum rate_verdict_e rate;
+	bool pass;
+	int i;
+	
+	/* ghosts: false syncs are reported without coding rate (serialized as "OFF") */
+	if ((p->modulation == MOD_LORA) && (p->coderate == CR_UNDEFINED)) {
+		counters_begin(&cnt_flt);
+		counters_add(&cnt_flt, CNT_FLT_GHOST, 1);
+		counters_end(&cnt_flt);
+		if (!fwd_ghosts) {
+			return false;
+		}
+	}
+	
+	/* copies of a frame reported on adjacent IF chains, only the first one is kept */
+	if ((dedup_window_us > 0) && (p->status == STAT_CRC_OK) && (p->size > 0) && dedup_check(dedup, p->crc, p->size, p->count_us)) {
+		counters_begin(&cnt_flt);
+		counters_add(&cnt_flt, CNT_FLT_DUP, 1);
+		counters_end(&cnt_flt);
+		return false;
+	}
+	
+	if (!lorawan_filter_on) {
+		return true;
+	}
+	if (lorawan_parse(p->payload, p->size, &hdr) != LORAWAN_SUCCESS) {
+		counters_begin(&cnt_flt);
+		counters_add(&cnt_flt, CNT_FLT_NOT_LORAWAN, 1);
+		counters_end(&cnt_flt);
+		return fwd_non_lorawan;
+	}
+	if ((hdr.mtype == MTYPE_UNCONF_UP) || (hdr.mtype == MTYPE_CONF_UP)) {
+		verdict = devaddr_filter_check(&devaddr_filter, hdr.devaddr);
+		if (verdict != DEVADDR_PASS) {
+			counters_begin(&cnt_flt);
+			counters_add(&cnt_flt, (verdict == DEVADDR_FOREIGN) ? CNT_FLT_FOREIGN : CNT_FLT_DENIED, 1);
+			counters_end(&cnt_flt);
+			return false;
+		}
+		for (i = 0; i < nb_rate_rule; ++i) {
+			if (((hdr.devaddr & rate_rule[i].mask) == rate_rule[i].prefix) && ((rate_rule[i].class_b < 0) || (rate_rule[i].class_b == ((hdr.fctrl & FCTRL_UP_CLASS_B) != 0)))) {
+				break;
+			}
+		}
+		if (i < nb_rate_rule) {
+			rate = rate_check(&rate_table, hdr.devaddr, &rate_rule[i].lim, now_ms);
+			if (rate != RATE_PASS) {
+				counters_begin(&cnt_flt);
+				counters_add(&cnt_flt, (rate == RATE_SAMPLED) ? CNT_FLT_RATE_SAMPLED : CNT_FLT_RATE_DROP, 1);
+				counters_end(&cnt_flt);
+				return (rate == RATE_SAMPLED);
+			}
+		}
+	} else if ((hdr.mtype == MTYPE_JOIN_REQUEST) && (join_filter_path[0] != 0)) {
+		/* a join passes if its JoinEUI or its DevEUI is ours, or if no filter could be loaded */
+		pthread_mutex_lock(&mx_join_filter);
+		pass = (join_filter.bits == NULL) || join_filter_contains(&join_filter, hdr.join_eui) || join_filter_contains(&join_filter, hdr.dev_eui);
+		pthread_mutex_unlock(&mx_join_filter);
+		counters_begin(&cnt_flt);
+		counters_add(&cnt_flt, pass ? CNT_FLT_JOIN_FWD : CNT_FLT_JOIN_DROP, 1);
+		counters_end(&cnt_flt);
+		return pass;
+	}
+	return true;
+}
 
+/* priority class of an uplink, from its CRC status and LoRaWAN header */
+static enum prio_e uplink_priority(const struct lgw_pkt_rx_s * p) {
+	struct lorawan_hdr_s hdr;
+	
+	if ((p->status != STAT_CRC_OK) || (lorawan_parse(p->payload, p->size, &hdr) != LORAWAN_SUCCESS)) {
+		return PRIO_LOW;
+	}
+	switch (hdr.mtype) {
+		case MTYPE_JOIN_REQUEST:
+		case MTYPE_REJOIN:
+			return PRIO_HIGH;
+		case MTYPE_UNCONF_UP:
+		case MTYPE_CONF_UP:
+			if (((hdr.fctrl & FCTRL_FOPTS_LEN) != 0) || (hdr.fport == 0)) {
+				return PRIO_HIGH; /* MAC commands in FOpts, or in the payload on port 0 */
+			}
+			return (hdr.mtype == MTYPE_CONF_UP) ? PRIO_MEDIUM : PRIO_LOW;
+		default:
+			return PRIO_LOW;
+	}
+}
 
+/* load the join filter file if it was replaced or modified since the last load, the previous filter is kept on error */
+static void join_filter_reload(void) {
+	struct stat st;
+	struct join_filter_s next, prev;
+	
+	if (stat(join_filter_path, &st) != 0) {
+		if (join_filter.bits == NULL) {
+			LOG(LOG_WARNING,"[main] join filter %s not found, join requests are forwarded\n", join_filter_path);
+		}
+		return;
+	}
+	if ((join_filter.bits != NULL) && (st.st_ino == join_filter_stat.st_ino) && (st.st_size == join_filter_stat.st_size) && (st.st_mtime == join_filter_stat.st_mtime)) {
+		return; /* same file */
+	}
+	if (join_filter_load(&next, join_filter_path) != JOIN_FILTER_SUCCESS) {
+		LOG(LOG_WARNING,"[main] invalid join filter %s, %s\n", join_filter_path, (join_filter.bits == NULL) ? "join requests are forwarded" : "previous filter kept");
+		return;
+	}
+	pthread_mutex_lock(&mx_join_filter);
+	prev = join_filter;
+	join_filter = next;
+	pthread_mutex_unlock(&mx_join_filter);
+	join_filter_free(&prev);
+	join_filter_stat = st;
+	join_filter_loads += 1;
+	LOG(LOG_NOTICE,"[main] join filter %s loaded, %u EUIs, %u bits, %u hashes\n", join_filter_path, join_filter.nb_keys, join_filter.nb_bits, join_filter.nb_hash);
+}
 
+/* airtime of the shortest Lora packet (1-byte payload, CR 4/5, CRC, explicit header), see the SX1301 datasheet */
+static uint32_t lora_min_airtime_us(uint32_t bw_hz, unsigned sf) {
+	uint32_t tsym_us;
+	int num, den;
+	int nb_symb;
+	
+	tsym_us = (uint32_t)(((uint64_t)1000000 << sf) / bw_hz);
+	num = (8 * 1) - (4 * (int)sf) + 28 + 16; /* 8*PL - 4*SF + 28 + 16*CRC - 20*IH */
+	den = 4 * ((int)sf - (((sf >= 11) && (bw_hz == 125000)) ? 2 : 0)); /* low datarate optimization */
+	nb_symb = 8;
+	if (num > 0) {
+		nb_symb += ((num + den - 1) / den) * 5; /* CR 4/5 */
+	}
+	return ((((4 * LORA_MIN_PREAMB) + 17) * tsym_us) / 4) + (nb_symb * tsym_us); /* preamble + 4.25 symbols, then header and payload */
+}
 
-/* -------------------------------------------------------------------------- */
-/* --- MAIN FUNCTION -------------------------------------------------------- */
+static void airtime_update(uint32_t airtime_us) {
+	if ((airtime_min_us == 0) || (airtime_us < airtime_min_us)) {
+		airtime_min_us = airtime_us;
+	}
+}
 
-int main(void)
-{
+/* wait between two fetches: poll the upstream sockets for acknowledges (ms resolution), or sleep for sub-millisecond waits */
+static void poll_wait_us(uint32_t wait_us, bool * acks_read) {
+	struct timespec t;
+	
+	if (wait_us >= 1000) {
+		push_receive_acks((int)(wait_us / 1000));
+		*acks_read = true;
+	} else if (wait_us > 0) {
+		t.tv_sec = 0;
+		t.tv_nsec = 1000 * (long)wait_us;
+		nanosleep(&t, NULL);
+	}
+}
 
-    openlog("basic_pkt_fwd", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
-	struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
-	int i; /* loop variable and temporary variable for return value */
+/* size of the next fetch: doubled when the last one filled the batch, then back towards twice the average FIFO occupancy, one packet per fetch */
+static unsigned fetch_batch_adapt(unsigned batch, int nb_pkt, unsigned * occupancy) {
+	unsigned target;
 	
-	/* configuration file related */
-	char *global_cfg_path= "global_conf.json"; /* contain global (typ. network-wide) configuration */
-	char *local_cfg_path = "local_conf.json"; /* contain node specific configuration, overwrite global parameters for parameters that are defined in both */
-	char *debug_cfg_path = "debug_conf.json"; /* if present, all other configuration files are ignored */
+	/* an empty FIFO says nothing about the size of the next burst */
+	if (nb_pkt <= 0) {
+		return batch;
+	}
 	
-	/* threads */
-	pthread_t thrid_up;
-	pthread_t thrid_down;
+	/* moving average of the packets per fetch, in 1/16 packet, weight 1/8 */
+	*occupancy = *occupancy - (*occupancy / 8) + (2 * (unsigned)nb_pkt);
+	if ((unsigned)nb_pkt >= batch) {
+		target = 2 * batch;
+	} else {
+		target = (*occupancy + 7) / 8; /* twice the average, rounded up */
+		if (target < batch) {
+			target = batch - 1;
+		}
+	}
+	if (target < FETCH_BATCH_MIN) {
+		target = FETCH_BATCH_MIN;
+	} else if (target > NB_PKT_MAX) {
+		target = NB_PKT_MAX;
+	}
+	return target;
+}
+
+static uint64_t monotonic_ms(void) {
+	struct timespec now;
 	
-	/* network socket creation */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/* open a socket connected to the upstream port of a server, -1 if impossible */
+static int open_socket_up(const char * addr, const char * port) {
+	int i;
+	int sock = -1;
 	struct addrinfo hints;
 	struct addrinfo *result; /* store result of getaddrinfo */
 	struct addrinfo *q; /* pointer to move into *result data */
 	char host_name[64];
 	char port_name[64];
 	
-	/* variables to get local copies of measurements */
-	uint32_t cp_nb_rx_rcv;
-	uint32_t cp_nb_rx_ok;
-	uint32_t cp_nb_rx_bad;
-	uint32_t cp_nb_rx_nocrc;
-	uint32_t cp_up_pkt_fwd;
-	uint32_t cp_up_network_byte;
-	uint32_t cp_up_payload_byte;
-	uint32_t cp_up_dgram_sent;
-	uint32_t cp_up_ack_rcv;
-	uint32_t cp_dw_pull_sent;
-	uint32_t cp_dw_ack_rcv;
-	uint32_t cp_dw_dgram_rcv;
-	uint32_t cp_dw_network_byte;
-	uint32_t cp_dw_payload_byte;
-	uint32_t cp_nb_tx_ok;
-	uint32_t cp_nb_tx_fail;
+	/* look for server address w/ upstream port */
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC; /* should handle IP v4 or v6 automatically */
+	hints.ai_socktype = SOCK_DGRAM;
+	i = getaddrinfo(addr, port, &hints, &result);
+	if (i != 0) {
+		LOG(LOG_ERR,"[up] getaddrinfo on address %s (PORT %s) returned %s\n", addr, port, gai_strerror(i));
+		return -1;
+	}
 	
-	/* statistics variable */
-	time_t t;
-	char stat_timestamp[24];
-	float rx_ok_ratio;
+	/* try to open socket for upstream traffic */
+	for (q=result; q!=NULL; q=q->ai_next) {
+		sock = socket(q->ai_family, q->ai_socktype,q->ai_protocol);
+		if (sock == -1) continue; /* try next field */
+		else break; /* success, get out of loop */
+	}
+	if (q == NULL) {
+		LOG(LOG_ERR,"[up] failed to open socket to any of server %s addresses (port %s)\n", addr, port);
+		i = 1;
+		for (q=result; q!=NULL; q=q->ai_next) {
+			getnameinfo(q->ai_addr, q->ai_addrlen, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST);
+			LOG(LOG_INFO,"[up] result %i host:%s service:%s\n", i, host_name, port_name);
+			++i;
+		}
+		freeaddrinfo(result);
+		return -1;
+	}
+	
+	/* connect so we can send/receive packet with the server only */
+	i = connect(sock, q->ai_addr, q->ai_addrlen);
+	freeaddrinfo(result);
+	if (i != 0) {
+		LOG(LOG_ERR,"[up] connect returned %s\n", strerror(errno));
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/* largest UDP payload that no upstream destination has to fragment, 0 if the kernel does not know the path MTU */
+static unsigned path_mtu_payload(void) {
+	int d;
+	int mtu;
+	unsigned hdr;
+	unsigned size_min = 0;
+	struct sockaddr_storage sa;
+	socklen_t len;
+	
+	for (d = 0; d < nb_dest; ++d) {
+		len = sizeof sa;
+		if (getsockname(dest[d].sock, (struct sockaddr *)&sa, &len) != 0) {
+			continue;
+		}
+		len = sizeof mtu;
+		if (sa.ss_family == AF_INET6) {
+#ifdef IPV6_MTU
+			if (getsockopt(dest[d].sock, IPPROTO_IPV6, IPV6_MTU, &mtu, &len) != 0) {
+				continue;
+			}
+#else
+			continue;
+#endif
+			hdr = 40 + 8; /* IPv6 and UDP headers */
+		} else {
+#ifdef IP_MTU
+			if (getsockopt(dest[d].sock, IPPROTO_IP, IP_MTU, &mtu, &len) != 0) {
+				continue;
+			}
+#else
+			continue;
+#endif
+			hdr = 20 + 8; /* IPv4 and UDP headers */
+		}
+		if ((mtu <= (int)hdr) || ((size_min > 0) && ((unsigned)mtu - hdr >= size_min))) {
+			continue;
+		}
+		size_min = (unsigned)mtu - hdr;
+	}
+	return size_min;
+}
+
+/* send a PUSH_DATA to every destination (spooled datagrams: primary only), keep its buffer until acknowledged or given up, a free buffer is returned in exchange */
+static void push_send(uint8_t ** dgram, int size, bool replay) {
+	int b;
+	int d;
+	uint8_t * free_buff;
+	
+	b = push_body_alloc();
+	free_buff = push_body[b].dgram;
+	push_body[b].dgram = *dgram;
+	*dgram = free_buff;
+	push_body[b].size = size;
+	push_body[b].seq = push_body_seq++;
+	for (d = 0; d < (replay ? 1 : nb_dest); ++d) {
+		push_slot_send(d, b, replay); /* primary server first */
+	}
+}
+
+/* free datagram buffer, evict the oldest one already sent (preferably not waiting for the primary server) if needed */
+static int push_body_alloc(void) {
+	int b, d, i;
+	int oldest = -1;
+	int oldest_other = -1;
+	bool on_primary[PUSH_POOL_MAX] = {false};
+	bool queued[PUSH_POOL_MAX] = {false};
+	uint64_t now_ms;
+	
+	for (b = 0; b < push_pool_size; ++b) {
+		if (push_body[b].refs == 0) {
+			return b;
+		}
+	}
+	for (d = 0; d < nb_dest; ++d) {
+		for (i = 0; i < push_pool_size; ++i) {
+			if (dest[d].pool[i].used) {
+				on_primary[dest[d].pool[i].body] |= (d == 0);
+				queued[dest[d].pool[i].body] |= dest[d].pool[i].queued;
+			}
+		}
+	}
+	
+	/* a datagram is never dropped before it is sent: if they all wait for the flush, send them now */
+	for (b = 0; (b < push_pool_size) && queued[b]; ++b);
+	if (b == push_pool_size) {
+		push_flush();
+		memset(queued, 0, sizeof queued);
+	}
+	for (b = 0; b < push_pool_size; ++b) {
+		if (queued[b]) {
+			continue;
+		}
+		if ((oldest == -1) || ((int32_t)(push_body[b].seq - push_body[oldest].seq) < 0)) {
+			oldest = b;
+		}
+		if (!on_primary[b] && ((oldest_other == -1) || ((int32_t)(push_body[b].seq - push_body[oldest_other].seq) < 0))) {
+			oldest_other = b;
+		}
+	}
+	
+	/* a slow secondary destination never makes the primary server lose a datagram */
+	b = (oldest_other != -1) ? oldest_other : oldest;
+	now_ms = monotonic_ms();
+	for (d = 0; d < nb_dest; ++d) {
+		for (i = 0; i < push_pool_size; ++i) {
+			if (dest[d].pool[i].used && (dest[d].pool[i].body == b)) {
+				push_reclaim(d, i, now_ms);
+			}
+		}
+	}
+	return b;
+}
+
+/* first emission of a datagram to a destination, with a token not used by its other pending datagrams */
+static void push_slot_send(int d, int b, bool replay) {
+	int i;
+	int idx;
+	uint8_t token_h;
+	uint8_t token_l;
+	struct push_slot_s * s;
+	
+	idx = push_slot_free(d);
+	
+	/* random token, not used by another datagram waiting for its acknowledge */
+	do {
+		token_h = (uint8_t)rand();
+		token_l = (uint8_t)rand();
+		for (i = 0; i < push_pool_size; ++i) {
+			if (dest[d].pool[i].used && (dest[d].pool[i].hdr[1] == token_h) && (dest[d].pool[i].hdr[2] == token_l)) {
+				break;
+			}
+		}
+	} while (i < push_pool_size);
+	
+	s = &dest[d].pool[idx];
+	memcpy(s->hdr, push_body[b].dgram, sizeof s->hdr);
+	counters_begin(&cnt_up);
+	counters_add(&cnt_up, CNT_UP_COPY_BYTE, sizeof s->hdr);
+	counters_end(&cnt_up);
+	s->hdr[1] = token_h;
+	s->hdr[2] = token_l;
+	s->used = true;
+	s->replay = replay;
+	s->body = b;
+	s->attempts = 1;
+	push_body[b].refs += 1;
+	dest[d].pool_used += 1;
+	push_transmit(d, idx);
+	clock_gettime(CLOCK_MONOTONIC, &s->send_time);
+	s->deadline_ms = monotonic_ms() + push_timeout_ms;
+	counters_begin(&dest[d].cnt);
+	counters_add(&dest[d].cnt, CNT_DEST_SENT, 1);
+	counters_add(&dest[d].cnt, CNT_DEST_NETWORK_BYTE, push_body[b].size);
+	counters_end(&dest[d].cnt);
+}
+
+/* free slot of a destination, if the pool is full the sent datagram closest to its time-out makes room */
+static int push_slot_free(int d) {
+	int i;
+	int idx = -1;
+	
+	for (i = 0; i < push_pool_size; ++i) {
+		if (!dest[d].pool[i].used) {
+			return i;
+		}
+	}
+	/* a datagram is never dropped before it is sent: if they all wait for the flush, send them now */
+	if (dest[d].out_nb == push_pool_size) {
+		push_flush();
+	}
+	for (i = 0; i < push_pool_size; ++i) {
+		if (!dest[d].pool[i].queued && ((idx == -1) || (dest[d].pool[i].deadline_ms < dest[d].pool[idx].deadline_ms))) {
+			idx = i;
+		}
+	}
+	push_reclaim(d, idx, monotonic_ms());
+	return idx;
+}
+
+/* queue the emission of a slot, sent by the next push_flush */
+static void push_transmit(int d, int idx) {
+	if (!dest[d].pool[idx].queued) {
+		dest[d].pool[idx].queued = true;
+		dest[d].out[dest[d].out_nb] = idx;
+		dest[d].out_nb += 1;
+	}
+}
+
+/* send the queued datagrams (header of the destination + shared body), one system call per destination when possible */
+static void push_flush(void) {
+	int d, k;
+	struct iovec iov[PUSH_POOL_MAX][2];
+	struct msghdr msg[PUSH_POOL_MAX];
+	struct push_slot_s * s;
+	unsigned syscalls = 0;
+	unsigned nb_dgram = 0;
+	
+	for (d = 0; d < nb_dest; ++d) {
+		if (dest[d].out_nb == 0) {
+			continue;
+		}
+		memset(msg, 0, dest[d].out_nb * sizeof msg[0]);
+		for (k = 0; k < dest[d].out_nb; ++k) {
+			s = &dest[d].pool[dest[d].out[k]];
+			iov[k][0].iov_base = (void *)s->hdr;
+			iov[k][0].iov_len = sizeof s->hdr;
+			iov[k][1].iov_base = (void *)(push_body[s->body].dgram + sizeof s->hdr);
+			iov[k][1].iov_len = push_body[s->body].size - sizeof s->hdr;
+			msg[k].msg_iov = iov[k];
+			msg[k].msg_iovlen = 2;
+			s->queued = false;
+		}
+		udp_send_batch(dest[d].sock, msg, dest[d].out_nb, MSG_DONTWAIT, &syscalls); /* never wait for a destination */
+		nb_dgram += dest[d].out_nb;
+		dest[d].out_nb = 0;
+	}
+	if (nb_dgram > 0) {
+		counters_begin(&cnt_up);
+		counters_add(&cnt_up, CNT_UP_SYSCALL, syscalls);
+		counters_add(&cnt_up, CNT_UP_IO_DGRAM, nb_dgram);
+		counters_end(&cnt_up);
+	}
+}
+
+static void push_release(int d, int idx) {
+	int k;
+	
+	if (dest[d].pool[idx].queued) { /* given up before being sent, remove it from the queue */
+		for (k = 0; dest[d].out[k] != idx; ++k);
+		memmove(&dest[d].out[k], &dest[d].out[k + 1], (dest[d].out_nb - k - 1) * sizeof dest[d].out[0]);
+		dest[d].out_nb -= 1;
+		dest[d].pool[idx].queued = false;
+	}
+	dest[d].pool[idx].used = false;
+	dest[d].pool_used -= 1;
+	push_body[dest[d].pool[idx].body].refs -= 1;
+}
+
+/* no acknowledge for that datagram, the primary server keeps it in the spool (if there is one) */
+static void push_give_up(int d, int idx) {
+	int i, j;
+	struct push_slot_s * s = &dest[d].pool[idx];
+	
+	/* maybe a server that does not decode that encoding (any more): back to JSON until a new probe is acknowledged */
+	if ((push_alt != 0) && (push_body[s->body].dgram[3] == push_alt) && dest[d].alt_ok) {
+		dest[d].alt_ok = false;
+		dest[d].next_probe_ms = monotonic_ms() + PUSH_PROBE_MS;
+		LOG(LOG_WARNING,"[up] %s not acknowledged by %s:%s, back to JSON\n", (push_alt == PKT_PUSH_DATA_BIN) ? "PUSH_DATA_BIN" : "PUSH_DATA_LZ", dest[d].addr, dest[d].port_up);
+	}
+	
+	if (d != 0) {
+		counters_begin(&dest[d].cnt);
+		counters_add(&dest[d].cnt, CNT_DEST_GIVE_UP, 1);
+		counters_end(&dest[d].cnt);
+		push_release(d, idx);
+		return;
+	}
+	link_up = false;
+	time(&link_down_time);
+	if (s->replay) {
+		replay_in_flight = false; /* still at the head of the spool */
+	} else {
+		counters_begin(&cnt_up);
+		counters_add(&cnt_up, CNT_UP_GIVE_UP, 1);
+		counters_end(&cnt_up);
+		counters_begin(&dest[0].cnt);
+		counters_add(&dest[0].cnt, CNT_DEST_GIVE_UP, 1);
+		counters_end(&dest[0].cnt);
+		i = spool_push(push_body[s->body].dgram, push_body[s->body].size);
+		if ((i > 0) && replay_in_flight) {
+			/* the head of the spool was discarded, forget the replay in progress */
+			for (j = 0; j < push_pool_size; ++j) {
+				if (dest[0].pool[j].used && dest[0].pool[j].replay) {
+					push_release(0, j);
+				}
+			}
+			replay_in_flight = false;
+		}
+		if (i >= 0) {
+			counters_begin(&cnt_up);
+			counters_add(&cnt_up, CNT_UP_SPOOLED, 1);
+			counters_add(&cnt_up, CNT_UP_SPOOL_LOST, i);
+			counters_end(&cnt_up);
+		}
+	}
+	push_release(0, idx);
+}
+
+/* room needed in the full pool: the datagram is dropped before its time-out, the server is not considered lost and nothing is spooled */
+static void push_evict(int d, int idx) {
+	if (dest[d].pool[idx].replay) {
+		replay_in_flight = false; /* still at the head of the spool */
+	} else {
+		counters_begin(&dest[d].cnt);
+		counters_add(&dest[d].cnt, CNT_DEST_EVICT, 1);
+		counters_end(&dest[d].cnt);
+		if (d == 0) {
+			counters_begin(&cnt_up);
+			counters_add(&cnt_up, CNT_UP_EVICT, 1);
+			counters_end(&cnt_up);
+		}
+	}
+	push_release(d, idx);
+}
+
+/* free a slot to make room, a datagram past its last time-out is given up as push_retransmit would do, any other is evicted */
+static void push_reclaim(int d, int idx, uint64_t now_ms) {
+	struct push_slot_s * s = &dest[d].pool[idx];
+	
+	if ((s->deadline_ms <= now_ms) && (s->replay || (s->attempts > push_retries))) {
+		push_give_up(d, idx);
+	} else {
+		push_evict(d, idx);
+	}
+}
+
+/* process the PUSH_ACK received from all destinations, waiting up to timeout_ms for the first one */
+static void push_receive_acks(int timeout_ms) {
+	int d, i, j, k;
+	int nb_ack;
+	int nb_pfd = 0;
+	uint8_t buff_ack[UDP_BATCH_MAX][32]; /* buffers to receive acknowledges */
+	struct iovec iov[UDP_BATCH_MAX];
+	struct msghdr msg[UDP_BATCH_MAX];
+	int len[UDP_BATCH_MAX];
+	struct pollfd pfd[DEST_MAX];
+	int pfd_dest[DEST_MAX];
+	struct timespec ack_time;
+	struct push_slot_s * s;
+	unsigned syscalls = 0;
+	unsigned nb_dgram = 0;
+	
+	/* only read the destinations waiting for acknowledges, late ones are drained with the next acknowledges */
+	for (d = 0; d < nb_dest; ++d) {
+		if ((dest[d].pool_used > 0) || dest[d].probe_pending) {
+			pfd[nb_pfd].fd = dest[d].sock;
+			pfd[nb_pfd].events = POLLIN;
+			pfd[nb_pfd].revents = POLLIN; /* read without polling if there is a single socket */
+			pfd_dest[nb_pfd] = d;
+			++nb_pfd;
+		}
+	}
+	if ((timeout_ms > 0) || (nb_pfd > 1)) {
+		i = poll(pfd, nb_pfd, timeout_ms); /* with no socket, simply wait */
+		if (timeout_ms == 0) {
+			++syscalls;
+		}
+		if (i <= 0) {
+			nb_pfd = 0;
+		}
+	}
+	for (k = 0; k < nb_pfd; ++k) {
+		if (pfd[k].revents == 0) {
+			continue;
+		}
+		d = pfd_dest[k];
+		do {
+			memset(msg, 0, sizeof msg);
+			for (j = 0; j < UDP_BATCH_MAX; ++j) {
+				iov[j].iov_base = (void *)buff_ack[j];
+				iov[j].iov_len = sizeof buff_ack[j];
+				msg[j].msg_iov = &iov[j];
+				msg[j].msg_iovlen = 1;
+			}
+			nb_ack = udp_recv_batch(dest[d].sock, msg, len, UDP_BATCH_MAX, &syscalls); /* nothing more to read, or server connection error */
+			clock_gettime(CLOCK_MONOTONIC, &ack_time);
+			nb_dgram += nb_ack;
+			for (j = 0; j < nb_ack; ++j) {
+				if ((len[j] < 4) || (buff_ack[j][0] != PROTOCOL_VERSION) || (buff_ack[j][3] != PKT_PUSH_ACK)) {
+					//MSG("WARNING: [up] ignored invalid non-ACL packet\n");
+					continue;
+				}
+				if (dest[d].probe_pending && (buff_ack[j][1] == dest[d].probe_hdr[1]) && (buff_ack[j][2] == dest[d].probe_hdr[2])) {
+					dest[d].probe_pending = false;
+					dest[d].alt_ok = true;
+					LOG(LOG_NOTICE,"[up] %s:%s accepts %s\n", dest[d].addr, dest[d].port_up, (push_alt == PKT_PUSH_DATA_BIN) ? "PUSH_DATA_BIN" : "PUSH_DATA_LZ");
+					continue;
+				}
+				for (i = 0; i < push_pool_size; ++i) {
+					if (dest[d].pool[i].used && (buff_ack[j][1] == dest[d].pool[i].hdr[1]) && (buff_ack[j][2] == dest[d].pool[i].hdr[2])) {
+						break;
+					}
+				}
+				if (i == push_pool_size) {
+					//MSG("WARNING: [up] ignored out-of sync ACK packet\n");
+					continue;
+				}
+				s = &dest[d].pool[i];
+				//MSG("INFO: [up] ACK received :)\n"); /* too verbose */
+				if (s->replay) {
+					spool_pop();
+					replay_in_flight = false;
+					counters_begin(&cnt_up);
+					counters_add(&cnt_up, CNT_UP_REPLAYED, 1);
+					counters_end(&cnt_up);
+				} else {
+					counters_begin(&dest[d].cnt);
+					counters_add(&dest[d].cnt, CNT_DEST_ACK_RCV, 1);
+					counters_add(&dest[d].cnt, (s->attempts == 1) ? CNT_DEST_ACK_FIRST : CNT_DEST_ACK_RETRY, 1);
+					counters_end(&dest[d].cnt);
+					if (d == 0) {
+						counters_begin(&cnt_up);
+						counters_add(&cnt_up, CNT_UP_ACK_RCV, 1);
+						if (s->attempts == 1) {
+							counters_add(&cnt_up, CNT_UP_ACK_FIRST, 1);
+							hist_record(&lat_up.push_ack, elapsed_us(&s->send_time, &ack_time)); /* unambiguous round trip only */
+						} else {
+							counters_add(&cnt_up, CNT_UP_ACK_RETRY, 1);
+						}
+						counters_end(&cnt_up);
+					}
+				}
+				push_release(d, i);
+				if (d == 0) {
+					link_up = true;
+				}
+			}
+		} while (nb_ack == UDP_BATCH_MAX);
+	}
+	if (syscalls > 0) {
+		counters_begin(&cnt_up);
+		counters_add(&cnt_up, CNT_UP_SYSCALL, syscalls);
+		counters_add(&cnt_up, CNT_UP_IO_DGRAM, nb_dgram);
+		counters_end(&cnt_up);
+	}
+}
+
+/* send again the datagrams whose acknowledge is late (same token), with exponential backoff */
+static void push_retransmit(void) {
+	int d, i;
+	uint64_t now_ms = 0;
+	struct push_slot_s * s;
+	
+	for (d = 0; d < nb_dest; ++d) {
+		if (dest[d].pool_used == 0) {
+			continue;
+		}
+		if (now_ms == 0) {
+			now_ms = monotonic_ms();
+		}
+		for (i = 0; i < push_pool_size; ++i) {
+			s = &dest[d].pool[i];
+			if (!s->used || (s->deadline_ms > now_ms)) {
+				continue;
+			}
+			if (s->replay || (s->attempts > push_retries)) {
+				push_give_up(d, i); /* spooled datagrams are not retransmitted, they stay in the spool */
+				continue;
+			}
+			push_transmit(d, i);
+			s->deadline_ms = now_ms + ((uint64_t)push_timeout_ms << s->attempts);
+			s->attempts += 1;
+			counters_begin(&dest[d].cnt);
+			counters_add(&dest[d].cnt, CNT_DEST_RETRANSMIT, 1);
+			counters_end(&dest[d].cnt);
+			if (d == 0) {
+				counters_begin(&cnt_up);
+				counters_add(&cnt_up, CNT_UP_RETRANSMIT, 1);
+				counters_end(&cnt_up);
+			}
+		}
+	}
+}
+
+/* offer the configured encoding to the destinations that did not accept it yet: an empty datagram of that type, outside the pool */
+static void push_probe(void) {
+	int d;
+	uint64_t now_ms;
+	
+	if (push_alt == 0) {
+		return;
+	}
+	now_ms = monotonic_ms();
+	for (d = 0; d < nb_dest; ++d) {
+		if (dest[d].alt_ok || (now_ms < dest[d].next_probe_ms)) {
+			continue;
+		}
+		dest[d].probe_hdr[0] = PROTOCOL_VERSION;
+		dest[d].probe_hdr[1] = (uint8_t)rand();
+		dest[d].probe_hdr[2] = (uint8_t)rand();
+		dest[d].probe_hdr[3] = push_alt;
+		*(uint32_t *)(dest[d].probe_hdr + 4) = net_mac_h;
+		*(uint32_t *)(dest[d].probe_hdr + 8) = net_mac_l;
+		send(dest[d].sock, (void *)dest[d].probe_hdr, sizeof dest[d].probe_hdr, MSG_DONTWAIT);
+		dest[d].probe_pending = true;
+		dest[d].next_probe_ms = now_ms + PUSH_PROBE_MS;
+	}
+}
+
+/* binary or compressed datagrams only if every destination decodes them, the datagram body is shared */
+static bool push_alt_agreed(void) {
+	int d;
+	
+	if (push_alt == 0) {
+		return false;
+	}
+	for (d = 0; d < nb_dest; ++d) {
+		if (!dest[d].alt_ok) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* render the fixed metadata of a packet, from "chan" to "codr" (RXPK_FRAG_SIZE max), return its size */
+static int render_rxpk_fragment(const struct lgw_pkt_rx_s * p, uint8_t * buff) {
+	int j;
+	int buff_index = 0;
+	
+	/* Packet concentrator channel, RF chain & RX frequency */
+	j = snprintf((char *)(buff + buff_index),39 , ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
+	if ((j>=0) && (j < 39)) {
+		buff_index += j;
+	} else {
+		LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
+		exit(EXIT_FAILURE);
+	}
+	
+	/* Packet status */
+	switch (p->status) {
+		case STAT_CRC_OK:
+			memcpy((void *)(buff + buff_index), (void *)",\"stat\":1", 9);
+			buff_index += 9;
+			break;
+		case STAT_CRC_BAD:
+			memcpy((void *)(buff + buff_index), (void *)",\"stat\":-1", 10);
+			buff_index += 10;
+			break;
+		case STAT_NO_CRC:
+			memcpy((void *)(buff + buff_index), (void *)",\"stat\":0", 9);
+			buff_index += 9;
+			break;
+		default:
+			LOG(LOG_ERR,"[up] received packet with unknown status\n");
+			memcpy((void *)(buff + buff_index), (void *)",\"stat\":?", 9);
+			buff_index += 9;
+			exit(EXIT_FAILURE);
+	}
+	
+	/* Packet modulation */
+	if (p->modulation == MOD_LORA) {
+		memcpy((void *)(buff + buff_index), (void *)",\"modu\":\"LORA\"", 14);
+		buff_index += 14;
+		
+		/* Lora datarate & bandwidth*/
+		switch (p->datarate) {
+			case DR_LORA_SF7:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF7", 12);
+				buff_index += 12;
+				break;
+			case DR_LORA_SF8:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF8", 12);
+				buff_index += 12;
+				break;
+			case DR_LORA_SF9:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF9", 12);
+				buff_index += 12;
+				break;
+			case DR_LORA_SF10:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF10", 13);
+				buff_index += 13;
+				break;
+			case DR_LORA_SF11:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF11", 13);
+				buff_index += 13;
+				break;
+			case DR_LORA_SF12:
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF12", 13);
+				buff_index += 13;
+				break;
+			default:
+				LOG(LOG_ERR,"[up] lora packet with unknown datarate\n");
+				memcpy((void *)(buff + buff_index), (void *)",\"datr\":\"SF?", 12);
+				buff_index += 12;
+				exit(EXIT_FAILURE);
+		}
+		switch (p->bandwidth) {
+			case BW_125KHZ:
+				memcpy((void *)(buff + buff_index), (void *)"BW125\"", 6);
+				buff_index += 6;
+				break;
+			case BW_250KHZ:
+				memcpy((void *)(buff + buff_index), (void *)"BW250\"", 6);
+				buff_index += 6;
+				break;
+			case BW_500KHZ:
+				memcpy((void *)(buff + buff_index), (void *)"BW500\"", 6);
+				buff_index += 6;
+				break;
+			default:
+				LOG(LOG_ERR,"[up] lora packet with unknown bandwidth\n");
+				memcpy((void *)(buff + buff_index), (void *)"BW?\"", 4);
+				buff_index += 4;
+				exit(EXIT_FAILURE);
+		}
+		
+		/* Packet ECC coding rate */
+		switch (p->coderate) {
+			case CR_LORA_4_5:
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"4/5\"", 13);
+				buff_index += 13;
+				break;
+			case CR_LORA_4_6:
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"4/6\"", 13);
+				buff_index += 13;
+				break;
+			case CR_LORA_4_7:
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"4/7\"", 13);
+				buff_index += 13;
+				break;
+			case CR_LORA_4_8:
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"4/8\"", 13);
+				buff_index += 13;
+				break;
+			case 0: /* treat the CR0 case (mostly false sync) */
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"OFF\"", 13);
+				buff_index += 13;
+				break;
+			default:
+				LOG(LOG_ERR,"[up] lora packet with unknown coderate\n");
+				memcpy((void *)(buff + buff_index), (void *)",\"codr\":\"?\"", 11);
+				buff_index += 11;
+				exit(EXIT_FAILURE);
+		}
+	} else if (p->modulation == MOD_FSK) {
+		memcpy((void *)(buff + buff_index), (void *)",\"modu\":\"FSK\"", 13);
+		buff_index += 13;
+		
+		// TODO: add datarate metadata
+	} else {
+                    LOG(LOG_ERR,"[up] received packet with unknown modulation\n");
+		exit(EXIT_FAILURE);
+	}
+	return buff_index;
+}
+
+/* copy the fixed metadata of a packet, rendered the first time its combination of channel, status, modulation, datarate and coding rate is seen, return its size */
+static int copy_rxpk_fragment(const struct lgw_pkt_rx_s * p, uint8_t * buff) {
+	int i;
+	uint32_t plan = channel_plan;
+	
+	if (plan != rxpk_frag_plan) {
+		for (i = 0; i < RXPK_FRAG_NB; ++i) {
+			rxpk_frag[i].used = false;
+		}
+		rxpk_frag_next = 0;
+		rxpk_frag_plan = plan;
+	}
+	for (i = 0; i < RXPK_FRAG_NB; ++i) {
+		if (!rxpk_frag[i].used) {
+			break; /* entries are used in order */
+		}
+		if ((rxpk_frag[i].freq_hz == p->freq_hz) && (rxpk_frag[i].datarate == p->datarate) && (rxpk_frag[i].if_chain == p->if_chain) && (rxpk_frag[i].rf_chain == p->rf_chain) && (rxpk_frag[i].status == p->status) && (rxpk_frag[i].modulation == p->modulation) && (rxpk_frag[i].bandwidth == p->bandwidth) && (rxpk_frag[i].coderate == p->coderate)) {
+			memcpy(buff, rxpk_frag[i].json, rxpk_frag[i].size);
+			return rxpk_frag[i].size;
+		}
+	}
+	
+	/* first sight: render it in a free entry, or in place of the oldest one */
+	if (i == RXPK_FRAG_NB) {
+		i = rxpk_frag_next;
+		rxpk_frag_next = (rxpk_frag_next + 1) % RXPK_FRAG_NB;
+	}
+	rxpk_frag[i].used = true;
+	rxpk_frag[i].if_chain = p->if_chain;
+	rxpk_frag[i].rf_chain = p->rf_chain;
+	rxpk_frag[i].freq_hz = p->freq_hz;
+	rxpk_frag[i].status = p->status;
+	rxpk_frag[i].modulation = p->modulation;
+	rxpk_frag[i].datarate = p->datarate;
+	rxpk_frag[i].bandwidth = p->bandwidth;
+	rxpk_frag[i].coderate = p->coderate;
+	rxpk_frag[i].size = render_rxpk_fragment(p, rxpk_frag[i].json);
+	memcpy(buff, rxpk_frag[i].json, rxpk_frag[i].size);
+	return rxpk_frag[i].size;
+}
+
+/* serialize the metadata and payload of a packet as a JSON rxpk object, return its size (RXPK_MAX_SIZE max) */
+static int serialize_rxpk(const struct lgw_pkt_rx_s * p, const char * timestamp, uint8_t * buff_up) {
+	int j;
+	int buff_index = 0;
+	
+	/* Start of packet */
+	buff_up[buff_index] = '{';
+	++buff_index;
+	
+	/* RAW timestamp */
+	j = snprintf((char *)(buff_up + buff_index),19 , "\"tmst\":%u", p->count_us);
+	if ((j>=0) && (j < 19)) {
+		buff_index += j;
+	} else {
+		LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
+		exit(EXIT_FAILURE);
+	}
+	
+	/* Packet RX time (system time based) */
+	memcpy((void *)(buff_up + buff_index), (void *)",\"time\":\"???????????????????????????\"", 37);
+	memcpy((void *)(buff_up + buff_index + 9), (void *)timestamp, 27);
+	buff_index += 37;
+	
+	/* Packet concentrator channel, RF chain, RX frequency, status, modulation, datarate and coding rate */
+	buff_index += copy_rxpk_fragment(p, buff_up + buff_index);
+	
+	/* Lora SNR */
+	if (p->modulation == MOD_LORA) {
+		j = snprintf((char *)(buff_up + buff_index), 14, ",\"lsnr\":%.1f", p->snr);
+		if ((j>=0) && (j < 14)) {
+			buff_index += j;
+		} else {
+			LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	/* Packet RSSI, payload size */
+	j = snprintf((char *)(buff_up + buff_index), 23, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
+	if ((j>=0) && (j < 23)) {
+		buff_index += j;
+	} else {
+		LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
+		exit(EXIT_FAILURE);
+	}
+	
+	/* Packet base64-encoded payload */
+	memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
+	buff_index += 9;
+	j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
+	if (j>=0) {
+		buff_index += j;
+	} else {
+		LOG(LOG_ERR,"[up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
+		exit(EXIT_FAILURE);
+	}
+	buff_up[buff_index] = '"';
+	++buff_index;
+	
+	/* End of packet serialization */
+	buff_up[buff_index] = '}';
+	++buff_index;
+	return buff_index;
+}
+
+/* write the header of a datagram, and the start of the JSON object for a PUSH_DATA or PUSH_DATA_LZ, return the offset of the first packet */
+static int start_push_data(uint8_t * buff, uint8_t type) {
+	buff[0] = PROTOCOL_VERSION;
+	buff[3] = type;
+	*(uint32_t *)(buff + 4) = net_mac_h;
+	*(uint32_t *)(buff + 8) = net_mac_l;
+	if (type == PKT_PUSH_DATA_BIN) {
+		return 12;
+	}
+	memcpy((void *)(buff + 12), (void *)"{\"rxpk\":[", 9);
+	return 12 + 9;
+}
+
+/* close the JSON array of a pending PUSH_DATA (nothing to close for PUSH_DATA_BIN) and send it, compressed for PUSH_DATA_LZ, buff must have room for 3 more bytes */
+/* the buffer is kept until acknowledged, *buff_ptr receives a free one in exchange (nothing is copied) */
+static void send_push_data(uint8_t ** buff_ptr, int size, unsigned nb_pkt, const struct timespec * hold_start) {
+	static uint8_t * buff_lz = push_buff[PUSH_POOL_MAX + 1]; /* compressed datagram */
+	uint8_t * buff = *buff_ptr;
+	uint8_t ** sent = buff_ptr;
+	struct timespec send_time;
+	struct timespec lz_start;
+	int ppd;
+	int lz_size;
+	int json_size = 0;
+	bool bin = (buff[3] == PKT_PUSH_DATA_BIN);
+	
+	if (!bin) {
+		/* end of packet array */
+		buff[size] = ']';
+		++size;
+		
+		/* end of JSON datagram payload */
+		buff[size] = '}';
+		++size;
+		buff[size] = 0; /* add string terminator, for safety */
+		dump_json(buff, 12); //header size (before json) is 12
+	}
+	
+	/* compressed datagram: header, dictionary, JSON size, then the LZ stream; sent as JSON if it does not shrink */
+	if (buff[3] == PKT_PUSH_DATA_LZ) {
+		clock_gettime(CLOCK_MONOTONIC, &lz_start);
+		lz_size = json_lz_compress(&push_lz, buff + 12, size - 12, buff_lz + 15, size - 15);
+		clock_gettime(CLOCK_MONOTONIC, &send_time);
+		hist_record(&lat_up.compress, elapsed_us(&lz_start, &send_time));
+		if (lz_size > 0) {
+			memcpy(buff_lz, buff, 12);
+			buff_lz[12] = JSON_LZ_DICT_RXPK;
+			buff_lz[13] = 0xFF & (size - 12);
+			buff_lz[14] = 0xFF & ((size - 12) >> 8);
+			json_size = size;
+			sent = &buff_lz;
+			size = 15 + lz_size;
+		} else {
+			buff[3] = PKT_PUSH_DATA;
+		}
+	}
+	
+	/* send datagram to server, it is kept until acknowledged */
+	push_send(sent, size, false);
+	push_flush();
+	clock_gettime(CLOCK_MONOTONIC, &send_time);
+	hist_record(&lat_up.fetch_send, elapsed_us(hold_start, &send_time));
+	if (nb_pkt <= 2) {
+		ppd = CNT_UP_PPD_1 + nb_pkt - 1;
+	} else if (nb_pkt <= 4) {
+		ppd = CNT_UP_PPD_3_4;
+	} else if (nb_pkt <= 8) {
+		ppd = CNT_UP_PPD_5_8;
+	} else {
+		ppd = CNT_UP_PPD_9_MORE;
+	}
+	counters_begin(&cnt_up);
+	counters_add(&cnt_up, CNT_UP_DGRAM_SENT, 1);
+	counters_add(&cnt_up, CNT_UP_NETWORK_BYTE, size);
+	if (json_size > 0) {
+		counters_add(&cnt_up, CNT_UP_COPY_BYTE, 12); /* header of the compressed datagram */
+	}
+	if (bin) {
+		counters_add(&cnt_up, CNT_UP_BIN_PKT, nb_pkt);
+		counters_add(&cnt_up, CNT_UP_BIN_BYTE, size);
+	} else if (json_size > 0) {
+		counters_add(&cnt_up, CNT_UP_LZ_PKT, nb_pkt);
+		counters_add(&cnt_up, CNT_UP_LZ_BYTE, size);
+		counters_add(&cnt_up, CNT_UP_LZ_JSON_BYTE, json_size);
+	} else {
+		counters_add(&cnt_up, CNT_UP_JSON_PKT, nb_pkt);
+	}
+	if ((unsigned)size > dgram_size_max) {
+		counters_add(&cnt_up, CNT_UP_DGRAM_OVERSIZE, 1);
+	}
+	counters_add(&cnt_up, ppd, 1);
+	counters_end(&cnt_up);
+}
+
+/*  Print out json to stdout/stderr or syslog, depending on local configuration */
+static void dump_json(uint8_t * json_buff, int header_size){
+        //TODO implement better way to discern between upstream and downstream
+        LOG(LOG_INFO,"[%s] JSON : %s \n", (header_size==4? "down":"up"), (char *)(json_buff + header_size));
+
+}
+
+/*  Print out json and payload in HEX to stdout/stderr or syslog, depending on local configuration */
+static void dump_packet(const uint8_t* payload,int payload_size, uint8_t * json_buff, int header_size, uint8_t stream){
+        if (!LOG_ENABLED(LOG_INFO)) {
+                return; /* nothing would be displayed, skip the conversion */
+        }
+
+        dump_json(json_buff,header_size);
+        dump_payload(payload,payload_size,stream);
+}
+
+/*  Print out payload in HEX to stdout/stderr or syslog, depending on local configuration */
+static void dump_payload(const uint8_t* payload,int payload_size, uint8_t stream){
+        static const char hex_digits[16] = "0123456789ABCDEF";
+        char hex_buff[2*256+1]; // 1 byte is 2 HEX digits (in
+                                      // hex string) +1 for '\0'
+        char *ptr_hex = hex_buff; // moving pointer
+
+        if (!LOG_ENABLED(LOG_INFO)) {
+                return; /* nothing would be displayed, skip the conversion */
+        }
+
+        // convert payload to hex string
+        for (int i = 0; (i < payload_size) && (i < 256); i++)
+		{
+                *ptr_hex++ = hex_digits[payload[i] >> 4];
+                *ptr_hex++ = hex_digits[payload[i] & 0x0F];
+		}
+        *ptr_hex = 0;
+
+        LOG(LOG_INFO,"[%s]The payload in HEX: %s\n",((stream==UPSTREAM)?"up":"down"), hex_buff);
+}
+
+
+
+
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+
+    openlog("basic_pkt_fwd", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
+	struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
+	int i, j; /* loop variables and temporary variable for return value */
+	int sock;
+	
+	/* configuration file related */
+	char *global_cfg_path= "global_conf.json"; /* contain global (typ. network-wide) configuration */
+	char *local_cfg_path = "local_conf.json"; /* contain node specific configuration, overwrite global parameters for parameters that are defined in both */
+	char *debug_cfg_path = "debug_conf.json"; /* if present, all other configuration files are ignored */
+	
+	/* threads */
+	pthread_t thrid_up;
+	pthread_t thrid_down;
+	
+	/* network socket creation */
+	struct addrinfo hints;
+	struct addrinfo *result; /* store result of getaddrinfo */
+	struct addrinfo *q; /* pointer to move into *result data */
+	char host_name[64];
+	char port_name[64];
+	
+	/* variables to get local copies of measurements */
+	uint32_t cp_nb_rx_rcv;
+	uint32_t cp_nb_rx_ok;
+	uint32_t cp_nb_rx_bad;
+	uint32_t cp_nb_rx_nocrc;
+	uint32_t cp_up_pkt_fwd;
+	uint32_t cp_up_network_byte;
+	uint32_t cp_up_payload_byte;
+	uint32_t cp_up_dgram_sent;
+	uint32_t cp_up_ack_rcv;
+	uint32_t cp_up_ack_first;
+	uint32_t cp_up_ack_retry;
+	uint32_t cp_up_retransmit;
+	uint32_t cp_up_give_up;
+	uint32_t cp_up_evict;
+	uint32_t cp_up_spooled;
+	uint32_t cp_up_replayed;
+	uint32_t cp_up_spool_lost;
+	uint32_t cp_up_syscall;
+	uint32_t cp_up_io_dgram;
+	uint32_t cp_up_ppd[5];
+	uint32_t cp_up_split;
+	uint32_t cp_up_oversize;
+	uint32_t cp_up_wakeup;
+	uint32_t cp_up_fetch;
+	uint32_t cp_up_fetch_full;
+	uint32_t cp_up_json_pkt;
+	uint32_t cp_up_bin_pkt;
+	uint32_t cp_up_bin_byte;
+	uint32_t cp_up_lz_pkt;
+	uint32_t cp_up_lz_byte;
+	uint32_t cp_up_lz_json_byte;
+	uint32_t cp_up_copy_byte;
+	uint32_t cp_dw_pull_sent;
+	uint32_t cp_dw_ack_rcv;
+	uint32_t cp_dw_dgram_rcv;
+	uint32_t cp_dw_network_byte;
+	uint32_t cp_dw_payload_byte;
+	uint32_t cp_nb_tx_ok;
+	uint32_t cp_nb_tx_fail;
+	uint32_t cp_dw_syscall;
+	uint32_t cp_dw_io_dgram;
+	
+	/* statistics variable */
+	time_t t;
+	char stat_timestamp[24];
+	float rx_ok_ratio;
 	float rx_bad_ratio;
 	float rx_nocrc_ratio;
 	float up_ack_ratio;
 	float dw_ack_ratio;
+	uint64_t cur_up[CNT_UP_NB];
+	uint64_t cur_dw[CNT_DW_NB];
+	static uint64_t prev_up[CNT_UP_NB]; /* counters at the time of the last report */
+	static uint64_t prev_dw[CNT_DW_NB];
+	struct logging_counters_s log_cnt;
+	static struct logging_counters_s prev_log_cnt;
+	uint32_t metrics_trunc;
+	static uint32_t prev_metrics_trunc = 0;
+	uint64_t cur_dest[CNT_DEST_NB];
+	static uint64_t prev_dest[DEST_MAX][CNT_DEST_NB];
+	uint32_t cp_dest[CNT_DEST_NB];
+	uint64_t cur_flt[CNT_FLT_NB];
+	static uint64_t prev_flt[CNT_FLT_NB];
+	uint32_t cp_flt[CNT_FLT_NB];
+	uint64_t cur_prio[CNT_PRIO_NB];
+	static uint64_t prev_prio[CNT_PRIO_NB];
+	uint32_t cp_prio[CNT_PRIO_NB];
+	struct rate_offender_s top[TOP_OFFENDERS];
+	unsigned nb_top, rate_nb;
+	uint32_t rate_evict;
+	char offenders[TOP_OFFENDERS * 24];
+	int k;
+	
+	/* previous snapshots of the latency histograms */
+	static struct hist_s prev_receive, prev_poll, prev_fetch_send, prev_push_ack, prev_compress, prev_pull_ack, prev_pull_resp;
+	static struct hist_s prev_concent[2];
+	struct hist_s concent[2];
 	
 	/* display version informations */
 	LOG(LOG_NOTICE,"*** Basic Packet Forwarder for Lora Gateway ***\nVersion: " VERSION_STRING "\n");
@@ -635,41 +2586,30 @@ int main(void)
 	
 	/* prepare hints to open network sockets */
 	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC; /* should handle IP v4 or v6 automatically */
-	hints.ai_socktype = SOCK_DGRAM;
-	
-	/* look for server address w/ upstream port */
-	i = getaddrinfo(serv_addr, serv_port_up, &hints, &result);
-	if (i != 0) {
-		LOG(LOG_ERR,"[up] getaddrinfo on address %s (PORT %s) returned %s\n", serv_addr, serv_port_up, gai_strerror(i));
-		exit(EXIT_FAILURE);
-	}
-	
-	/* try to open socket for upstream traffic */
-	for (q=result; q!=NULL; q=q->ai_next) {
-		sock_up = socket(q->ai_family, q->ai_socktype,q->ai_protocol);
-		if (sock_up == -1) continue; /* try next field */
-		else break; /* success, get out of loop */
-	}
-	if (q == NULL) {
-		LOG(LOG_ERR,"[up] failed to open socket to any of server %s addresses (port %s)\n", serv_addr, serv_port_up);
-		i = 1;
-		for (q=result; q!=NULL; q=q->ai_next) {
-			getnameinfo(q->ai_addr, q->ai_addrlen, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST);
-			LOG(LOG_INFO,"[up] result %i host:%s service:%s\n", i, host_name, port_name);
-			++i;
+	hints.ai_family = AF_UNSPEC; /* should handle IP v4 or v6 automatically */
+	hints.ai_socktype = SOCK_DGRAM;
+	
+	/* open the upstream sockets: the primary server is mandatory, the other destinations are skipped if unreachable */
+	snprintf(dest[0].addr, sizeof dest[0].addr, "%s", serv_addr);
+	snprintf(dest[0].port_up, sizeof dest[0].port_up, "%s", serv_port_up);
+	for (i = 0, j = 0; i < nb_dest; ++i) {
+		sock = open_socket_up(dest[i].addr, dest[i].port_up);
+		if (sock == -1) {
+			if (i == 0) {
+				exit(EXIT_FAILURE);
+			}
+			LOG(LOG_WARNING,"[up] uplinks will NOT be sent to %s (port %s)\n", dest[i].addr, dest[i].port_up);
+			continue;
 		}
-		exit(EXIT_FAILURE);
+		if (j != i) {
+			memcpy(dest[j].addr, dest[i].addr, sizeof dest[j].addr);
+			memcpy(dest[j].port_up, dest[i].port_up, sizeof dest[j].port_up);
+		}
+		dest[j].sock = sock;
+		++j;
 	}
+	nb_dest = j;
 	
-	/* connect so we can send/receive packet with the server only */
-	i = connect(sock_up, q->ai_addr, q->ai_addrlen);
-	if (i != 0) {
-		LOG(LOG_ERR,"[up] connect returned %s\n", strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-	freeaddrinfo(result);
-
 	/* look for server address w/ downstream port */
 	i = getaddrinfo(serv_addr, serv_port_down, &hints, &result);
 	if (i != 0) {
@@ -711,6 +2651,28 @@ int main(void)
 		exit(EXIT_FAILURE);
 	}
 	
+	/* empty the token buckets of the rate limiting */
+	rate_table_init(&rate_table);
+	
+	/* load the join filter, it is reloaded at each report when the file changes */
+	if (join_filter_path[0] != 0) {
+		join_filter_reload();
+	}
+	
+	/* open the spool of unacknowledged datagrams */
+	if (spool_path[0] != 0) {
+		if (spool_open(spool_path, spool_size) == SPOOL_SUCCESS) {
+			LOG(LOG_NOTICE,"[main] spool %s opened, %u datagrams to replay\n", spool_path, spool_count());
+		} else {
+			LOG(LOG_ERR,"[main] failed to open spool %s (min size %u bytes), unacknowledged datagrams will be lost\n", spool_path, SPOOL_SIZE_MIN);
+		}
+	}
+	
+	/* from now on, the packet path threads only queue their messages */
+	if (logging_start() != 0) {
+		LOG(LOG_WARNING,"[main] failed to start logging thread, logging stays synchronous\n");
+	}
+	
 	/* spawn threads to manage upstream and downstream */
 	i = pthread_create( &thrid_up, NULL, (void * (*)(void *))thread_up, NULL);
 	if (i != 0) {
@@ -731,6 +2693,16 @@ int main(void)
 	sigaction(SIGINT, &sigact, NULL); /* Ctrl-C */
 	sigaction(SIGTERM, &sigact, NULL); /* default "kill" command */
 	
+	/* start the metrics listener, if enabled */
+	start_time = time(NULL);
+	if (metrics_port[0] != 0) {
+		if (metrics_start(metrics_port, render_metrics) == METRICS_SUCCESS) {
+			LOG(LOG_NOTICE,"[main] metrics available on http://localhost:%s/metrics\n", metrics_port);
+		} else {
+			LOG(LOG_WARNING,"[main] failed to start metrics listener on port %s\n", metrics_port);
+		}
+	}
+	
 	/* main loop task : statistics collection */
 	while (!exit_sig && !quit_sig) {
 		/* wait for next reporting interval */
@@ -740,27 +2712,54 @@ int main(void)
 		t = time(NULL);
 		strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
 		
-		/* access upstream statistics, copy and reset them */
-		pthread_mutex_lock(&mx_meas_up);
-		cp_nb_rx_rcv       = meas_nb_rx_rcv;
-		cp_nb_rx_ok        = meas_nb_rx_ok;
-		cp_nb_rx_bad       = meas_nb_rx_bad;
-		cp_nb_rx_nocrc     = meas_nb_rx_nocrc;
-		cp_up_pkt_fwd      = meas_up_pkt_fwd;
-		cp_up_network_byte = meas_up_network_byte;
-		cp_up_payload_byte = meas_up_payload_byte;
-		cp_up_dgram_sent   = meas_up_dgram_sent;
-		cp_up_ack_rcv      = meas_up_ack_rcv;
-		meas_nb_rx_rcv = 0;
-		meas_nb_rx_ok = 0;
-		meas_nb_rx_bad = 0;
-		meas_nb_rx_nocrc = 0;
-		meas_up_pkt_fwd = 0;
-		meas_up_network_byte = 0;
-		meas_up_payload_byte = 0;
-		meas_up_dgram_sent = 0;
-		meas_up_ack_rcv = 0;
-		pthread_mutex_unlock(&mx_meas_up);
+		/* snapshot the counters and compute the statistics of the interval */
+		counters_snapshot(&cnt_up, cur_up, CNT_UP_NB);
+		counters_snapshot(&cnt_dw, cur_dw, CNT_DW_NB);
+		cp_nb_rx_rcv          = (uint32_t)(cur_up[CNT_RX_RCV] - prev_up[CNT_RX_RCV]);
+		cp_nb_rx_ok           = (uint32_t)(cur_up[CNT_RX_OK] - prev_up[CNT_RX_OK]);
+		cp_nb_rx_bad          = (uint32_t)(cur_up[CNT_RX_BAD] - prev_up[CNT_RX_BAD]);
+		cp_nb_rx_nocrc        = (uint32_t)(cur_up[CNT_RX_NOCRC] - prev_up[CNT_RX_NOCRC]);
+		cp_up_pkt_fwd         = (uint32_t)(cur_up[CNT_UP_PKT_FWD] - prev_up[CNT_UP_PKT_FWD]);
+		cp_up_network_byte    = (uint32_t)(cur_up[CNT_UP_NETWORK_BYTE] - prev_up[CNT_UP_NETWORK_BYTE]);
+		cp_up_payload_byte    = (uint32_t)(cur_up[CNT_UP_PAYLOAD_BYTE] - prev_up[CNT_UP_PAYLOAD_BYTE]);
+		cp_up_dgram_sent      = (uint32_t)(cur_up[CNT_UP_DGRAM_SENT] - prev_up[CNT_UP_DGRAM_SENT]);
+		cp_up_ack_rcv         = (uint32_t)(cur_up[CNT_UP_ACK_RCV] - prev_up[CNT_UP_ACK_RCV]);
+		cp_up_ack_first       = (uint32_t)(cur_up[CNT_UP_ACK_FIRST] - prev_up[CNT_UP_ACK_FIRST]);
+		cp_up_ack_retry       = (uint32_t)(cur_up[CNT_UP_ACK_RETRY] - prev_up[CNT_UP_ACK_RETRY]);
+		cp_up_retransmit      = (uint32_t)(cur_up[CNT_UP_RETRANSMIT] - prev_up[CNT_UP_RETRANSMIT]);
+		cp_up_give_up         = (uint32_t)(cur_up[CNT_UP_GIVE_UP] - prev_up[CNT_UP_GIVE_UP]);
+		cp_up_evict           = (uint32_t)(cur_up[CNT_UP_EVICT] - prev_up[CNT_UP_EVICT]);
+		cp_up_spooled         = (uint32_t)(cur_up[CNT_UP_SPOOLED] - prev_up[CNT_UP_SPOOLED]);
+		cp_up_replayed        = (uint32_t)(cur_up[CNT_UP_REPLAYED] - prev_up[CNT_UP_REPLAYED]);
+		cp_up_spool_lost      = (uint32_t)(cur_up[CNT_UP_SPOOL_LOST] - prev_up[CNT_UP_SPOOL_LOST]);
+		cp_up_syscall         = (uint32_t)(cur_up[CNT_UP_SYSCALL] - prev_up[CNT_UP_SYSCALL]);
+		cp_up_io_dgram        = (uint32_t)(cur_up[CNT_UP_IO_DGRAM] - prev_up[CNT_UP_IO_DGRAM]);
+		for (i = 0; i < 5; ++i) {
+			cp_up_ppd[i]      = (uint32_t)(cur_up[CNT_UP_PPD_1 + i] - prev_up[CNT_UP_PPD_1 + i]);
+		}
+		cp_up_split           = (uint32_t)(cur_up[CNT_UP_DGRAM_SPLIT] - prev_up[CNT_UP_DGRAM_SPLIT]);
+		cp_up_oversize        = (uint32_t)(cur_up[CNT_UP_DGRAM_OVERSIZE] - prev_up[CNT_UP_DGRAM_OVERSIZE]);
+		cp_up_wakeup          = (uint32_t)(cur_up[CNT_UP_WAKEUP] - prev_up[CNT_UP_WAKEUP]);
+		cp_up_fetch           = (uint32_t)(cur_up[CNT_UP_FETCH] - prev_up[CNT_UP_FETCH]);
+		cp_up_fetch_full      = (uint32_t)(cur_up[CNT_UP_FETCH_FULL] - prev_up[CNT_UP_FETCH_FULL]);
+		cp_up_json_pkt        = (uint32_t)(cur_up[CNT_UP_JSON_PKT] - prev_up[CNT_UP_JSON_PKT]);
+		cp_up_bin_pkt         = (uint32_t)(cur_up[CNT_UP_BIN_PKT] - prev_up[CNT_UP_BIN_PKT]);
+		cp_up_bin_byte        = (uint32_t)(cur_up[CNT_UP_BIN_BYTE] - prev_up[CNT_UP_BIN_BYTE]);
+		cp_up_lz_pkt          = (uint32_t)(cur_up[CNT_UP_LZ_PKT] - prev_up[CNT_UP_LZ_PKT]);
+		cp_up_lz_byte         = (uint32_t)(cur_up[CNT_UP_LZ_BYTE] - prev_up[CNT_UP_LZ_BYTE]);
+		cp_up_lz_json_byte    = (uint32_t)(cur_up[CNT_UP_LZ_JSON_BYTE] - prev_up[CNT_UP_LZ_JSON_BYTE]);
+		cp_up_copy_byte       = (uint32_t)(cur_up[CNT_UP_COPY_BYTE] - prev_up[CNT_UP_COPY_BYTE]);
+		cp_dw_pull_sent       = (uint32_t)(cur_dw[CNT_DW_PULL_SENT] - prev_dw[CNT_DW_PULL_SENT]);
+		cp_dw_ack_rcv         = (uint32_t)(cur_dw[CNT_DW_ACK_RCV] - prev_dw[CNT_DW_ACK_RCV]);
+		cp_dw_dgram_rcv       = (uint32_t)(cur_dw[CNT_DW_DGRAM_RCV] - prev_dw[CNT_DW_DGRAM_RCV]);
+		cp_dw_network_byte    = (uint32_t)(cur_dw[CNT_DW_NETWORK_BYTE] - prev_dw[CNT_DW_NETWORK_BYTE]);
+		cp_dw_payload_byte    = (uint32_t)(cur_dw[CNT_DW_PAYLOAD_BYTE] - prev_dw[CNT_DW_PAYLOAD_BYTE]);
+		cp_nb_tx_ok           = (uint32_t)(cur_dw[CNT_TX_OK] - prev_dw[CNT_TX_OK]);
+		cp_nb_tx_fail         = (uint32_t)(cur_dw[CNT_TX_FAIL] - prev_dw[CNT_TX_FAIL]);
+		cp_dw_syscall         = (uint32_t)(cur_dw[CNT_DW_SYSCALL] - prev_dw[CNT_DW_SYSCALL]);
+		cp_dw_io_dgram        = (uint32_t)(cur_dw[CNT_DW_IO_DGRAM] - prev_dw[CNT_DW_IO_DGRAM]);
+		memcpy(prev_up, cur_up, sizeof prev_up);
+		memcpy(prev_dw, cur_dw, sizeof prev_dw);
 		if (cp_nb_rx_rcv > 0) {
 			rx_ok_ratio = (float)cp_nb_rx_ok / (float)cp_nb_rx_rcv;
 			rx_bad_ratio = (float)cp_nb_rx_bad / (float)cp_nb_rx_rcv;
@@ -775,24 +2774,6 @@ int main(void)
 		} else {
 			up_ack_ratio = 0.0;
 		}
-		
-		/* access downstream statistics, copy and reset them */
-		pthread_mutex_lock(&mx_meas_dw);
-		cp_dw_pull_sent    =  meas_dw_pull_sent;
-		cp_dw_ack_rcv      =  meas_dw_ack_rcv;
-		cp_dw_dgram_rcv    =  meas_dw_dgram_rcv;
-		cp_dw_network_byte =  meas_dw_network_byte;
-		cp_dw_payload_byte =  meas_dw_payload_byte;
-		cp_nb_tx_ok        =  meas_nb_tx_ok;
-		cp_nb_tx_fail      =  meas_nb_tx_fail;
-		meas_dw_pull_sent = 0;
-		meas_dw_ack_rcv = 0;
-		meas_dw_dgram_rcv = 0;
-		meas_dw_network_byte = 0;
-		meas_dw_payload_byte = 0;
-		meas_nb_tx_ok = 0;
-		meas_nb_tx_fail = 0;
-		pthread_mutex_unlock(&mx_meas_dw);
 		if (cp_dw_pull_sent > 0) {
 			dw_ack_ratio = (float)cp_dw_ack_rcv / (float)cp_dw_pull_sent;
 		} else {
@@ -805,24 +2786,111 @@ int main(void)
 		LOG(LOG_DEBUG,"# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
 		LOG(LOG_DEBUG,"# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
 		LOG(LOG_DEBUG,"# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
+		LOG(LOG_DEBUG,"# fetches with packets: %u, batch filled: %u, batch size: %u%s\n", cp_up_fetch, cp_up_fetch_full, fetch_batch, (fetch_adaptive ? " (adaptive)" : ""));
+		LOG(LOG_DEBUG,"# fetch wake-ups: %.1f/s, max wait: %u us\n", (float)cp_up_wakeup / (float)stat_interval, poll_max_us);
 		LOG(LOG_DEBUG,"# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
 		LOG(LOG_DEBUG,"# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
+		LOG(LOG_DEBUG,"# PUSH_DATA with 1 packet: %u, 2: %u, 3-4: %u, 5-8: %u, 9+: %u\n", cp_up_ppd[0], cp_up_ppd[1], cp_up_ppd[2], cp_up_ppd[3], cp_up_ppd[4]);
+		LOG(LOG_DEBUG,"# PUSH_DATA size limit: %u bytes, datagrams split: %u, oversize: %u\n", dgram_size_max, cp_up_split, cp_up_oversize);
+		LOG(LOG_DEBUG,"# PUSH_DATA JSON: %u packets, %.1f bytes/packet, binary: %u packets, %.1f bytes/packet%s\n", cp_up_json_pkt, (cp_up_json_pkt > 0) ? (float)(cp_up_network_byte - cp_up_bin_byte - cp_up_lz_byte) / cp_up_json_pkt : 0.0, cp_up_bin_pkt, (cp_up_bin_pkt > 0) ? (float)cp_up_bin_byte / cp_up_bin_pkt : 0.0, (push_alt == PKT_PUSH_DATA_BIN) ? (push_alt_agreed() ? " (binary in use)" : " (binary not accepted yet)") : "");
+		if (push_alt == PKT_PUSH_DATA_LZ) {
+			LOG(LOG_DEBUG,"# PUSH_DATA compressed: %u packets, %.1f bytes/packet, ratio %.2f%s\n", cp_up_lz_pkt, (cp_up_lz_pkt > 0) ? (float)cp_up_lz_byte / cp_up_lz_pkt : 0.0, (cp_up_lz_byte > 0) ? (float)cp_up_lz_json_byte / cp_up_lz_byte : 0.0, push_alt_agreed() ? "" : " (not accepted yet)");
+		}
+		LOG(LOG_DEBUG,"# PUSH_DATA bytes copied once encoded: %.1f per packet\n", (cp_up_pkt_fwd > 0) ? (float)cp_up_copy_byte / cp_up_pkt_fwd : 0.0);
+		LOG(LOG_DEBUG,"# PUSH_DATA acknowledged at first try: %u, after retry: %u, retransmissions: %u, given up: %u, evicted: %u\n", cp_up_ack_first, cp_up_ack_retry, cp_up_retransmit, cp_up_give_up, cp_up_evict);
+		if (cp_up_evict > 0) {
+			LOG(LOG_WARNING,"[up] %u PUSH_DATA dropped before their time-out, the pool of %i datagrams is too small for the datagram rate (push_pool_size)\n", cp_up_evict, push_pool_size);
+		}
+		if (spool_path[0] != 0) {
+			LOG(LOG_DEBUG,"# PUSH_DATA spooled: %u, replayed: %u, lost: %u, waiting: %u\n", cp_up_spooled, cp_up_replayed, cp_up_spool_lost, spool_count());
+		}
+		LOG(LOG_DEBUG,"# network system calls: %u for %u datagrams (%.2f per datagram)\n", cp_up_syscall, cp_up_io_dgram, (cp_up_io_dgram > 0) ? (float)cp_up_syscall / (float)cp_up_io_dgram : 0.0);
+		for (i = 0; (nb_dest > 1) && (i < nb_dest); ++i) {
+			counters_snapshot(&dest[i].cnt, cur_dest, CNT_DEST_NB);
+			for (j = 0; j < CNT_DEST_NB; ++j) {
+				cp_dest[j] = (uint32_t)(cur_dest[j] - prev_dest[i][j]);
+			}
+			memcpy(prev_dest[i], cur_dest, sizeof prev_dest[i]);
+			LOG(LOG_DEBUG,"# server %s:%s: %u datagrams (%u bytes), acknowledged at first try: %u, after retry: %u, retransmissions: %u, given up: %u, evicted: %u\n", dest[i].addr, dest[i].port_up, cp_dest[CNT_DEST_SENT], cp_dest[CNT_DEST_NETWORK_BYTE], cp_dest[CNT_DEST_ACK_FIRST], cp_dest[CNT_DEST_ACK_RETRY], cp_dest[CNT_DEST_RETRANSMIT], cp_dest[CNT_DEST_GIVE_UP], cp_dest[CNT_DEST_EVICT]);
+		}
+		counters_snapshot(&cnt_flt, cur_flt, CNT_FLT_NB);
+		for (j = 0; j < CNT_FLT_NB; ++j) {
+			cp_flt[j] = (uint32_t)(cur_flt[j] - prev_flt[j]);
+		}
+		memcpy(prev_flt, cur_flt, sizeof prev_flt);
+		LOG(LOG_DEBUG,"### [FILTERING] ###\n");
+		LOG(LOG_DEBUG,"# duplicates dropped: %u, ghosts (CR OFF): %u (%s)\n", cp_flt[CNT_FLT_DUP], cp_flt[CNT_FLT_GHOST], (fwd_ghosts ? "forwarded" : "dropped"));
+		if (lorawan_filter_on) {
+			LOG(LOG_DEBUG,"# LoRaWAN filter: foreign DevAddr: %u, denied DevAddr: %u, not LoRaWAN: %u (%s)\n", cp_flt[CNT_FLT_FOREIGN], cp_flt[CNT_FLT_DENIED], cp_flt[CNT_FLT_NOT_LORAWAN], (fwd_non_lorawan ? "forwarded" : "dropped"));
+		}
+		if (join_filter_path[0] != 0) {
+			join_filter_reload();
+			LOG(LOG_DEBUG,"# join requests forwarded: %u, filtered: %u (filter: %u EUIs, %u loads)\n", cp_flt[CNT_FLT_JOIN_FWD], cp_flt[CNT_FLT_JOIN_DROP], join_filter.nb_keys, join_filter_loads);
+		}
+		if (nb_rate_rule > 0) {
+			pthread_mutex_lock(&mx_rate_table);
+			nb_top = rate_top_offenders(&rate_table, top, TOP_OFFENDERS);
+			rate_nb = rate_table.nb;
+			rate_evict = rate_table.evictions;
+			pthread_mutex_unlock(&mx_rate_table);
+			LOG(LOG_DEBUG,"# rate limit: dropped: %u, downsampled: %u (devices tracked: %u, evicted: %u)\n", cp_flt[CNT_FLT_RATE_DROP], cp_flt[CNT_FLT_RATE_SAMPLED], rate_nb, rate_evict);
+			offenders[0] = 0;
+			for (j = 0, k = 0; j < (int)nb_top; ++j) {
+				k += snprintf(offenders + k, sizeof offenders - k, "%s%08X: %u", (j > 0) ? ", " : "", top[j].devaddr, top[j].dropped);
+			}
+			LOG(LOG_DEBUG,"# top offenders (packets dropped): %s\n", (nb_top > 0) ? offenders : "none");
+		}
+		counters_snapshot(&cnt_prio, cur_prio, CNT_PRIO_NB);
+		for (j = 0; j < CNT_PRIO_NB; ++j) {
+			cp_prio[j] = (uint32_t)(cur_prio[j] - prev_prio[j]);
+		}
+		memcpy(prev_prio, cur_prio, sizeof prev_prio);
+		LOG(LOG_DEBUG,"# priority high: %u forwarded, %u shed; medium: %u forwarded, %u shed; low: %u forwarded, %u shed\n", cp_prio[CNT_PRIO_FWD + PRIO_HIGH], cp_prio[CNT_PRIO_SHED + PRIO_HIGH], cp_prio[CNT_PRIO_FWD + PRIO_MEDIUM], cp_prio[CNT_PRIO_SHED + PRIO_MEDIUM], cp_prio[CNT_PRIO_FWD + PRIO_LOW], cp_prio[CNT_PRIO_SHED + PRIO_LOW]);
 		LOG(LOG_DEBUG,"### [DOWNSTREAM] ###\n");
 		LOG(LOG_DEBUG,"# PULL_DATA sent: %u (%.2f%% acknowledged)\n", cp_dw_pull_sent, 100.0 * dw_ack_ratio);
 		LOG(LOG_DEBUG,"# PULL_RESP(onse) datagrams received: %u (%u bytes)\n", cp_dw_dgram_rcv, cp_dw_network_byte);
 		LOG(LOG_DEBUG,"# RF packets sent to concentrator: %u (%u bytes)\n", (cp_nb_tx_ok+cp_nb_tx_fail), cp_dw_payload_byte);
 		LOG(LOG_DEBUG,"# TX errors: %u\n", cp_nb_tx_fail);
+		LOG(LOG_DEBUG,"# network system calls: %u for %u datagrams (%.2f per datagram)\n", cp_dw_syscall, cp_dw_io_dgram, (cp_dw_io_dgram > 0) ? (float)cp_dw_syscall / (float)cp_dw_io_dgram : 0.0);
+		LOG(LOG_DEBUG,"### [LATENCY] (us) ###\n");
+		report_latency("lgw_receive", &lat_up.receive, &prev_receive, 1);
+		report_latency("fetch interval", &lat_up.poll, &prev_poll, 1);
+		report_latency("fetch to send", &lat_up.fetch_send, &prev_fetch_send, 1);
+		report_latency("PUSH_ACK round trip", &lat_up.push_ack, &prev_push_ack, 1);
+		if (push_alt == PKT_PUSH_DATA_LZ) {
+			report_latency("PUSH_DATA compression", &lat_up.compress, &prev_compress, 1);
+		}
+		report_latency("PULL_ACK round trip", &lat_dw.pull_ack, &prev_pull_ack, 1);
+		report_latency("PULL_RESP to lgw_send", &lat_dw.pull_resp, &prev_pull_resp, 1);
+		hist_snapshot(&lat_up.concent, &concent[0]);
+		hist_snapshot(&lat_dw.concent, &concent[1]);
+		report_latency("concentrator wait", concent, prev_concent, 2);
+		logging_get_counters(&log_cnt);
+		LOG(LOG_DEBUG,"### [LOGGING] ###\n");
+		LOG(LOG_DEBUG,"# messages queued: %u, dropped: %u, truncated: %u\n", log_cnt.queued - prev_log_cnt.queued, log_cnt.dropped - prev_log_cnt.dropped, log_cnt.truncated - prev_log_cnt.truncated);
+		prev_log_cnt = log_cnt;
 		LOG(LOG_DEBUG,"##### END #####\n");
+		
+		/* metrics pages cut because the page buffer could not grow */
+		metrics_trunc = metrics_truncated();
+		if (metrics_trunc != prev_metrics_trunc) {
+			LOG(LOG_WARNING,"[metrics] %u metrics page(s) truncated since the last report (max size %i bytes)\n", metrics_trunc - prev_metrics_trunc, METRICS_BUFF_MAX);
+			prev_metrics_trunc = metrics_trunc;
+		}
 	}
 	
 	/* wait for upstream thread to finish (1 fetch cycle max) */
 	pthread_join(thrid_up, NULL);
 	pthread_cancel(thrid_down); /* don't wait for downstream thread */
+	metrics_stop();
+	spool_close();
 	
 	/* if an exit signal was received, try to quit properly */
 	if (exit_sig) {
 		/* shut down network sockets */
-		shutdown(sock_up, SHUT_RDWR);
+		for (i = 0; i < nb_dest; ++i) {
+			shutdown(dest[i].sock, SHUT_RDWR);
+		}
 		shutdown(sock_down, SHUT_RDWR);
 		/* stop the hardware */
 		i = lgw_stop();
@@ -832,8 +2900,9 @@ int main(void)
 			LOG(LOG_WARNING,"failed to stop concentrator successfully\n");
 		}
 	}
-    closelog();
 	LOG(LOG_NOTICE,"Exiting packet forwarder program\n");
+	logging_stop();
+    closelog();
 	exit(EXIT_SUCCESS);
 }
 
@@ -841,345 +2910,343 @@ int main(void)
 /* --- THREAD 1: RECEIVING PACKETS AND FORWARDING THEM ---------------------- */
 
 void thread_up(void) {
-	int i, j; /* loop variables */
-	unsigned pkt_in_dgram; /* nb on Lora packet in the current datagram */
+	int i, j, k; /* loop variables */
+	unsigned pkt_in_dgram = 0; /* nb on Lora packet in the pending datagram */
 	
 	/* allocate memory for packet fetching and processing */
 	struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
 	struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
 	int nb_pkt;
 	
+	/* prioritization variables */
+	enum prio_e prio[NB_PKT_MAX]; /* priority class of each packet */
+	int order[NB_PKT_MAX]; /* packets by priority class, in reception order within a class */
+	bool keep[NB_PKT_MAX]; /* packet passed the status checks and the filters */
+	int nb_order;
+	enum prio_e c;
+	bool shed;
+	
 	/* local timestamp variables until we get accurate GPS time */
 	struct timespec fetch_time;
-	struct tm * x;
-	char fetch_timestamp[28]; /* timestamp as a text string */
+	struct timestamp_s fetch_ts; /* date and time of the last second formatted */
+	char fetch_timestamp[TIMESTAMP_SIZE + 1]; /* timestamp as a text string */
+	uint64_t fetch_time_us = 0; /* same, in microseconds since 1970 (binary encoding) */
+	
+	/* latency measurement variables */
+	struct timespec lock_start; /* before waiting for the concentrator */
+	struct timespec fetch_start; /* concentrator acquired, fetch starting */
+	struct timespec fetch_end; /* fetch returned */
+	uint64_t fetch_ms; /* same, in ms */
+	
+	/* coalescing variables */
+	struct timespec hold_start; /* fetch of the oldest packet of the pending datagram */
+	uint64_t hold_deadline_ms = 0; /* time when the pending datagram must be sent */
+	bool bin_dgram = false; /* the pending datagram is a PUSH_DATA_BIN */
+	struct rxpk_bin_s bin_ctx; /* binary encoder state of the pending datagram */
+	int start; /* offset of the first packet: after the header, and the JSON start */
+	int rec_size; /* size of a binary record */
+	unsigned size_max; /* size limit of the pending datagram: byte budget or path MTU */
+	uint64_t next_mtu_ms = 0; /* next read of the path MTU */
+	unsigned occupancy = 0; /* average packets per fetch (adaptive batch) */
+	unsigned mtu_size;
+	
+	/* polling variables */
+	struct timespec prev_fetch_end; /* end of the previous fetch */
+	uint32_t poll_us = POLL_MIN_US; /* next wait when idle */
+	uint32_t wait_us;
+	int poll_spin = 0; /* fetches left without waiting */
 	
 	/* data buffers */
-	uint8_t buff_up[5000]; /* buffer to compose the upstream packet */
-	int buff_index;
-	uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+	uint8_t * buff_up = push_buff[PUSH_POOL_MAX]; /* buffer to compose the upstream packet, exchanged with a free one when sent */
+	int buff_index = 0;
+	uint8_t * buff_replay = push_buff[PUSH_POOL_MAX + 2]; /* buffer for datagrams read from the spool, same */
+	int replay_size;
 	
-	/* protocol variables */
-	uint8_t token_h; /* random token for acknowledgement matching */
-	uint8_t token_l; /* random token for acknowledgement matching */
+	/* store-and-forward variables */
+	uint64_t now_ms;
+	uint64_t next_replay_ms = 0;
+	bool acks_read = false; /* acknowledges just processed while waiting after an empty fetch */
 	
-	/* set upstream socket RX timeout */
-	i = setsockopt(sock_up, SOL_SOCKET, SO_RCVTIMEO, (void *)&push_timeout_half, sizeof push_timeout_half);
-	if (i != 0) {
-		LOG(LOG_ERR,"[up] setsockopt returned %s\n", strerror(errno));
-		exit(EXIT_FAILURE);
+	/* filtering variables */
+	struct dedup_s dedup; /* recently received frames */
+	
+	dedup_init(&dedup, dedup_window_us);
+	timestamp_init(&fetch_ts);
+	
+	/* datagrams are composed in place in the buffers kept for retransmission */
+	for (i = 0; i < push_pool_size; ++i) {
+		push_body[i].dgram = push_buff[i];
+	}
+	if (push_alt == PKT_PUSH_DATA_LZ) {
+		json_lz_init(&push_lz, push_lz_level);
 	}
 	
-	/* pre-fill the data buffer with fixed fields */
-	buff_up[0] = PROTOCOL_VERSION;
-	buff_up[3] = PKT_PUSH_DATA;
-	*(uint32_t *)(buff_up + 4) = net_mac_h;
-	*(uint32_t *)(buff_up + 8) = net_mac_l;
+	if (dgram_size_cfg > 0) {
+		dgram_size_max = dgram_size_cfg;
+	}
+	if (poll_airtime) {
+		if (airtime_min_us > 0) {
+			poll_max_us = (airtime_min_us > POLL_MIN_US) ? airtime_min_us : POLL_MIN_US;
+			LOG(LOG_INFO,"[up] idle fetches will be %u us apart, the shortest packet airtime\n", poll_max_us);
+		} else {
+			LOG(LOG_WARNING,"[up] no enabled channel, idle fetches will be %u us apart\n", poll_max_us);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &prev_fetch_end);
 	
 	while (!exit_sig && !quit_sig) {
-	
+		
+		/* follow the path MTU (routes and tunnels change), unless the size limit is configured */
+		if (dgram_size_cfg == 0) {
+			now_ms = monotonic_ms();
+			if (now_ms >= next_mtu_ms) {
+				next_mtu_ms = now_ms + MTU_REFRESH_MS;
+				mtu_size = path_mtu_payload();
+				if (mtu_size == 0) {
+					mtu_size = DEFAULT_MTU - 28;
+				} else if (mtu_size > UP_BUFF_SIZE) {
+					mtu_size = UP_BUFF_SIZE;
+				}
+				if (mtu_size != dgram_size_max) {
+					LOG(LOG_INFO,"[up] upstream datagrams limited to %u bytes by the path MTU\n", mtu_size);
+					dgram_size_max = mtu_size;
+				}
+			}
+		}
+		
+		/* process acknowledges, retransmit late datagrams, negotiate the binary encoding */
+		if (!acks_read) {
+			push_receive_acks(0);
+		}
+		acks_read = false;
+		push_retransmit();
+		push_probe();
+		
+		/* replay spooled datagrams, one at a time, once the server answers again (PUSH_ACK, or PULL_ACK since the last failure), at a limited rate */
+		if ((spool_count() > 0) && !replay_in_flight && (link_up || (last_pull_ack > link_down_time))) {
+			now_ms = monotonic_ms();
+			if (next_replay_ms + 1000 < now_ms) {
+				next_replay_ms = now_ms; /* no burst to catch up after an idle period */
+			}
+			if (next_replay_ms <= now_ms) {
+				next_replay_ms += 1000 / replay_rate;
+				replay_size = spool_peek(buff_replay, UP_BUFF_SIZE);
+				if ((replay_size < 12) || ((buff_replay[3] != PKT_PUSH_DATA) && (buff_replay[3] != PKT_PUSH_DATA_BIN) && (buff_replay[3] != PKT_PUSH_DATA_LZ))) {
+					spool_pop(); /* not a PUSH_DATA datagram, discard it */
+				} else {
+					push_send(&buff_replay, replay_size, true);
+					replay_in_flight = true;
+				}
+			}
+		}
+		push_flush(); /* retransmissions and replay */
+		
 		/* fetch packets */
+		clock_gettime(CLOCK_MONOTONIC, &lock_start);
 		pthread_mutex_lock(&mx_concent);
-		nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
+		clock_gettime(CLOCK_MONOTONIC, &fetch_start);
+		nb_pkt = lgw_receive(fetch_batch, rxpkt);
 		pthread_mutex_unlock(&mx_concent);
+		clock_gettime(CLOCK_MONOTONIC, &fetch_end);
+		fetch_ms = ((uint64_t)fetch_end.tv_sec * 1000) + (fetch_end.tv_nsec / 1000000);
+		hist_record(&lat_up.concent, elapsed_us(&lock_start, &fetch_start));
+		hist_record(&lat_up.receive, elapsed_us(&fetch_start, &fetch_end));
 		if (nb_pkt == LGW_HAL_ERROR) {
 			LOG(LOG_ERR,"[up] failed packet fetch, exiting\n");
 			exit(EXIT_FAILURE);
-		} else if (nb_pkt == 0) {
-			wait_ms(FETCH_SLEEP_MS); /* wait a short time if no packets */
-			continue;
+		}
+		counters_begin(&cnt_up);
+		counters_add(&cnt_up, CNT_UP_WAKEUP, 1);
+		if (nb_pkt > 0) {
+			counters_add(&cnt_up, CNT_UP_FETCH, 1);
+			counters_add(&cnt_up, CNT_UP_FETCH_FULL, ((unsigned)nb_pkt >= fetch_batch) ? 1 : 0);
+		}
+		counters_end(&cnt_up);
+		if (nb_pkt > 0) {
+			hist_record(&lat_up.poll, elapsed_us(&prev_fetch_end, &fetch_end)); /* the packets arrived after the previous fetch */
+		}
+		prev_fetch_end = fetch_end;
+		if (fetch_adaptive) {
+			fetch_batch = fetch_batch_adapt(fetch_batch, nb_pkt, &occupancy);
 		}
 		
 		/* local timestamp generation until we get accurate GPS time */
-		clock_gettime(CLOCK_REALTIME, &fetch_time);
-		x = gmtime(&(fetch_time.tv_sec)); /* split the UNIX timestamp to its calendar components */
-		snprintf(fetch_timestamp, sizeof fetch_timestamp, "%04i-%02i-%02iT%02i:%02i:%02i.%06liZ", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (fetch_time.tv_nsec)/1000); /* ISO 8601 format */
-		
-		/* start composing datagram with the header */
-		token_h = (uint8_t)rand(); /* random token */
-		token_l = (uint8_t)rand(); /* random token */
-		buff_up[1] = token_h;
-		buff_up[2] = token_l;
-		buff_index = 12; /* 12-byte header */
+		if (nb_pkt > 0) {
+			clock_gettime(CLOCK_REALTIME, &fetch_time);
+			timestamp_format(&fetch_ts, &fetch_time, fetch_timestamp); /* ISO 8601 format */
+			fetch_time_us = ((uint64_t)fetch_time.tv_sec * 1000000) + (fetch_time.tv_nsec / 1000);
+		}
 		
-		/* start of JSON structure */
-		memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
-		buff_index += 9;
+		/* classify the packets, the high priority ones are serialized (and sent) first */
+		for (i = 0; i < nb_pkt; ++i) {
+			prio[i] = uplink_priority(&rxpkt[i]);
+		}
+		nb_order = 0;
+		for (c = PRIO_HIGH; c < PRIO_NB; ++c) {
+			for (i = 0; i < nb_pkt; ++i) {
+				if (prio[i] == c) {
+					order[nb_order++] = i;
+				}
+			}
+		}
 		
-		/* serialize Lora packets metadata and payload */
-		pkt_in_dgram = 0;
-		for (i=0; i < nb_pkt; ++i) {
+		/* basic packet filtering, then ghosts, duplicates, foreign and unwanted traffic, the token buckets are locked once per fetch */
+		if ((nb_pkt > 0) && (nb_rate_rule > 0)) {
+			pthread_mutex_lock(&mx_rate_table);
+		}
+		for (k = 0; k < nb_pkt; ++k) {
+			i = order[k];
 			p = &rxpkt[i];
+			keep[i] = false;
 			
-			/* basic packet filtering */
-			pthread_mutex_lock(&mx_meas_up);
-			meas_nb_rx_rcv += 1;
+			counters_begin(&cnt_up);
+			counters_add(&cnt_up, CNT_RX_RCV, 1);
 			switch(p->status) {
 				case STAT_CRC_OK:
-					meas_nb_rx_ok += 1;
+					counters_add(&cnt_up, CNT_RX_OK, 1);
 					if (!fwd_valid_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
+						counters_end(&cnt_up);
 						continue; /* skip that packet */
 					}
 					break;
 				case STAT_CRC_BAD:
                         LOG(LOG_NOTICE,"Received packet with bad CRC\n");
-					meas_nb_rx_bad += 1;
+					counters_add(&cnt_up, CNT_RX_BAD, 1);
 					if (!fwd_error_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
+						counters_end(&cnt_up);
 						continue; /* skip that packet */
 					}
 					break;
 				case STAT_NO_CRC:
                     LOG(LOG_NOTICE,"Received packet with no CRC\n");
-					meas_nb_rx_nocrc += 1;
+					counters_add(&cnt_up, CNT_RX_NOCRC, 1);
 					if (!fwd_nocrc_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
+						counters_end(&cnt_up);
 						continue; /* skip that packet */
 					}
 					break;
 				default:
 					LOG(LOG_WARNING,"[up] received packet with unknown status %u (size %u, modulation %u, BW %u, DR %u, RSSI %.1f)\n", p->status, p->size, p->modulation, p->bandwidth, p->datarate, p->rssi);
-					pthread_mutex_unlock(&mx_meas_up);
+					counters_end(&cnt_up);
 					continue; /* skip that packet */
 					// exit(EXIT_FAILURE);
 			}
-			meas_up_pkt_fwd += 1;
-			meas_up_payload_byte += p->size;
-			pthread_mutex_unlock(&mx_meas_up);
-			
-			/* Start of packet, add inter-packet separator if necessary */
-			if (pkt_in_dgram == 0) {
-				buff_up[buff_index] = '{';
-				++buff_index;
-			} else {
-				buff_up[buff_index] = ',';
-				buff_up[buff_index+1] = '{';
-				buff_index += 2;
+			counters_end(&cnt_up);
+			keep[i] = uplink_filter(p, &dedup, fetch_ms);
+		}
+		if ((nb_pkt > 0) && (nb_rate_rule > 0)) {
+			pthread_mutex_unlock(&mx_rate_table);
+		}
+		
+		/* serialize Lora packets metadata and payload, after the ones held from the previous fetches */
+		for (k = 0; k < nb_pkt; ++k) {
+			i = order[k];
+			p = &rxpkt[i];
+			if (!keep[i]) {
+				continue;
 			}
 			
-			/* RAW timestamp */
-			j = snprintf((char *)(buff_up + buff_index),19 , "\"tmst\":%u", p->count_us);
-			if ((j>=0) && (j < 19)) {
-				buff_index += j;
-			} else {
-				LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+			/* shed the lower priority classes while the server acknowledges too few datagrams */
+			shed = ((prio[i] >= PRIO_LOW) && (shed_low_pending > 0) && (dest[0].pool_used >= shed_low_pending)) || ((prio[i] >= PRIO_MEDIUM) && (shed_medium_pending > 0) && (dest[0].pool_used >= shed_medium_pending));
+			counters_begin(&cnt_prio);
+			counters_add(&cnt_prio, (shed ? CNT_PRIO_SHED : CNT_PRIO_FWD) + prio[i], 1);
+			counters_end(&cnt_prio);
+			if (shed) {
+				continue;
 			}
+			counters_begin(&cnt_up);
+			counters_add(&cnt_up, CNT_UP_PKT_FWD, 1);
+			counters_add(&cnt_up, CNT_UP_PAYLOAD_BYTE, p->size);
+			counters_end(&cnt_up);
 			
-			/* Packet RX time (system time based) */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"time\":\"???????????????????????????\"", 37);
-			memcpy((void *)(buff_up + buff_index + 9), (void *)fetch_timestamp, 27);
-			buff_index += 37;
+			/* payload in HEX, the JSON is displayed when the datagram is sent */
+			dump_payload(p->payload, p->size, UPSTREAM);
 			
-			/* Packet concentrator channel, RF chain & RX frequency */
-			j = snprintf((char *)(buff_up + buff_index),39 , ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
-			if ((j>=0) && (j < 39)) {
-				buff_index += j;
-			} else {
-				LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+			/* make sure the buffer can hold the packet */
+			if ((pkt_in_dgram > 0) && (buff_index + 1 + RXPK_MAX_SIZE + 3 > UP_BUFF_SIZE)) {
+				send_push_data(&buff_up, buff_index, pkt_in_dgram, &hold_start);
+				pkt_in_dgram = 0;
 			}
 			
-			/* Packet status */
-			switch (p->status) {
-				case STAT_CRC_OK:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":1", 9);
-					buff_index += 9;
-					break;
-				case STAT_CRC_BAD:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":-1", 10);
-					buff_index += 10;
-					break;
-				case STAT_NO_CRC:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":0", 9);
-					buff_index += 9;
-					break;
-				default:
-					LOG(LOG_ERR,"[up] received packet with unknown status\n");
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":?", 9);
-					buff_index += 9;
-					exit(EXIT_FAILURE);
+			/* start a new datagram after the fixed header and JSON start (encoding chosen now), or add the inter-packet separator */
+			if (pkt_in_dgram == 0) {
+				start = start_push_data(buff_up, push_alt_agreed() ? push_alt : PKT_PUSH_DATA);
+				bin_dgram = (buff_up[3] == PKT_PUSH_DATA_BIN);
+				rxpk_bin_reset(&bin_ctx);
+				buff_index = start;
+				j = buff_index;
+				hold_start = fetch_end;
+				hold_deadline_ms = fetch_ms + coalesce_ms;
+			} else if (bin_dgram) {
+				j = buff_index; /* records are not separated */
+			} else {
+				buff_up[buff_index] = ',';
+				j = buff_index + 1;
 			}
-			
-			/* Packet modulation */
-			if (p->modulation == MOD_LORA) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"LORA\"", 14);
-				buff_index += 14;
-				
-				/* Lora datarate & bandwidth*/
-				switch (p->datarate) {
-					case DR_LORA_SF7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF7", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF8", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF9:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF9", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF10:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF10", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF11:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF11", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF12:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF12", 13);
-						buff_index += 13;
-						break;
-					default:
-						LOG(LOG_ERR,"[up] lora packet with unknown datarate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF?", 12);
-						buff_index += 12;
-						exit(EXIT_FAILURE);
-				}
-				switch (p->bandwidth) {
-					case BW_125KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW125\"", 6);
-						buff_index += 6;
-						break;
-					case BW_250KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW250\"", 6);
-						buff_index += 6;
-						break;
-					case BW_500KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW500\"", 6);
-						buff_index += 6;
-						break;
-					default:
-						LOG(LOG_ERR,"[up] lora packet with unknown bandwidth\n");
-						memcpy((void *)(buff_up + buff_index), (void *)"BW?\"", 4);
-						buff_index += 4;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Packet ECC coding rate */
-				switch (p->coderate) {
-					case CR_LORA_4_5:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/5\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_6:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/6\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/7\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/8\"", 13);
-						buff_index += 13;
-						break;
-					case 0: /* treat the CR0 case (mostly false sync) */
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"OFF\"", 13);
-						buff_index += 13;
-						break;
-					default:
-						LOG(LOG_ERR,"[up] lora packet with unknown coderate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"?\"", 11);
-						buff_index += 11;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Lora SNR */
-				j = snprintf((char *)(buff_up + buff_index), 14, ",\"lsnr\":%.1f", p->snr);
-				if ((j>=0) && (j < 14)) {
-					buff_index += j;
-				} else {
-					LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
+			if (bin_dgram) {
+				rec_size = rxpk_bin_serialize(&bin_ctx, p, fetch_time_us, buff_up + j);
+				if (rec_size < 0) {
+					LOG(LOG_ERR,"[up] packet with a field that cannot be binary encoded (modulation %u, BW %u, DR %u, CR %u)\n", p->modulation, p->bandwidth, p->datarate, p->coderate);
 					exit(EXIT_FAILURE);
 				}
-			} else if (p->modulation == MOD_FSK) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
-				buff_index += 13;
-				
-				// TODO: add datarate metadata
-			} else {
-                    LOG(LOG_ERR,"[up] received packet with unknown modulation\n");
-				exit(EXIT_FAILURE);
-			}
-			
-			/* Packet RSSI, payload size */
-			j = snprintf((char *)(buff_up + buff_index), 23, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
-			if ((j>=0) && (j < 23)) {
-				buff_index += j;
+				j += rec_size;
 			} else {
-				LOG(LOG_ERR,"[up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+				j += serialize_rxpk(p, fetch_timestamp, buff_up + j);
 			}
 			
-			/* Packet base64-encoded payload */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
-			buff_index += 9;
-			j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
-			if (j>=0) {
-				buff_index += j;
-			} else {
-				LOG(LOG_ERR,"[up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
-				exit(EXIT_FAILURE);
+			/* over the byte budget or the path MTU: send the packets already there, the new one starts the next datagram */
+			size_max = (coalesce_size < dgram_size_max) ? coalesce_size : dgram_size_max;
+			if ((pkt_in_dgram > 0) && (j + (bin_dgram ? 0 : 2) > (int)size_max)) {
+				counters_begin(&cnt_up);
+				counters_add(&cnt_up, CNT_UP_DGRAM_SPLIT, 1);
+				counters_end(&cnt_up);
+				/* the datagram keeps its buffer, encode the packet again as the first one of the next, in the encoding in use now (binary fields are also relative to the previous record) */
+				send_push_data(&buff_up, buff_index, pkt_in_dgram, &hold_start);
+				start = start_push_data(buff_up, push_alt_agreed() ? push_alt : PKT_PUSH_DATA);
+				bin_dgram = (buff_up[3] == PKT_PUSH_DATA_BIN);
+				if (bin_dgram) {
+					rxpk_bin_reset(&bin_ctx);
+					j = start + rxpk_bin_serialize(&bin_ctx, p, fetch_time_us, buff_up + start);
+				} else {
+					j = start + serialize_rxpk(p, fetch_timestamp, buff_up + start);
+				}
+				pkt_in_dgram = 0;
+				hold_start = fetch_end;
+				hold_deadline_ms = fetch_ms + coalesce_ms;
 			}
-			buff_up[buff_index] = '"';
-			++buff_index;
-			
-			/* End of packet serialization */
-			buff_up[buff_index] = '}';
-			++buff_index;
+			buff_index = j;
 			++pkt_in_dgram;
 		}
 		
-		/* restart fetch sequence without sending empty JSON if all packets have been filtered out */
-		if (pkt_in_dgram == 0) {
-			continue;
+		/* send the pending datagram once its oldest packet has been held long enough (at once without coalescing) */
+		now_ms = monotonic_ms();
+		if ((pkt_in_dgram > 0) && (now_ms >= hold_deadline_ms)) {
+			send_push_data(&buff_up, buff_index, pkt_in_dgram, &hold_start);
+			pkt_in_dgram = 0;
 		}
 		
-		/* end of packet array */
-		buff_up[buff_index] = ']';
-		++buff_index;
-		
-		/* end of JSON datagram payload */
-		buff_up[buff_index] = '}';
-		++buff_index;
-		buff_up[buff_index] = 0; /* add string terminator, for safety */
-		
-		//printf("\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG:
-		//display JSON payload */
-        dump_packet(p->payload, p->size,buff_up,12,UPSTREAM); //header size (before json) is 12
-		
-		/* send datagram to server */
-		send(sock_up, (void *)buff_up, buff_index, 0);
-		pthread_mutex_lock(&mx_meas_up);
-		meas_up_dgram_sent += 1;
-		meas_up_network_byte += buff_index;
-		
-		/* wait for acknowledge (in 2 times, to catch extra packets) */
-		for (i=0; i<2; ++i) {
-			j = recv(sock_up, (void *)buff_ack, sizeof buff_ack, 0);
-			if (j == -1) {
-				if (errno == EAGAIN) { /* timeout */
-					continue;
-				} else { /* server connection error */
-					break;
-				}
-			} else if ((j < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
-				//MSG("WARNING: [up] ignored invalid non-ACL packet\n");
-				continue;
-			} else if ((buff_ack[1] != token_h) || (buff_ack[2] != token_l)) {
-				//MSG("WARNING: [up] ignored out-of sync ACK packet\n");
-				continue;
+		/* adaptive polling: fetch again at once after packets (more may follow), then wait longer and longer while idle */
+		if (nb_pkt > 0) {
+			poll_spin = POLL_SPIN;
+			poll_us = POLL_MIN_US;
+		} else {
+			if (poll_spin > 0) {
+				--poll_spin;
+				wait_us = 0;
 			} else {
-				//MSG("INFO: [up] ACK received :)\n"); /* too verbose */
-				meas_up_ack_rcv += 1;
-				break;
+				wait_us = poll_us;
+				poll_us = (2 * poll_us < poll_max_us) ? 2 * poll_us : poll_max_us;
+			}
+			if ((pkt_in_dgram > 0) && (1000 * (hold_deadline_ms - now_ms) < wait_us)) {
+				wait_us = (uint32_t)(1000 * (hold_deadline_ms - now_ms)); /* not beyond the time the pending datagram is due */
 			}
+			poll_wait_us(wait_us, &acks_read);
 		}
-		pthread_mutex_unlock(&mx_meas_up);
+	}
+	
+	/* do not lose the packets held for coalescing */
+	if (pkt_in_dgram > 0) {
+		send_push_data(&buff_up, buff_index, pkt_in_dgram, &hold_start);
 	}
 	LOG(LOG_DEBUG,"\n End of upstream thread\n");
 }
@@ -1188,39 +3255,43 @@ void thread_up(void) {
 /* --- THREAD 2: POLLING SERVER AND EMITTING PACKETS ------------------------ */
 
 void thread_down(void) {
-	int i; /* loop variables */
+	int i, k; /* loop variables */
 	
 	/* configuration and metadata for an outbound packet */
 	struct lgw_pkt_tx_s txpkt;
-	bool sent_immediate = false; /* option to sent the packet immediately */
 	
 	/* local timekeeping variables */
 	time_t now; /* current time, with second accuracy */
 	time_t requ_time; /* time of the pull request, low-res OK */
 	
+	/* latency measurement variables */
+	struct timespec pull_time; /* PULL_DATA sent */
+	struct timespec recv_time; /* datagram received */
+	struct timespec lock_start; /* before waiting for the concentrator */
+	struct timespec send_start; /* concentrator acquired */
+	struct timespec send_end; /* lgw_send returned */
+	
 	/* data buffers */
-	uint8_t buff_down[1000]; /* buffer to receive downstream packets */
+	uint8_t buff_batch[DW_BATCH][1000]; /* buffers to receive downstream packets */
+	uint8_t * buff_down; /* datagram being processed */
 	uint8_t buff_req[12]; /* buffer to compose pull requests */
 	int msg_len;
 	
+	/* batched reception variables */
+	struct pollfd pfd = {sock_down, POLLIN, 0};
+	struct iovec iov[DW_BATCH];
+	struct msghdr msg[DW_BATCH];
+	int len[DW_BATCH];
+	int nb_msg;
+	unsigned syscalls;
+	
 	/* protocol variables */
 	uint8_t token_h; /* random token for acknowledgement matching */
 	uint8_t token_l; /* random token for acknowledgement matching */
 	bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
 	
-	/* JSON parsing variables */
-	JSON_Value *root_val = NULL;
-	JSON_Object *txpk_obj = NULL;
-	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
-	const char *str; /* pointer to sub-strings in the JSON data */
-	short x0, x1;
-	
-	/* set downstream socket RX timeout */
-	i = setsockopt(sock_down, SOL_SOCKET, SO_RCVTIMEO, (void *)&pull_timeout, sizeof pull_timeout);
-	if (i != 0) {
-		LOG(LOG_ERR,"[down] setsockopt returned %s\n", strerror(errno));
-		exit(EXIT_FAILURE);
-	}
+	/* JSON decoding variables */
+	int data_size; /* number of payload bytes decoded from base64 */
 	
 	/* pre-fill the pull request buffer with fixed fields */
 	buff_req[0] = PROTOCOL_VERSION;
@@ -1237,283 +3308,123 @@ void thread_down(void) {
 		
 		/* send PULL request and record time */
 		send(sock_down, (void *)buff_req, sizeof buff_req, 0);
-		pthread_mutex_lock(&mx_meas_dw);
-		meas_dw_pull_sent += 1;
-		pthread_mutex_unlock(&mx_meas_dw);
+		clock_gettime(CLOCK_MONOTONIC, &pull_time);
+		counters_begin(&cnt_dw);
+		counters_add(&cnt_dw, CNT_DW_PULL_SENT, 1);
+		counters_add(&cnt_dw, CNT_DW_SYSCALL, 1);
+		counters_add(&cnt_dw, CNT_DW_IO_DGRAM, 1);
+		counters_end(&cnt_dw);
 		req_ack = false;
 		
 		/* listen to packets and process them until a new PULL request must be sent */
 		for (time(&requ_time); (int)difftime(now, requ_time) < keepalive_time; time(&now)) {
 			
-			/* try to receive a datagram */
-			msg_len = recv(sock_down, (void *)buff_down, (sizeof buff_down)-1, 0);
-			
-			/* if no network message was received, got back to listening sock_down socket */
-			if (msg_len == -1) {
-				//LOG(LOG_WARNING,"[down] recv returned %s\n", strerror(errno)); /* too verbose */
-				continue;
-			}
-			
-			/* if the datagram does not respect protocol, just ignore it */
-			if ((msg_len < 4) || (buff_down[0] != PROTOCOL_VERSION) || ((buff_down[3] != PKT_PULL_RESP) && (buff_down[3] != PKT_PULL_ACK))) {
-				LOG(LOG_WARNING,"[down] ignoring invalid packet\n");
-				continue;
-			}
-			
-			/* if the datagram is an ACK, check token */
-			if (buff_down[3] == PKT_PULL_ACK) {
-				if ((buff_down[1] == token_h) && (buff_down[2] == token_l)) {
-					if (req_ack) {
-						LOG(LOG_DEBUG,"[down] duplicate ACK received :)\n");
-					} else { /* if that packet was not already acknowledged */
-						req_ack = true;
-						pthread_mutex_lock(&mx_meas_dw);
-						meas_dw_ack_rcv += 1;
-						pthread_mutex_unlock(&mx_meas_dw);
-						LOG(LOG_DEBUG,"[down] ACK received :)\n"); /* very verbose */
-					}
-				} else { /* out-of-sync token */
-					LOG(LOG_DEBUG,"[down] received out-of-sync ACK\n");
-				}
-				continue;
-			}
-			
-			/* the datagram is a PULL_RESP */
-			buff_down[msg_len] = 0; /* add string terminator, just to be safe */
-			LOG(LOG_DEBUG,"[down] PULL_RESP received :)\n"); /* very verbose */
-			// printf("\nJSON down: %s\n", (char *)(buff_down + 4));
-			// /* DEBUG: display JSON payload */
-
-			
-			/* initialize TX struct and try to parse JSON */
-			memset(&txpkt, 0, sizeof txpkt);
-			root_val = json_parse_string_with_comments((const char *)(buff_down + 4)); /* JSON offset */
-			if (root_val == NULL) {
-				MSG("WARNING: [down] invalid JSON, TX aborted\n");
-				continue;
-			}
-			
-			/* look for JSON sub-object 'txpk' */
-			txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
-			if (txpk_obj == NULL) {
-				MSG("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-			
-			/* Parse "immediate" tag, or target timestamp, or UTC time to be converted by GPS (mandatory) */
-			i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
-			if (i == 1) {
-				/* TX procedure: send immediately */
-				sent_immediate = true;
-				LOG(LOG_DEBUG,"[down] a packet will be sent in \"immediate\" mode\n");
-			} else {
-				sent_immediate = false;
-				val = json_object_get_value(txpk_obj,"tmst");
-				if (val != NULL) {
-					/* TX procedure: send on timestamp value */
-					txpkt.count_us = (uint32_t)json_value_get_number(val);
-					LOG(LOG_INFO,"[down] a packet will be sent on timestamp value %u\n", txpkt.count_us);
-				} else {
-					LOG(LOG_WARNING,"[down] only \"immediate\" and \"timestamp\" modes supported, TX aborted\n");
-					json_value_free(root_val);
-					continue;
-				}
-			}
-			
-			/* Parse "No CRC" flag (optional field) */
-			val = json_object_get_value(txpk_obj,"ncrc");
-			if (val != NULL) {
-				txpkt.no_crc = (bool)json_value_get_boolean(val);
-			}
-			
-			/* parse target frequency (mandatory) */
-			val = json_object_get_value(txpk_obj,"freq");
-			if (val == NULL) {
-				LOG(LOG_WARNING,"[down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-			txpkt.freq_hz = (uint32_t)(1e6 * json_value_get_number(val));
-			
-			/* parse RF chain used for TX (mandatory) */
-			val = json_object_get_value(txpk_obj,"rfch");
-			if (val == NULL) {
-				LOG(LOG_WARNING,"[down] no mandatory \"txpk.rfch\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
+			/* wait for datagrams, then read all the waiting ones at once */
+			if (poll(&pfd, 1, PULL_TIMEOUT_MS) <= 0) {
 				continue;
 			}
-			txpkt.rf_chain = (uint8_t)json_value_get_number(val);
-			
-			/* parse TX power (optional field) */
-			val = json_object_get_value(txpk_obj,"powe");
-			if (val != NULL) {
-				txpkt.rf_power = (int8_t)json_value_get_number(val);
+			memset(msg, 0, sizeof msg);
+			for (k = 0; k < DW_BATCH; ++k) {
+				iov[k].iov_base = (void *)buff_batch[k];
+				iov[k].iov_len = sizeof buff_batch[k] - 1; /* room for a string terminator */
+				msg[k].msg_iov = &iov[k];
+				msg[k].msg_iovlen = 1;
 			}
+			syscalls = 0;
+			nb_msg = udp_recv_batch(sock_down, msg, len, DW_BATCH, &syscalls);
+			clock_gettime(CLOCK_MONOTONIC, &recv_time);
+			counters_begin(&cnt_dw);
+			counters_add(&cnt_dw, CNT_DW_SYSCALL, syscalls);
+			counters_add(&cnt_dw, CNT_DW_IO_DGRAM, nb_msg);
+			counters_end(&cnt_dw);
 			
-			/* Parse modulation (mandatory) */
-			str = json_object_get_string(txpk_obj, "modu");
-			if (str == NULL) {
-				LOG(LOG_WARNING,"[down] no mandatory \"txpk.modu\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-			if (strcmp(str, "LORA") == 0) {
-				/* Lora modulation */
-				txpkt.modulation = MOD_LORA;
+			/* process the datagrams received, in order */
+			for (k = 0; k < nb_msg; ++k) {
+				buff_down = buff_batch[k];
+				msg_len = len[k];
 				
-				/* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
-				str = json_object_get_string(txpk_obj, "datr");
-				if (str == NULL) {
-					LOG(LOG_WARNING,"[down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
+				/* if the datagram does not respect protocol, just ignore it */
+				if ((msg_len < 4) || (buff_down[0] != PROTOCOL_VERSION) || ((buff_down[3] != PKT_PULL_RESP) && (buff_down[3] != PKT_PULL_ACK))) {
+					LOG(LOG_WARNING,"[down] ignoring invalid packet\n");
 					continue;
 				}
-				i = sscanf(str, "SF%2hdBW%3hd", &x0, &x1);
-				if (i != 2) {
-					LOG(LOG_WARNING,"[down] format error in \"txpk.datr\", TX aborted\n");
-					json_value_free(root_val);
+				
+				/* if the datagram is an ACK, check token */
+				if (buff_down[3] == PKT_PULL_ACK) {
+					if ((buff_down[1] == token_h) && (buff_down[2] == token_l)) {
+						if (req_ack) {
+							LOG(LOG_DEBUG,"[down] duplicate ACK received :)\n");
+						} else { /* if that packet was not already acknowledged */
+							req_ack = true;
+							last_pull_ack = time(NULL);
+							counters_begin(&cnt_dw);
+							counters_add(&cnt_dw, CNT_DW_ACK_RCV, 1);
+							counters_end(&cnt_dw);
+							hist_record(&lat_dw.pull_ack, elapsed_us(&pull_time, &recv_time));
+							LOG(LOG_DEBUG,"[down] ACK received :)\n"); /* very verbose */
+						}
+					} else { /* out-of-sync token */
+						LOG(LOG_DEBUG,"[down] received out-of-sync ACK\n");
+					}
 					continue;
 				}
-				switch (x0) {
-					case  7: txpkt.datarate = DR_LORA_SF7;  break;
-					case  8: txpkt.datarate = DR_LORA_SF8;  break;
-					case  9: txpkt.datarate = DR_LORA_SF9;  break;
-					case 10: txpkt.datarate = DR_LORA_SF10; break;
-					case 11: txpkt.datarate = DR_LORA_SF11; break;
-					case 12: txpkt.datarate = DR_LORA_SF12; break;
-					default:
-						LOG(LOG_WARNING,"[down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
-						json_value_free(root_val);
-						continue;
-				}
-				switch (x1) {
-					case 125: txpkt.bandwidth = BW_125KHZ; break;
-					case 250: txpkt.bandwidth = BW_250KHZ; break;
-					case 500: txpkt.bandwidth = BW_500KHZ; break;
-					default:
-						LOG(LOG_WARNING,"[down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
-						json_value_free(root_val);
-						continue;
-				}
 				
-				/* Parse ECC coding rate (optional field) */
-				str = json_object_get_string(txpk_obj, "codr");
-				if (str == NULL) {
-					LOG(LOG_WARNING,"[down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
-					json_value_free(root_val);
+				/* the datagram is a PULL_RESP */
+				buff_down[msg_len] = 0; /* add string terminator, just to be safe */
+				LOG(LOG_DEBUG,"[down] PULL_RESP received :)\n"); /* very verbose */
+				// printf("\nJSON down: %s\n", (char *)(buff_down + 4));
+				// /* DEBUG: display JSON payload */
+
+				
+				/* decode the JSON "txpk" object into a TX struct */
+				i = txpk_parse((const char *)(buff_down + 4), &txpkt, &data_size); /* JSON offset */
+				if (i != TXPK_OK) {
+					LOG(LOG_WARNING,"[down] %s, TX aborted\n", txpk_strerror(i));
 					continue;
 				}
-				if      (strcmp(str, "4/5") == 0) txpkt.coderate = CR_LORA_4_5;
-				else if (strcmp(str, "4/6") == 0) txpkt.coderate = CR_LORA_4_6;
-				else if (strcmp(str, "2/3") == 0) txpkt.coderate = CR_LORA_4_6;
-				else if (strcmp(str, "4/7") == 0) txpkt.coderate = CR_LORA_4_7;
-				else if (strcmp(str, "4/8") == 0) txpkt.coderate = CR_LORA_4_8;
-				else if (strcmp(str, "1/2") == 0) txpkt.coderate = CR_LORA_4_8;
-				else {
-					LOG(LOG_WARNING,"[down] format error in \"txpk.codr\", TX aborted\n");
-					json_value_free(root_val);
-					continue;
+				if (txpkt.tx_mode == IMMEDIATE) {
+					LOG(LOG_DEBUG,"[down] a packet will be sent in \"immediate\" mode\n");
+				} else {
+					LOG(LOG_INFO,"[down] a packet will be sent on timestamp value %u\n", txpkt.count_us);
 				}
-				
-				/* Parse signal polarity switch (optional field) */
-				val = json_object_get_value(txpk_obj,"ipol");
-				if (val != NULL) {
-					txpkt.invert_pol = (bool)json_value_get_boolean(val);
+				if (data_size != txpkt.size) {
+					LOG(LOG_WARNING,"[down] mismatch between .size and .data size once converter to binary\n");
 				}
+	            //pass the same fields as when doing for upstream
+	            //just here we are reading them from the json we recieved
+	            //from nodeG, and in a structure appropriate for sending
+	            //and there we were putting them in a json to send to
+	            //NodeG
+	            //header size before json is 4
+	            dump_packet(txpkt.payload,txpkt.size,buff_down,4,DOWNSTREAM); 
 				
-				/* parse Lora preamble length (optional field, optimum min value enforced) */
-				val = json_object_get_value(txpk_obj,"prea");
-				if (val != NULL) {
-					i = (int)json_value_get_number(val);
-					if (i >= MIN_LORA_PREAMB) {
-						txpkt.preamble = (uint16_t)i;
-					} else {
-						txpkt.preamble = (uint16_t)MIN_LORA_PREAMB;
-					}
+				/* record measurement data */
+				counters_begin(&cnt_dw);
+				counters_add(&cnt_dw, CNT_DW_DGRAM_RCV, 1); /* count only datagrams with no JSON errors */
+				counters_add(&cnt_dw, CNT_DW_NETWORK_BYTE, msg_len);
+				counters_add(&cnt_dw, CNT_DW_PAYLOAD_BYTE, txpkt.size);
+				counters_end(&cnt_dw);
+				
+				/* transfer data and metadata to the concentrator, and schedule TX */
+				clock_gettime(CLOCK_MONOTONIC, &lock_start);
+				pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
+				clock_gettime(CLOCK_MONOTONIC, &send_start);
+				i = lgw_send(txpkt);
+				pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
+				clock_gettime(CLOCK_MONOTONIC, &send_end);
+				hist_record(&lat_dw.concent, elapsed_us(&lock_start, &send_start));
+				hist_record(&lat_dw.pull_resp, elapsed_us(&recv_time, &send_end));
+				if (i == LGW_HAL_ERROR) {
+					counters_begin(&cnt_dw);
+					counters_add(&cnt_dw, CNT_TX_FAIL, 1);
+					counters_end(&cnt_dw);
+					LOG(LOG_WARNING,"[down] lgw_send failed\n");
+					continue;
 				} else {
-					txpkt.preamble = (uint16_t)MIN_LORA_PREAMB;
+					counters_begin(&cnt_dw);
+					counters_add(&cnt_dw, CNT_TX_OK, 1);
+					counters_end(&cnt_dw);
 				}
-				
-			} else if (strcmp(str, "FSK") == 0) {
-				/* FSK modulation */
-				txpkt.modulation = MOD_FSK;
-				
-				// TODO
-				MSG("WARNING: [down] FSK modulation not supported yet, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-				
-				/* parse TX preamble length (optional field) */
-				//val = json_object_get_value(txpk_obj,"prea");
-				//if (val != NULL) {
-				//	txpkt.preamble = (uint16_t)json_value_get_number(val);
-				//}
-				
-			} else {
-				LOG(LOG_WARNING,"[down] invalid modulation in \"txpk.modu\", TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-			
-			/* Parse payload length (mandatory) */
-			val = json_object_get_value(txpk_obj,"size");
-			if (val == NULL) {
-				LOG(LOG_WARNING,"[down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-			txpkt.size = (uint16_t)json_value_get_number(val);
-			
-			/* Parse payload data (mandatory) */
-			str = json_object_get_string(txpk_obj, "data");
-			if (str == NULL) {
-				LOG(LOG_WARNING,"[down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
-				json_value_free(root_val);
-				continue;
-			}
-
-
-			i = b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
-			if (i != txpkt.size) {
-				LOG(LOG_WARNING,"[down] mismatch between .size and .data size once converter to binary\n");
-			}
-            //pass the same fields as when doing for upstream
-            //just here we are reading them from the json we recieved
-            //from nodeG, and in a structure appropriate for sending
-            //and there we were putting them in a json to send to
-            //NodeG
-            //header size before json is 4
-            dump_packet(txpkt.payload,txpkt.size,buff_down,4,DOWNSTREAM); 
-			
-			/* free the JSON parse tree from memory */
-			json_value_free(root_val);
-			
-			/* select TX mode */
-			if (sent_immediate) {
-				txpkt.tx_mode = IMMEDIATE;
-			} else {
-				txpkt.tx_mode = TIMESTAMPED;
-			}
-			
-			/* record measurement data */
-			pthread_mutex_lock(&mx_meas_dw);
-			meas_dw_dgram_rcv += 1; /* count only datagrams with no JSON errors */
-			meas_dw_network_byte += msg_len; /* meas_dw_network_byte */
-			meas_dw_payload_byte += txpkt.size;
-			
-			/* transfer data and metadata to the concentrator, and schedule TX */
-			pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-			i = lgw_send(txpkt);
-			pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
-			if (i == LGW_HAL_ERROR) {
-				meas_nb_tx_fail += 1;
-				pthread_mutex_unlock(&mx_meas_dw);
-				LOG(LOG_WARNING,"[down] lgw_send failed\n");
-				continue;
-			} else {
-				meas_nb_tx_ok += 1;
-				pthread_mutex_unlock(&mx_meas_dw);
 			}
 		}
 	}
@@ -0,0 +1,290 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Micro-benchmark of the downlink decoding path, from a raw PULL_RESP
+	datagram to a filled lgw_pkt_tx_s structure
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* printf, fprintf, fopen, fgets */
+#include <string.h>		/* memset, memcpy, strlen */
+#include <stdlib.h>		/* atoi, exit */
+#include <time.h>		/* clock_gettime */
+#include <unistd.h>		/* getopt */
+
+#include "parson.h"
+#include "base64.h"
+#include "loragw_hal.h"
+#include "txpk_parse.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define	PROTOCOL_VERSION	1
+#define PKT_PULL_RESP		3
+
+#define DGRAM_MAX		1000 /* same as the thread_down receive buffer */
+#define CORPUS_MAX		256 /* max number of datagrams per corpus file */
+#define DEFAULT_ITER	2000 /* default number of passes over each corpus */
+
+#define DEFAULT_VALID		"bench/pull_resp_valid.txt"
+#define DEFAULT_MALFORMED	"bench/pull_resp_malformed.txt"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct corpus_s {
+	int nb; /* number of datagrams loaded */
+	int len[CORPUS_MAX]; /* size of each datagram, header included */
+	uint8_t dgram[CORPUS_MAX][DGRAM_MAX]; /* raw PULL_RESP datagrams */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+static struct corpus_s corpus;
+static volatile int sink; /* keep the compiler from optimizing the work away */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+	MSG("Usage: bench_down [-n iterations] [corpus_file ...]\n");
+	MSG("  each non-empty corpus line not starting with '#' is the JSON of one PULL_RESP\n");
+	MSG("  default corpus: %s %s\n", DEFAULT_VALID, DEFAULT_MALFORMED);
+}
+
+static double elapsed_ns(const struct timespec * start, const struct timespec * stop) {
+	return 1e9 * (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec);
+}
+
+/* load a corpus file, wrapping each JSON line in a PULL_RESP header */
+static int load_corpus(const char * path, struct corpus_s * c) {
+	FILE * fp;
+	char line[DGRAM_MAX];
+	int len;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		MSG("ERROR: impossible to open corpus file %s\n", path);
+		return -1;
+	}
+	c->nb = 0;
+	while ((fgets(line, sizeof line, fp) != NULL) && (c->nb < CORPUS_MAX)) {
+		len = strlen(line);
+		while ((len > 0) && ((line[len-1] == '\n') || (line[len-1] == '\r'))) {
+			line[--len] = 0;
+		}
+		if ((len == 0) || (line[0] == '#')) {
+			continue;
+		}
+		if (len + 4 >= DGRAM_MAX) {
+			MSG("WARNING: corpus line too long in %s, skipped\n", path);
+			continue;
+		}
+		c->dgram[c->nb][0] = PROTOCOL_VERSION;
+		c->dgram[c->nb][1] = (uint8_t)rand();
+		c->dgram[c->nb][2] = (uint8_t)rand();
+		c->dgram[c->nb][3] = PKT_PULL_RESP;
+		memcpy(c->dgram[c->nb] + 4, line, len);
+		c->len[c->nb] = len + 4;
+		++c->nb;
+	}
+	fclose(fp);
+	return c->nb;
+}
+
+/* same steps as thread_down, from the raw datagram to the TX structure */
+static int decode_dgram(uint8_t * dgram, int len, struct lgw_pkt_tx_s * txpkt) {
+	int data_size;
+
+	if ((len < 4) || (dgram[0] != PROTOCOL_VERSION) || (dgram[3] != PKT_PULL_RESP)) {
+		return -1;
+	}
+	dgram[len] = 0; /* add string terminator, just to be safe */
+	return txpk_parse((const char *)(dgram + 4), txpkt, &data_size);
+}
+
+static void bench_corpus(const char * path, int iter) {
+	int i, n;
+	int status;
+	int nb_ok = 0;
+	long bytes = 0;
+	struct timespec t0, t1;
+	struct lgw_pkt_tx_s txpkt;
+	JSON_Value *root_val;
+	JSON_Object *txpk_obj;
+	const char *str;
+	uint8_t coderate;
+	int data_size;
+	double t_total, t_json, t_fields;
+	double t_datr = 0.0, t_codr = 0.0, t_b64 = 0.0;
+	int nb_datr = 0, nb_codr = 0, nb_b64 = 0;
+	int reject[TXPK_STATUS_NB];
+
+	if (load_corpus(path, &corpus) <= 0) {
+		return;
+	}
+	memset(reject, 0, sizeof reject);
+
+	/* decoding outcome, done once */
+	for (i = 0; i < corpus.nb; ++i) {
+		status = decode_dgram(corpus.dgram[i], corpus.len[i], &txpkt);
+		if (status == TXPK_OK) {
+			++nb_ok;
+		} else if (status > 0) {
+			++reject[status];
+		}
+		bytes += corpus.len[i];
+	}
+
+	/* end-to-end: raw datagram to TX structure */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (n = 0; n < iter; ++n) {
+		for (i = 0; i < corpus.nb; ++i) {
+			sink += decode_dgram(corpus.dgram[i], corpus.len[i], &txpkt);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	t_total = elapsed_ns(&t0, &t1);
+
+	/* stage 1: JSON parsing and tree release */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (n = 0; n < iter; ++n) {
+		for (i = 0; i < corpus.nb; ++i) {
+			root_val = json_parse_string_with_comments((const char *)(corpus.dgram[i] + 4));
+			if (root_val != NULL) {
+				json_value_free(root_val);
+				sink += 1;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	t_json = elapsed_ns(&t0, &t1);
+
+	/* stage 2: field extraction on the parsed tree (includes stages 3 to 5) */
+	t_fields = 0.0;
+	for (i = 0; i < corpus.nb; ++i) {
+		root_val = json_parse_string_with_comments((const char *)(corpus.dgram[i] + 4));
+		if (root_val == NULL) {
+			continue;
+		}
+		txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
+		if (txpk_obj != NULL) {
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for (n = 0; n < iter; ++n) {
+				sink += txpk_parse_obj(txpk_obj, &txpkt, &data_size);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			t_fields += elapsed_ns(&t0, &t1);
+
+			/* stages 3 to 5 on the strings found in that datagram */
+			str = json_object_get_string(txpk_obj, "datr");
+			if (str != NULL) {
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				for (n = 0; n < iter; ++n) {
+					sink += txpk_parse_datr(str, &txpkt);
+				}
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				t_datr += elapsed_ns(&t0, &t1);
+				++nb_datr;
+			}
+			str = json_object_get_string(txpk_obj, "codr");
+			if (str != NULL) {
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				for (n = 0; n < iter; ++n) {
+					sink += txpk_parse_codr(str, &coderate);
+				}
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				t_codr += elapsed_ns(&t0, &t1);
+				++nb_codr;
+			}
+			str = json_object_get_string(txpk_obj, "data");
+			if (str != NULL) {
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				for (n = 0; n < iter; ++n) {
+					sink += b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
+				}
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				t_b64 += elapsed_ns(&t0, &t1);
+				++nb_b64;
+			}
+		}
+		json_value_free(root_val);
+	}
+
+	/* display a report */
+	printf("##### %s #####\n", path);
+	printf("# datagrams: %i (%li bytes), accepted: %i, rejected: %i, passes: %i\n", corpus.nb, bytes, nb_ok, corpus.nb - nb_ok, iter);
+	for (i = 1; i < TXPK_STATUS_NB; ++i) {
+		if (reject[i] > 0) {
+			printf("#   rejected %3i: %s\n", reject[i], txpk_strerror(i));
+		}
+	}
+	printf("# throughput: %.0f datagrams/s, %.2f MB/s\n", 1e9 * (double)corpus.nb * iter / t_total, 1e3 * (double)bytes * iter / t_total);
+	printf("# end-to-end:       %8.0f ns/datagram\n", t_total / ((double)corpus.nb * iter));
+	printf("# json_parse:       %8.0f ns/datagram\n", t_json / ((double)corpus.nb * iter));
+	printf("# field extraction: %8.0f ns/datagram (incl. datr, codr, base64)\n", t_fields / ((double)corpus.nb * iter));
+	if (nb_datr > 0) printf("# datr sscanf:      %8.0f ns/call\n", t_datr / ((double)nb_datr * iter));
+	if (nb_codr > 0) printf("# codr strcmp:      %8.0f ns/call\n", t_codr / ((double)nb_codr * iter));
+	if (nb_b64 > 0)  printf("# b64_to_bin:       %8.0f ns/call\n", t_b64 / ((double)nb_b64 * iter));
+	printf("##### END #####\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+	int i;
+	int iter = DEFAULT_ITER;
+
+	while ((i = getopt(argc, argv, "hn:")) != -1) {
+		switch (i) {
+			case 'n':
+				iter = atoi(optarg);
+				if (iter < 1) {
+					usage();
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				usage();
+				return (i == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		bench_corpus(DEFAULT_VALID, iter);
+		bench_corpus(DEFAULT_MALFORMED, iter);
+	} else {
+		for (i = optind; i < argc; ++i) {
+			bench_corpus(argv[i], iter);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
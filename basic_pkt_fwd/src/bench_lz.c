@@ -0,0 +1,208 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Benchmark of the PUSH_DATA compression: compression ratio versus CPU time
+	for each compression level, on a corpus of PUSH_DATA JSON bodies
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* printf, fprintf, fopen, fgets */
+#include <string.h>		/* memcmp, memcpy, strlen, strchr */
+#include <stdlib.h>		/* atoi, exit */
+#include <time.h>		/* clock_gettime */
+#include <unistd.h>		/* getopt */
+
+#include "json_lz.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define DGRAM_MAX		5000 /* same as the thread_up datagram buffer */
+#define CORPUS_MAX		1024 /* max number of datagrams per corpus file */
+#define DEFAULT_ITER	200 /* default number of passes over each corpus */
+#define HDR_SIZE		15 /* PUSH_DATA_LZ header: 12 bytes + dictionary + uncompressed size */
+
+#define DEFAULT_CORPUS	"bench/push_data_rxpk.txt"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct corpus_s {
+	int nb; /* number of datagrams loaded */
+	int len[CORPUS_MAX]; /* size of each JSON body */
+	uint8_t body[CORPUS_MAX][DGRAM_MAX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+static struct corpus_s corpus;
+static struct json_lz_s lz;
+static const unsigned levels[] = {1, 2, 4, 8, 16, 32};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+	MSG("Usage: bench_lz [-n iterations] [corpus_file ...]\n");
+	MSG("  each non-empty corpus line not starting with '#' is the JSON of one PUSH_DATA,\n");
+	MSG("  anything before the first '{' is ignored (forwarder logs can be used as they are)\n");
+	MSG("  default corpus: %s\n", DEFAULT_CORPUS);
+}
+
+static double elapsed_ns(const struct timespec * start, const struct timespec * stop) {
+	return 1e9 * (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec);
+}
+
+/* load a corpus file, one JSON body per line */
+static int load_corpus(const char * path, struct corpus_s * c) {
+	FILE * fp;
+	static char line[2 * DGRAM_MAX];
+	char * start;
+	int len;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		MSG("ERROR: impossible to open corpus file %s\n", path);
+		return -1;
+	}
+	c->nb = 0;
+	while ((fgets(line, sizeof line, fp) != NULL) && (c->nb < CORPUS_MAX)) {
+		len = strlen(line);
+		while ((len > 0) && ((line[len-1] == '\n') || (line[len-1] == '\r') || (line[len-1] == ' '))) {
+			line[--len] = 0;
+		}
+		start = strchr(line, '{');
+		if ((len == 0) || (line[0] == '#') || (start == NULL)) {
+			continue;
+		}
+		len -= start - line;
+		if (len > DGRAM_MAX) {
+			MSG("WARNING: corpus line too long in %s, skipped\n", path);
+			continue;
+		}
+		memcpy(c->body[c->nb], start, len);
+		c->len[c->nb] = len;
+		++c->nb;
+	}
+	fclose(fp);
+	return c->nb;
+}
+
+static void bench_corpus(const char * path, int iter) {
+	int i, n;
+	unsigned l;
+	int size;
+	long bytes = 0;
+	long lz_bytes;
+	int nb_err;
+	struct timespec t0, t1;
+	double t_comp, t_decomp;
+	static uint8_t comp[CORPUS_MAX][DGRAM_MAX];
+	static int comp_len[CORPUS_MAX];
+	static uint8_t out[DGRAM_MAX];
+
+	if (load_corpus(path, &corpus) <= 0) {
+		return;
+	}
+	for (i = 0; i < corpus.nb; ++i) {
+		bytes += corpus.len[i];
+	}
+
+	printf("##### %s #####\n", path);
+	printf("# datagrams: %i, JSON bodies: %li bytes (%.1f per datagram), passes: %i\n", corpus.nb, bytes, (double)bytes / corpus.nb, iter);
+	printf("# level | datagram bytes (header incl.) |  ratio | compress ns/dgram   MB/s | decompress ns/dgram\n");
+	printf("#  JSON | %8li                      |  1.000 |\n", bytes + 12L * corpus.nb);
+	for (l = 0; l < ARRAY_SIZE(levels); ++l) {
+		json_lz_init(&lz, levels[l]);
+
+		/* compression, the size of each datagram is kept for the decompression */
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < iter; ++n) {
+			for (i = 0; i < corpus.nb; ++i) {
+				comp_len[i] = json_lz_compress(&lz, corpus.body[i], corpus.len[i], comp[i], DGRAM_MAX);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_comp = elapsed_ns(&t0, &t1);
+
+		/* decompression, and check of the round trip */
+		nb_err = 0;
+		lz_bytes = 0;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < iter; ++n) {
+			for (i = 0; i < corpus.nb; ++i) {
+				size = json_lz_decompress(JSON_LZ_DICT_RXPK, comp[i], comp_len[i], out, sizeof out);
+				if ((n == 0) && ((size != corpus.len[i]) || (memcmp(out, corpus.body[i], size) != 0))) {
+					++nb_err;
+				}
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_decomp = elapsed_ns(&t0, &t1);
+		for (i = 0; i < corpus.nb; ++i) {
+			/* a datagram that does not shrink is sent uncompressed */
+			lz_bytes += (comp_len[i] + 3 <= corpus.len[i]) ? (HDR_SIZE + comp_len[i]) : (12 + corpus.len[i]);
+		}
+
+		printf("#  %4u | %8li                      | %6.3f | %12.0f %9.2f | %12.0f%s\n", levels[l], lz_bytes, (double)(bytes + 12L * corpus.nb) / lz_bytes, t_comp / ((double)corpus.nb * iter), 1e3 * (double)bytes * iter / t_comp, t_decomp / ((double)corpus.nb * iter), (nb_err > 0) ? "  ROUND TRIP ERRORS" : "");
+	}
+	printf("##### END #####\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+	int i;
+	int iter = DEFAULT_ITER;
+
+	while ((i = getopt(argc, argv, "hn:")) != -1) {
+		switch (i) {
+			case 'n':
+				iter = atoi(optarg);
+				if (iter < 1) {
+					usage();
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				usage();
+				return (i == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		bench_corpus(DEFAULT_CORPUS, iter);
+	} else {
+		for (i = optind; i < argc; ++i) {
+			bench_corpus(argv[i], iter);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
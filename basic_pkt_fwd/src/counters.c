@@ -0,0 +1,47 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Per-thread 64-bit monotonic counters with lock-free snapshots
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <sched.h>		/* sched_yield */
+
+#include "counters.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void counters_snapshot(const struct counters_s * c, uint64_t * out, int nb) {
+	int i;
+	uint32_t seq;
+
+	if (nb > COUNTERS_MAX) {
+		nb = COUNTERS_MAX;
+	}
+	while (1) {
+		seq = c->seq;
+		if (seq & 1) {
+			sched_yield(); /* owner is updating the block, let it finish */
+			continue;
+		}
+		__sync_synchronize();
+		for (i = 0; i < nb; ++i) {
+			out[i] = c->value[i];
+		}
+		__sync_synchronize();
+		if (seq == c->seq) {
+			return;
+		}
+	}
+}
+
+/* --- EOF ------------------------------------------------------------------ */
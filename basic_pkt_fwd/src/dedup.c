@@ -0,0 +1,61 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Short time-window detection of duplicate uplinks
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>		/* memset */
+
+#include "dedup.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void dedup_init(struct dedup_s * d, uint32_t window_us) {
+	memset(d, 0, sizeof *d);
+	d->window_us = window_us;
+}
+
+bool dedup_check(struct dedup_s * d, uint16_t crc, uint16_t size, uint32_t count_us) {
+	unsigned h = ((unsigned)crc ^ ((unsigned)size * 0x9E37u)) & (DEDUP_SLOTS - 1);
+	unsigned i, idx;
+	unsigned victim = h; /* slot receiving the frame: the first empty one, or the oldest */
+	bool empty_found = false;
+	uint32_t age, victim_age = 0;
+	struct dedup_entry_s * e;
+
+	for (i = 0; i < DEDUP_WAYS; ++i) {
+		idx = (h + i) & (DEDUP_SLOTS - 1);
+		e = &d->slot[idx];
+		if (e->size == 0) {
+			if (!empty_found) {
+				victim = idx;
+				empty_found = true;
+			}
+			continue;
+		}
+		/* copies can be reported in any order, and count_us wraps around every 71 minutes */
+		age = count_us - e->count_us;
+		if ((e->crc == crc) && (e->size == size) && ((age <= d->window_us) || ((uint32_t)(0 - age) <= d->window_us))) {
+			return true;
+		}
+		if (!empty_found && (age >= victim_age)) {
+			victim = idx;
+			victim_age = age;
+		}
+	}
+	d->slot[victim].count_us = count_us;
+	d->slot[victim].crc = crc;
+	d->slot[victim].size = size;
+	return false;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
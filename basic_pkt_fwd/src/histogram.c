@@ -0,0 +1,154 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Log-linear histograms for latency measurements
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+#include "histogram.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+@brief Get the index of the bucket counting a value
+
+Values below 2*HIST_SUB_NB have their own bucket, above that each power of 2
+is split in HIST_SUB_NB buckets of equal width.
+*/
+static int bucket_index(uint32_t value);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int bucket_index(uint32_t value) {
+	int shift;
+
+	if (value < (2 * HIST_SUB_NB)) {
+		return (int)value;
+	}
+	shift = (31 - __builtin_clz(value)) - HIST_SUB_BITS;
+	return (shift * HIST_SUB_NB) + (int)(value >> shift);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void hist_record(struct hist_s * h, uint32_t value) {
+	h->count[bucket_index(value)] += 1;
+	/* 64-bit sum, not atomic on 32-bit targets: readers retry while sum_seq is odd or changes */
+	h->sum_seq += 1;
+	__sync_synchronize();
+	h->sum += value;
+	__sync_synchronize();
+	h->sum_seq += 1;
+}
+
+void hist_snapshot(const struct hist_s * h, struct hist_s * snap) {
+	int i;
+	uint32_t seq;
+
+	for (i = 0; i < HIST_BUCKET_NB; ++i) {
+		snap->count[i] = h->count[i];
+	}
+	do {
+		seq = h->sum_seq;
+		__sync_synchronize();
+		snap->sum = h->sum;
+		__sync_synchronize();
+	} while ((seq & 1) || (seq != h->sum_seq));
+	snap->sum_seq = 0;
+}
+
+void hist_delta(const struct hist_s * cur, const struct hist_s * prev, struct hist_s * out) {
+	int i;
+
+	for (i = 0; i < HIST_BUCKET_NB; ++i) {
+		out->count[i] = cur->count[i] - prev->count[i]; /* modulo 2^32, survives wrap-around */
+	}
+	out->sum = cur->sum - prev->sum;
+	out->sum_seq = 0;
+}
+
+void hist_merge(struct hist_s * acc, const struct hist_s * h) {
+	int i;
+
+	for (i = 0; i < HIST_BUCKET_NB; ++i) {
+		acc->count[i] += h->count[i];
+	}
+	acc->sum += h->sum;
+}
+
+uint32_t hist_total(const struct hist_s * h) {
+	int i;
+	uint32_t total = 0;
+
+	for (i = 0; i < HIST_BUCKET_NB; ++i) {
+		total += h->count[i];
+	}
+	return total;
+}
+
+uint64_t hist_sum(const struct hist_s * h) {
+	return h->sum;
+}
+
+uint32_t hist_percentile(const struct hist_s * h, double pct) {
+	int i;
+	uint32_t total;
+	uint32_t target;
+	uint32_t cumul = 0;
+
+	total = hist_total(h);
+	if (total == 0) {
+		return 0;
+	}
+	if (pct >= 100.0) {
+		target = total;
+	} else if (pct <= 0.0) {
+		target = 1;
+	} else {
+		target = (uint32_t)(((double)total * pct / 100.0) + 0.999999);
+		if (target == 0) {
+			target = 1;
+		}
+	}
+	for (i = 0; i < HIST_BUCKET_NB; ++i) {
+		cumul += h->count[i];
+		if (cumul >= target) {
+			return hist_bucket_high(i);
+		}
+	}
+	return hist_bucket_high(HIST_BUCKET_NB - 1);
+}
+
+uint32_t hist_bucket_low(int bucket) {
+	int shift;
+
+	if (bucket < (2 * HIST_SUB_NB)) {
+		return (uint32_t)bucket;
+	}
+	shift = (bucket / HIST_SUB_NB) - 1;
+	return (uint32_t)(bucket - (shift * HIST_SUB_NB)) << shift;
+}
+
+uint32_t hist_bucket_high(int bucket) {
+	int shift;
+
+	if (bucket < (2 * HIST_SUB_NB)) {
+		return (uint32_t)bucket;
+	}
+	shift = (bucket / HIST_SUB_NB) - 1;
+	return hist_bucket_low(bucket) + ((1u << shift) - 1);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
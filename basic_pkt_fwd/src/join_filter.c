@@ -0,0 +1,194 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Bloom filter of EUIs (JoinEUI or DevEUI) gating join requests
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdlib.h>		/* calloc, malloc, free */
+#include <stdio.h>		/* fopen, fread, fwrite, rename, snprintf */
+#include <string.h>		/* memcmp, memcpy */
+
+#include "join_filter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+static const uint8_t filter_magic[4] = {'J', 'B', 'F', '1'};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static uint64_t mix64(uint64_t x);
+
+static uint32_t get_le32(const uint8_t * b);
+
+static void put_le32(uint8_t * b, uint32_t x);
+
+static bool params_valid(uint32_t nb_bits, unsigned nb_hash);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* 64-bit finalizer of MurmurHash3, all the bits of the EUI affect all the bits of the hash */
+static uint64_t mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static uint32_t get_le32(const uint8_t * b) {
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void put_le32(uint8_t * b, uint32_t x) {
+	b[0] = (uint8_t)x;
+	b[1] = (uint8_t)(x >> 8);
+	b[2] = (uint8_t)(x >> 16);
+	b[3] = (uint8_t)(x >> 24);
+}
+
+static bool params_valid(uint32_t nb_bits, unsigned nb_hash) {
+	return (nb_bits >= JOIN_FILTER_BITS_MIN) && (nb_bits <= JOIN_FILTER_BITS_MAX) && ((nb_bits & (nb_bits - 1)) == 0) && (nb_hash >= 1) && (nb_hash <= JOIN_FILTER_HASH_MAX);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int join_filter_init(struct join_filter_s * f, uint32_t nb_bits, unsigned nb_hash) {
+	uint32_t size = JOIN_FILTER_BITS_MIN;
+
+	while ((size < nb_bits) && (size < JOIN_FILTER_BITS_MAX)) {
+		size <<= 1;
+	}
+	if (!params_valid(size, nb_hash)) {
+		return JOIN_FILTER_ERROR;
+	}
+	f->bits = calloc(size / 8, 1);
+	if (f->bits == NULL) {
+		return JOIN_FILTER_ERROR;
+	}
+	f->nb_bits = size;
+	f->nb_keys = 0;
+	f->nb_hash = nb_hash;
+	return JOIN_FILTER_SUCCESS;
+}
+
+void join_filter_free(struct join_filter_s * f) {
+	free(f->bits);
+	f->bits = NULL;
+	f->nb_bits = 0;
+	f->nb_keys = 0;
+	f->nb_hash = 0;
+}
+
+void join_filter_add(struct join_filter_s * f, uint64_t eui) {
+	uint64_t h = mix64(eui);
+	uint32_t h1 = (uint32_t)h;
+	uint32_t h2 = (uint32_t)(h >> 32) | 1; /* odd, so the k positions differ */
+	uint32_t bit;
+	unsigned i;
+
+	for (i = 0; i < f->nb_hash; ++i) {
+		bit = (h1 + (i * h2)) & (f->nb_bits - 1);
+		f->bits[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+	}
+	f->nb_keys += 1;
+}
+
+bool join_filter_contains(const struct join_filter_s * f, uint64_t eui) {
+	uint64_t h = mix64(eui);
+	uint32_t h1 = (uint32_t)h;
+	uint32_t h2 = (uint32_t)(h >> 32) | 1;
+	uint32_t bit;
+	unsigned i;
+
+	if (f->bits == NULL) {
+		return false;
+	}
+	for (i = 0; i < f->nb_hash; ++i) {
+		bit = (h1 + (i * h2)) & (f->nb_bits - 1);
+		if ((f->bits[bit >> 3] & (1 << (bit & 7))) == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int join_filter_load(struct join_filter_s * f, const char * path) {
+	FILE * file;
+	uint8_t hdr[JOIN_FILTER_HDR_SIZE];
+	uint32_t nb_bits;
+	uint8_t * bits;
+
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		return JOIN_FILTER_ERROR;
+	}
+	if ((fread(hdr, 1, sizeof hdr, file) != sizeof hdr) || (memcmp(hdr, filter_magic, sizeof filter_magic) != 0)) {
+		fclose(file);
+		return JOIN_FILTER_ERROR;
+	}
+	nb_bits = get_le32(hdr + 8);
+	if (!params_valid(nb_bits, hdr[4])) {
+		fclose(file);
+		return JOIN_FILTER_ERROR;
+	}
+	bits = malloc(nb_bits / 8);
+	if (bits == NULL) {
+		fclose(file);
+		return JOIN_FILTER_ERROR;
+	}
+	if ((fread(bits, 1, nb_bits / 8, file) != nb_bits / 8) || (fgetc(file) != EOF)) {
+		/* truncated file (eg. still being written), or trailing data */
+		free(bits);
+		fclose(file);
+		return JOIN_FILTER_ERROR;
+	}
+	fclose(file);
+	f->bits = bits;
+	f->nb_bits = nb_bits;
+	f->nb_keys = get_le32(hdr + 12);
+	f->nb_hash = hdr[4];
+	return JOIN_FILTER_SUCCESS;
+}
+
+int join_filter_save(const struct join_filter_s * f, const char * path) {
+	FILE * file;
+	uint8_t hdr[JOIN_FILTER_HDR_SIZE] = {0};
+	char tmp_path[256];
+	int err;
+
+	if (f->bits == NULL) {
+		return JOIN_FILTER_ERROR;
+	}
+	snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path);
+	file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		return JOIN_FILTER_ERROR;
+	}
+	memcpy(hdr, filter_magic, sizeof filter_magic);
+	hdr[4] = (uint8_t)f->nb_hash;
+	put_le32(hdr + 8, f->nb_bits);
+	put_le32(hdr + 12, f->nb_keys);
+	err = (fwrite(hdr, 1, sizeof hdr, file) != sizeof hdr) || (fwrite(f->bits, 1, f->nb_bits / 8, file) != f->nb_bits / 8);
+	err |= (fclose(file) != 0);
+	/* the rename is atomic: a forwarder reloading the file never reads a partial filter */
+	if (err || (rename(tmp_path, path) != 0)) {
+		remove(tmp_path);
+		return JOIN_FILTER_ERROR;
+	}
+	return JOIN_FILTER_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,175 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Build the join filter file of the forwarder from lists of EUIs (JoinEUI
+	or DevEUI, 16 hexadecimal digits per line)
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* printf, fprintf, fopen, fgets */
+#include <string.h>		/* strlen */
+#include <stdlib.h>		/* atoi, strtoull, realloc, exit */
+#include <unistd.h>		/* getopt */
+
+#include "join_filter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define DEFAULT_BITS_PER_EUI	10 /* about 1% of false positives */
+#define DEFAULT_OUTPUT			"join_filter.bin"
+#define NB_PROBES				1000000 /* random EUIs used to measure the false positive rate */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+static uint64_t * eui_list = NULL;
+static unsigned eui_nb = 0;
+static unsigned eui_max = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+	MSG("Usage: join_filter_build [-b bits_per_eui] [-o filter_file] [eui_file ...]\n");
+	MSG("  each non-empty line not starting with '#' is an EUI, 16 hexadecimal digits\n");
+	MSG("  EUIs are read from stdin without eui_file, default filter file: %s\n", DEFAULT_OUTPUT);
+}
+
+/* read the EUIs of a list, returns the number of invalid lines or -1 */
+static int load_euis(FILE * fp, const char * name) {
+	char line[64];
+	char * end;
+	uint64_t * tmp;
+	unsigned len, nb_line = 0;
+	int nb_err = 0;
+
+	while (fgets(line, sizeof line, fp) != NULL) {
+		++nb_line;
+		len = strlen(line);
+		while ((len > 0) && ((line[len-1] == '\n') || (line[len-1] == '\r') || (line[len-1] == ' '))) {
+			line[--len] = 0;
+		}
+		if ((len == 0) || (line[0] == '#')) {
+			continue;
+		}
+		if (eui_nb == eui_max) {
+			eui_max = (eui_max == 0) ? 1024 : (2 * eui_max);
+			tmp = realloc(eui_list, eui_max * sizeof eui_list[0]);
+			if (tmp == NULL) {
+				MSG("ERROR: not enough memory for %u EUIs\n", eui_max);
+				return -1;
+			}
+			eui_list = tmp;
+		}
+		eui_list[eui_nb] = strtoull(line, &end, 16);
+		if ((len != 16) || (*end != 0)) {
+			MSG("WARNING: %s line %u is not an EUI, skipped\n", name, nb_line);
+			++nb_err;
+			continue;
+		}
+		++eui_nb;
+	}
+	return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+	int i;
+	unsigned bits_per_eui = DEFAULT_BITS_PER_EUI;
+	unsigned nb_hash, nb_pos = 0;
+	const char * output = DEFAULT_OUTPUT;
+	struct join_filter_s filter;
+	uint64_t probe;
+	FILE * fp;
+
+	while ((i = getopt(argc, argv, "hb:o:")) != -1) {
+		switch (i) {
+			case 'b':
+				bits_per_eui = (unsigned)atoi(optarg);
+				if ((bits_per_eui < 1) || (bits_per_eui > 32)) {
+					usage();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			default:
+				usage();
+				return (i == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		if (load_euis(stdin, "stdin") < 0) {
+			return EXIT_FAILURE;
+		}
+	} else {
+		for (i = optind; i < argc; ++i) {
+			fp = fopen(argv[i], "r");
+			if (fp == NULL) {
+				MSG("ERROR: impossible to open EUI list %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			if (load_euis(fp, argv[i]) < 0) {
+				return EXIT_FAILURE;
+			}
+			fclose(fp);
+		}
+	}
+
+	/* optimal number of hashes: bits per EUI * ln(2), 0.69 ~ 9/13 */
+	nb_hash = (bits_per_eui * 9 + 6) / 13;
+	if (nb_hash < 1) {
+		nb_hash = 1;
+	}
+	if (join_filter_init(&filter, (eui_nb > 0) ? (eui_nb * bits_per_eui) : 1, nb_hash) != JOIN_FILTER_SUCCESS) {
+		MSG("ERROR: impossible to allocate a filter for %u EUIs\n", eui_nb);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < (int)eui_nb; ++i) {
+		join_filter_add(&filter, eui_list[i]);
+	}
+	if (join_filter_save(&filter, output) != JOIN_FILTER_SUCCESS) {
+		MSG("ERROR: impossible to write filter file %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	/* measure the false positive rate on random EUIs (a few of them may be in the list) */
+	srand(1);
+	for (i = 0; i < NB_PROBES; ++i) {
+		probe = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+		nb_pos += join_filter_contains(&filter, probe) ? 1 : 0;
+	}
+	printf("%s: %u EUIs, %u bits (%u bytes), %u hashes, measured false positive rate %.3f%%\n", output, eui_nb, filter.nb_bits, filter.nb_bits / 8, filter.nb_hash, 100.0 * (double)nb_pos / NB_PROBES);
+	join_filter_free(&filter);
+	free(eui_list);
+	return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,647 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Asynchronous logging to stderr and/or syslog
+
+	Producers reserve a slot of a bounded multi-producer ring with a
+	compare-and-swap on the enqueue position, fill it and publish it with the
+	slot sequence number (no lock). The logging thread is the only consumer,
+	it sleeps on a condition variable when the ring is empty and the producers
+	only wake it up when it sleeps.
+
+	A message with more arguments or longer strings than a record holds takes
+	several consecutive records, reserved with the same compare-and-swap: the
+	arguments and the strings continue from one record to the next, and the
+	logging thread gathers them before formatting. The producer never
+	formats nor allocates, a message larger than REC_MAX records is cut.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stddef.h>		/* size_t, ptrdiff_t */
+#include <stdio.h>		/* fprintf, snprintf, vfprintf */
+#include <stdarg.h>		/* va_list */
+#include <string.h>		/* strlen, memcpy */
+#include <stdlib.h>		/* atexit */
+#include <pthread.h>
+#include <syslog.h>
+
+#include "logging.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RING_SIZE		128 /* number of records, must be a power of 2 */
+#define ARG_MAX			16 /* arguments per record (including '*' width and precision) */
+#define STR_SIZE		1024 /* room for string arguments per record */
+#define REC_MAX			8 /* max number of records of a message */
+#define LINE_SIZE		(REC_MAX * STR_SIZE + 512) /* formatted message */
+
+enum arg_type_e {
+	ARG_NONE = 0, /* "%%" or unsupported conversion */
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+union arg_u {
+	int i;
+	long l;
+	long long ll;
+	size_t z;
+	intmax_t j;
+	ptrdiff_t t;
+	double d;
+	long double ld;
+	const void * p;
+	struct {
+		uint16_t off; /* offset in the record string area */
+		uint16_t len;
+	} s;
+};
+
+/* the fields before arg are only used in the first record of a message */
+struct record_s {
+	volatile uint32_t seq; /* == position when free, position + 1 when filled (first record of a message) */
+	int nb_rec; /* records taken by the message */
+	int level;
+	int line;
+	const char * file;
+	const char * format; /* identifies the message, always a string literal */
+	int nb_arg;
+	int str_used; /* size of the strings, from the first record */
+	union arg_u arg[ARG_MAX];
+	char str[STR_SIZE];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const char * const logging_names[] = {
+        "EMERGENCY",
+        "ALERT",
+        "PANIC",
+        "ERROR",
+        "WARNING",
+        "NOTICE",
+        "INFO",
+        "DEBUG"
+};
+
+bool use_syslog = true; //overwritten by configuration file
+bool use_printf = true;// as well
+int logging_level = LOG_DEBUG; //this one also
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
+
+static struct record_s ring[RING_SIZE];
+static volatile uint32_t enq_pos = 0; /* shared by the producers */
+static uint32_t deq_pos = 0; /* only used by the logging thread */
+
+static volatile bool async_mode = false; /* producers use the ring */
+static volatile bool thread_stop = false;
+static bool thread_running = false;
+static volatile bool thread_idle = false; /* logging thread waits (or is about to) on cond_logging */
+static pthread_mutex_t mx_logging = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_logging = PTHREAD_COND_INITIALIZER;
+static bool exit_handler = false;
+static pthread_t thrid_logging;
+
+static volatile uint32_t cnt_queued = 0;
+static volatile uint32_t cnt_dropped = 0;
+static volatile uint32_t cnt_truncated = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+@brief Parse a conversion specification
+@param p pointer to the character following '%'
+@param nb_star receives the number of '*' (int arguments before the value)
+@param type receives the type of the value argument
+@return pointer to the character following the conversion specifier
+*/
+static const char * parse_spec(const char * p, int * nb_star, enum arg_type_e * type);
+
+/**
+@brief Read the next argument of a message, a string is read as a pointer
+*/
+static void read_arg(va_list * ap, enum arg_type_e type, union arg_u * v);
+
+/**
+@brief Count the records needed by the arguments and the strings of a message
+*/
+static int message_records(const char * format, va_list * ap);
+
+/**
+@brief Get an argument of the message starting at a position of the ring
+*/
+static union arg_u * arg_at(uint32_t pos, int n);
+
+/**
+@brief Get a byte of the strings of the message starting at a position of the ring
+*/
+static char * str_at(uint32_t pos, int off);
+
+/**
+@brief Copy a string in the records of a message, null terminated
+*/
+static void put_str(uint32_t pos, int off, const char * s, int len);
+
+/**
+@brief Format recorded arguments, the same way printf would have formatted the original call
+*/
+static int format_record(const char * format, int nb_arg, const union arg_u * arg, const char * str, char * out, int size);
+
+/**
+@brief Write a formatted message to the configured outputs
+*/
+static void write_message(int level, const char * file, int line, const char * msg);
+
+static bool pop_record(void);
+
+static void wake_logging(void);
+
+static void * thread_logging(void * arg);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static const char * parse_spec(const char * p, int * nb_star, enum arg_type_e * type) {
+	int len = 0; /* 1:h 2:hh 3:l 4:ll 5:z 6:j 7:t 8:L */
+
+	*nb_star = 0;
+	*type = ARG_NONE;
+	while ((*p == '-') || (*p == '+') || (*p == ' ') || (*p == '#') || (*p == '0')) {
+		++p;
+	}
+	if (*p == '*') {
+		*nb_star += 1;
+		++p;
+	}
+	while ((*p >= '0') && (*p <= '9')) {
+		++p;
+	}
+	if (*p == '.') {
+		++p;
+		if (*p == '*') {
+			*nb_star += 1;
+			++p;
+		}
+		while ((*p >= '0') && (*p <= '9')) {
+			++p;
+		}
+	}
+	switch (*p) {
+		case 'h': ++p; len = 1; if (*p == 'h') { ++p; len = 2; } break;
+		case 'l': ++p; len = 3; if (*p == 'l') { ++p; len = 4; } break;
+		case 'z': ++p; len = 5; break;
+		case 'j': ++p; len = 6; break;
+		case 't': ++p; len = 7; break;
+		case 'L': ++p; len = 8; break;
+	}
+	switch (*p) {
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+			switch (len) {
+				case 3: *type = ARG_LONG; break;
+				case 4: *type = ARG_LLONG; break;
+				case 5: *type = ARG_SIZE; break;
+				case 6: *type = ARG_INTMAX; break;
+				case 7: *type = ARG_PTRDIFF; break;
+				default: *type = ARG_INT; /* h and hh are promoted to int */
+			}
+			break;
+		case 'c':
+			*type = ARG_INT;
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			*type = (len == 8) ? ARG_LDOUBLE : ARG_DOUBLE;
+			break;
+		case 's':
+			*type = ARG_STR;
+			break;
+		case 'p': case 'n':
+			*type = ARG_PTR; /* %n is consumed but never written */
+			break;
+		case 0:
+			return p;
+	}
+	return p + 1;
+}
+
+static void read_arg(va_list * ap, enum arg_type_e type, union arg_u * v) {
+	switch (type) {
+		case ARG_INT: v->i = va_arg(*ap, int); break;
+		case ARG_LONG: v->l = va_arg(*ap, long); break;
+		case ARG_LLONG: v->ll = va_arg(*ap, long long); break;
+		case ARG_SIZE: v->z = va_arg(*ap, size_t); break;
+		case ARG_INTMAX: v->j = va_arg(*ap, intmax_t); break;
+		case ARG_PTRDIFF: v->t = va_arg(*ap, ptrdiff_t); break;
+		case ARG_DOUBLE: v->d = va_arg(*ap, double); break;
+		case ARG_LDOUBLE: v->ld = va_arg(*ap, long double); break;
+		case ARG_PTR: v->p = va_arg(*ap, void *); break;
+		case ARG_STR: v->p = va_arg(*ap, const char *); break;
+		default: v->i = 0;
+	}
+}
+
+static int message_records(const char * format, va_list * ap) {
+	const char * f;
+	int nb_star;
+	enum arg_type_e type;
+	union arg_u v;
+	int nb_arg = 0;
+	int str_size = 0;
+	int i, nb_rec;
+
+	for (f = format; *f != 0; ++f) {
+		if (*f != '%') {
+			continue;
+		}
+		if (f[1] == '%') {
+			++f;
+			continue;
+		}
+		f = parse_spec(f + 1, &nb_star, &type) - 1;
+		for (i = 0; i < nb_star; ++i) {
+			va_arg(*ap, int);
+		}
+		nb_arg += nb_star;
+		if (type == ARG_NONE) {
+			continue;
+		}
+		read_arg(ap, type, &v);
+		if ((type == ARG_STR) && (v.p != NULL)) {
+			str_size += strlen((const char *)v.p) + 1;
+		}
+		++nb_arg;
+	}
+	nb_rec = (nb_arg + ARG_MAX - 1) / ARG_MAX;
+	i = (str_size + STR_SIZE - 1) / STR_SIZE;
+	nb_rec = (i > nb_rec) ? i : nb_rec;
+	if (nb_rec < 1) {
+		nb_rec = 1;
+	}
+	return (nb_rec > REC_MAX) ? REC_MAX : nb_rec;
+}
+
+static union arg_u * arg_at(uint32_t pos, int n) {
+	return &ring[(pos + n / ARG_MAX) & (RING_SIZE - 1)].arg[n % ARG_MAX];
+}
+
+static char * str_at(uint32_t pos, int off) {
+	return &ring[(pos + off / STR_SIZE) & (RING_SIZE - 1)].str[off % STR_SIZE];
+}
+
+static void put_str(uint32_t pos, int off, const char * s, int len) {
+	int n;
+
+	while (len > 0) {
+		n = STR_SIZE - (off % STR_SIZE); /* room left in this record */
+		if (n > len) {
+			n = len;
+		}
+		memcpy(str_at(pos, off), s, n);
+		off += n;
+		s += n;
+		len -= n;
+	}
+	*str_at(pos, off) = 0;
+}
+
+static int format_record(const char * format, int nb_arg, const union arg_u * arg, const char * str, char * out, int size) {
+	const char * f = format;
+	const char * end;
+	char spec[32];
+	int nb_star;
+	enum arg_type_e type;
+	int a = 0; /* index of the next argument */
+	int len = 0;
+	int i, j;
+	const union arg_u * v;
+
+	while ((*f != 0) && (len < size - 1)) {
+		if (*f != '%') {
+			out[len++] = *f++;
+			continue;
+		}
+		if (f[1] == '%') {
+			out[len++] = '%';
+			f += 2;
+			continue;
+		}
+		end = parse_spec(f + 1, &nb_star, &type);
+		if (a + nb_star + ((type == ARG_NONE) ? 0 : 1) > nb_arg) {
+			f = end; /* argument was not recorded, skip the conversion but keep the text */
+			continue;
+		}
+		/* copy the specification, replacing '*' by the recorded values */
+		j = 0;
+		for (i = 0; (f + i < end) && (j < (int)sizeof spec - 12); ++i) {
+			if (f[i] == '*') {
+				j += sprintf(spec + j, "%d", arg[a++].i);
+			} else {
+				spec[j++] = f[i];
+			}
+		}
+		spec[j] = 0;
+		f = end;
+		v = &arg[a];
+		i = 0;
+		switch (type) {
+			case ARG_NONE: break;
+			case ARG_INT: i = snprintf(out + len, size - len, spec, v->i); break;
+			case ARG_LONG: i = snprintf(out + len, size - len, spec, v->l); break;
+			case ARG_LLONG: i = snprintf(out + len, size - len, spec, v->ll); break;
+			case ARG_SIZE: i = snprintf(out + len, size - len, spec, v->z); break;
+			case ARG_INTMAX: i = snprintf(out + len, size - len, spec, v->j); break;
+			case ARG_PTRDIFF: i = snprintf(out + len, size - len, spec, v->t); break;
+			case ARG_DOUBLE: i = snprintf(out + len, size - len, spec, v->d); break;
+			case ARG_LDOUBLE: i = snprintf(out + len, size - len, spec, v->ld); break;
+			case ARG_PTR:
+				if (spec[j-1] == 'p') {
+					i = snprintf(out + len, size - len, spec, v->p);
+				}
+				break;
+			case ARG_STR:
+				if (v->s.off == UINT16_MAX) {
+					i = snprintf(out + len, size - len, spec, "(null)");
+				} else {
+					i = snprintf(out + len, size - len, spec, str + v->s.off);
+				}
+				break;
+		}
+		if (type != ARG_NONE) {
+			++a;
+		}
+		if (i > 0) {
+			len += i;
+		}
+	}
+	if (len > size - 1) {
+		len = size - 1;
+	}
+	out[len] = 0;
+	return len;
+}
+
+static void write_message(int level, const char * file, int line, const char * msg) {
+	if (use_syslog) {
+		syslog(level, "%s", msg);
+	}
+	if (use_printf) {
+		fprintf(stderr, "[%s](%s:%d) %s", logging_names[level], file, line, msg);
+	}
+}
+
+static bool pop_record(void) {
+	static char line[LINE_SIZE];
+	static union arg_u arg[REC_MAX * ARG_MAX]; /* arguments and strings of a message of several records */
+	static char str[REC_MAX * STR_SIZE];
+	struct record_s * rec = &ring[deq_pos & (RING_SIZE - 1)];
+	struct record_s * next;
+	int nb_rec, j;
+
+	if (rec->seq != deq_pos + 1) {
+		return false; /* empty */
+	}
+	__sync_synchronize(); /* read the records after the sequence number of the first one */
+	nb_rec = rec->nb_rec;
+	if (nb_rec == 1) {
+		format_record(rec->format, rec->nb_arg, rec->arg, rec->str, line, sizeof line);
+	} else {
+		for (j = 0; j < nb_rec; ++j) {
+			next = &ring[(deq_pos + j) & (RING_SIZE - 1)];
+			memcpy(&arg[j * ARG_MAX], next->arg, sizeof next->arg);
+			if (j * STR_SIZE < rec->str_used) {
+				memcpy(&str[j * STR_SIZE], next->str, STR_SIZE);
+			}
+		}
+		format_record(rec->format, rec->nb_arg, arg, str, line, sizeof line);
+	}
+	write_message(rec->level, rec->file, rec->line, line);
+	__sync_synchronize();
+	for (j = 0; j < nb_rec; ++j) {
+		ring[(deq_pos + j) & (RING_SIZE - 1)].seq = deq_pos + j + RING_SIZE; /* free for the next lap */
+	}
+	deq_pos += nb_rec;
+	return true;
+}
+
+/* only takes the mutex when the logging thread sleeps, so a busy logging thread costs the producers nothing */
+static void wake_logging(void) {
+	__sync_synchronize(); /* the record (or thread_stop) is visible before thread_idle is read */
+	if (thread_idle) {
+		pthread_mutex_lock(&mx_logging);
+		pthread_cond_signal(&cond_logging);
+		pthread_mutex_unlock(&mx_logging);
+	}
+}
+
+static void * thread_logging(void * arg) {
+	(void)arg;
+	while (!thread_stop) {
+		if (pop_record()) {
+			continue;
+		}
+		/* no wake-up lost: a producer either sees thread_idle set, or its record is seen here */
+		pthread_mutex_lock(&mx_logging);
+		thread_idle = true;
+		__sync_synchronize();
+		if ((ring[deq_pos & (RING_SIZE - 1)].seq != deq_pos + 1) && !thread_stop) {
+			pthread_cond_wait(&cond_logging, &mx_logging);
+		}
+		thread_idle = false;
+		pthread_mutex_unlock(&mx_logging);
+	}
+	while (pop_record()); /* drain */
+	return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int logging_start(void) {
+	int i;
+
+	if (thread_running) {
+		return 0;
+	}
+	for (i = 0; i < RING_SIZE; ++i) {
+		ring[i].seq = enq_pos + i;
+	}
+	deq_pos = enq_pos;
+	thread_stop = false;
+	if (pthread_create(&thrid_logging, NULL, thread_logging, NULL) != 0) {
+		return -1;
+	}
+	thread_running = true;
+	__sync_synchronize();
+	async_mode = true;
+	if (!exit_handler) {
+		atexit(logging_stop); /* do not lose the last messages on exit() */
+		exit_handler = true;
+	}
+	return 0;
+}
+
+void logging_stop(void) {
+	if (!thread_running) {
+		return;
+	}
+	async_mode = false;
+	__sync_synchronize();
+	thread_stop = true;
+	wake_logging();
+	pthread_join(thrid_logging, NULL);
+	thread_running = false;
+}
+
+void logging_push(int level, const char * file, int line, const char * format, ...) {
+	va_list ap;
+	struct record_s * rec;
+	uint32_t pos;
+	int32_t dif;
+	const char * f;
+	const char * s;
+	int nb_star;
+	enum arg_type_e type;
+	union arg_u v;
+	int nb_rec, str_max;
+	int i, n;
+	bool trunc = false;
+	char line_sync[LINE_SIZE];
+
+	if (!async_mode) {
+		va_start(ap, format);
+		i = vsnprintf(line_sync, sizeof line_sync, format, ap);
+		va_end(ap);
+		if (i >= (int)sizeof line_sync) {
+			line_sync[sizeof line_sync - 2] = '\n'; /* cut, but still ends the line */
+			__sync_fetch_and_add(&cnt_truncated, 1);
+		}
+		write_message(level, file, line, line_sync);
+		return;
+	}
+
+	/* records needed by the arguments and the strings */
+	va_start(ap, format);
+	nb_rec = message_records(format, &ap);
+	va_end(ap);
+
+	/* reserve them, the last one is free only if all the previous ones are (freed in order) */
+	pos = enq_pos;
+	while (1) {
+		dif = (int32_t)(ring[(pos + nb_rec - 1) & (RING_SIZE - 1)].seq - (pos + nb_rec - 1));
+		if (dif == 0) {
+			if (__sync_bool_compare_and_swap(&enq_pos, pos, pos + nb_rec)) {
+				break;
+			}
+		} else if (dif < 0) {
+			__sync_fetch_and_add(&cnt_dropped, 1); /* ring full, never block the caller */
+			return;
+		}
+		pos = enq_pos;
+	}
+	__sync_synchronize();
+	rec = &ring[pos & (RING_SIZE - 1)];
+
+	/* fill them with the arguments, as described by the format */
+	rec->nb_rec = nb_rec;
+	rec->level = level;
+	rec->file = file;
+	rec->line = line;
+	rec->format = format;
+	rec->str_used = 0;
+	str_max = nb_rec * STR_SIZE - 1; /* last byte for the null of a cut string */
+	n = 0;
+	va_start(ap, format);
+	for (f = format; *f != 0; ++f) {
+		if (*f != '%') {
+			continue;
+		}
+		if (f[1] == '%') {
+			++f;
+			continue;
+		}
+		f = parse_spec(f + 1, &nb_star, &type) - 1;
+		if (n + nb_star + 1 > nb_rec * ARG_MAX) {
+			trunc = true;
+			break;
+		}
+		for (i = 0; i < nb_star; ++i) {
+			arg_at(pos, n++)->i = va_arg(ap, int);
+		}
+		if (type == ARG_NONE) {
+			continue;
+		}
+		read_arg(&ap, type, &v);
+		if (type == ARG_STR) {
+			/* the string may not outlive the call, copy it */
+			s = (const char *)v.p;
+			if (s == NULL) {
+				v.s.off = UINT16_MAX;
+				v.s.len = 0;
+			} else {
+				i = strlen(s);
+				if (i > str_max - rec->str_used) {
+					i = str_max - rec->str_used;
+					trunc = true;
+				}
+				put_str(pos, rec->str_used, s, i);
+				v.s.off = rec->str_used;
+				v.s.len = i;
+				rec->str_used += i + 1;
+				if (rec->str_used > str_max) {
+					rec->str_used = str_max; /* next strings will be empty */
+				}
+			}
+		}
+		*arg_at(pos, n++) = v;
+	}
+	va_end(ap);
+	rec->nb_arg = n;
+
+	/* publish the message, with the sequence number of its first record */
+	__sync_synchronize();
+	rec->seq = pos + 1;
+	__sync_fetch_and_add(&cnt_queued, 1);
+	if (trunc) {
+		__sync_fetch_and_add(&cnt_truncated, 1);
+	}
+	wake_logging();
+}
+
+void logging_get_counters(struct logging_counters_s * cnt) {
+	cnt->queued = cnt_queued;
+	cnt->dropped = cnt_dropped;
+	cnt->truncated = cnt_truncated;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
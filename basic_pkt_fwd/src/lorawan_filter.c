@@ -0,0 +1,190 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	LoRaWAN header pre-parser and DevAddr filter for uplinks
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdlib.h>		/* malloc, free, qsort */
+#include <string.h>		/* memcpy */
+
+#include "lorawan_filter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define MHDR_MAJOR_R1	0 /* LoRaWAN R1, the only major version */
+
+/* frame sizes: MHDR, then the message, then the 4-byte MIC */
+#define SIZE_JOIN_REQUEST	23 /* JoinEUI, DevEUI, DevNonce */
+#define SIZE_JOIN_ACCEPT	17 /* 33 with a CFList */
+#define SIZE_DATA_MIN		12 /* FHDR without FOpts (DevAddr, FCtrl, FCnt) */
+#define SIZE_REJOIN_MIN		19 /* rejoin type 0 and 2, type 1 is 24 */
+
+/* number of NwkID bits in a NetID, by NetID type (LoRaWAN backend interfaces) */
+static const uint8_t nwkid_bits[8] = {6, 6, 9, 11, 12, 13, 15, 17};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static uint32_t get_le32(const uint8_t * b);
+
+static uint64_t get_le64(const uint8_t * b);
+
+static int compare_addr(const void * a, const void * b);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint32_t get_le32(const uint8_t * b) {
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t * b) {
+	return (uint64_t)get_le32(b) | ((uint64_t)get_le32(b + 4) << 32);
+}
+
+static int compare_addr(const void * a, const void * b) {
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lorawan_parse(const uint8_t * payload, unsigned size, struct lorawan_hdr_s * hdr) {
+	unsigned fopts_len;
+
+	if ((size < 1) || ((payload[0] & 0x03) != MHDR_MAJOR_R1)) {
+		return LORAWAN_ERROR;
+	}
+	hdr->mtype = payload[0] >> 5;
+	switch (hdr->mtype) {
+		case MTYPE_JOIN_REQUEST:
+			if (size != SIZE_JOIN_REQUEST) {
+				return LORAWAN_ERROR;
+			}
+			hdr->join_eui = get_le64(payload + 1);
+			hdr->dev_eui = get_le64(payload + 9);
+			break;
+		case MTYPE_JOIN_ACCEPT:
+			if ((size != SIZE_JOIN_ACCEPT) && (size != SIZE_JOIN_ACCEPT + 16)) {
+				return LORAWAN_ERROR;
+			}
+			break;
+		case MTYPE_UNCONF_UP:
+		case MTYPE_UNCONF_DOWN:
+		case MTYPE_CONF_UP:
+		case MTYPE_CONF_DOWN:
+			if ((size < SIZE_DATA_MIN) || (size < SIZE_DATA_MIN + (unsigned)(payload[5] & FCTRL_FOPTS_LEN))) {
+				return LORAWAN_ERROR;
+			}
+			hdr->devaddr = get_le32(payload + 1);
+			hdr->fctrl = payload[5];
+			fopts_len = hdr->fctrl & FCTRL_FOPTS_LEN;
+			hdr->fport = (size > SIZE_DATA_MIN + fopts_len) ? payload[8 + fopts_len] : -1; /* after MHDR, DevAddr, FCtrl, FCnt and FOpts */
+			break;
+		case MTYPE_REJOIN:
+			if (size < SIZE_REJOIN_MIN) {
+				return LORAWAN_ERROR;
+			}
+			break;
+		default: /* proprietary, any size */
+			break;
+	}
+	return LORAWAN_SUCCESS;
+}
+
+int addr_set_init(struct addr_set_s * set, const uint32_t * addr, unsigned nb) {
+	unsigned i, j;
+
+	set->addr = NULL;
+	set->nb = 0;
+	if (nb == 0) {
+		return LORAWAN_SUCCESS;
+	}
+	set->addr = malloc(nb * sizeof set->addr[0]);
+	if (set->addr == NULL) {
+		return LORAWAN_ERROR;
+	}
+	memcpy(set->addr, addr, nb * sizeof set->addr[0]);
+	qsort(set->addr, nb, sizeof set->addr[0], compare_addr);
+	for (i = 1, j = 1; i < nb; ++i) {
+		if (set->addr[i] != set->addr[j - 1]) {
+			set->addr[j++] = set->addr[i];
+		}
+	}
+	set->nb = j;
+	return LORAWAN_SUCCESS;
+}
+
+void addr_set_free(struct addr_set_s * set) {
+	free(set->addr);
+	set->addr = NULL;
+	set->nb = 0;
+}
+
+bool addr_set_contains(const struct addr_set_s * set, uint32_t addr) {
+	unsigned lo = 0;
+	unsigned hi = set->nb; /* search in [lo, hi[ */
+	unsigned mid;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2);
+		if (set->addr[mid] < addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo < set->nb) && (set->addr[lo] == addr);
+}
+
+void netid_devaddr_prefix(uint32_t netid, uint32_t * prefix, uint32_t * mask) {
+	unsigned type = (netid >> 21) & 0x07;
+	unsigned id_bits = nwkid_bits[type];
+	unsigned len = type + 1 + id_bits; /* type prefix (type ones then a zero), then the NwkID */
+	uint32_t p;
+
+	p = ((((uint32_t)1 << type) - 1) << 1); /* type prefix */
+	p = (p << id_bits) | (netid & (((uint32_t)1 << id_bits) - 1));
+	*prefix = p << (32 - len);
+	*mask = 0xFFFFFFFF << (32 - len);
+}
+
+int devaddr_filter_add_netid(struct devaddr_filter_s * f, uint32_t netid) {
+	if (f->nb_netid >= NETID_MAX) {
+		return LORAWAN_ERROR;
+	}
+	netid_devaddr_prefix(netid, &f->prefix[f->nb_netid], &f->mask[f->nb_netid]);
+	f->nb_netid += 1;
+	return LORAWAN_SUCCESS;
+}
+
+enum devaddr_verdict_e devaddr_filter_check(const struct devaddr_filter_s * f, uint32_t devaddr) {
+	unsigned i;
+
+	if (addr_set_contains(&f->deny, devaddr)) {
+		return DEVADDR_DENIED;
+	}
+	if ((f->nb_netid == 0) || addr_set_contains(&f->allow, devaddr)) {
+		return DEVADDR_PASS;
+	}
+	for (i = 0; i < f->nb_netid; ++i) {
+		if ((devaddr & f->mask[i]) == f->prefix[i]) {
+			return DEVADDR_PASS;
+		}
+	}
+	return DEVADDR_FOREIGN;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
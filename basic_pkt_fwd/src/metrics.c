@@ -0,0 +1,281 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Local metrics export, minimal HTTP listener serving the forwarder
+	counters, gauges and histograms in the Prometheus text format
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* snprintf, vsnprintf */
+#include <stdarg.h>		/* va_list */
+#include <stdlib.h>		/* realloc, free */
+#include <string.h>		/* memset, strstr */
+#include <unistd.h>		/* close */
+#include <pthread.h>
+
+#include <sys/time.h>	/* timeval */
+#include <sys/socket.h> /* socket specific definitions */
+#include <netinet/in.h> /* INET constants and stuff */
+#include <netdb.h>		/* getaddrinfo */
+
+#include "histogram.h"
+#include "metrics.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define LISTEN_BACKLOG		4
+#define REQUEST_TIMEOUT_MS	1000 /* a client must send its request within that delay */
+#define HIST_LE_MIN			4 /* first exported bucket starts at 2^4 us */
+#define HIST_LE_MAX			26 /* last exported bucket starts at 2^26 us (~67 s) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
+
+static int sock_listen = -1;
+static bool thread_running = false;
+static pthread_t thrid_metrics;
+static metrics_render_t render_cb = NULL;
+static struct metrics_buf_s page; /* only used by the listener thread */
+static volatile uint32_t cnt_truncated = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+@brief Listener thread: accept a connection, read the request, send the page, close
+*/
+static void * thread_metrics(void * arg);
+
+/**
+@brief Write a whole buffer to a socket, return false on error
+*/
+static bool send_all(int sock, const char * buff, int size);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool send_all(int sock, const char * buff, int size) {
+	int i;
+
+	while (size > 0) {
+		i = send(sock, buff, size, MSG_NOSIGNAL);
+		if (i <= 0) {
+			return false;
+		}
+		buff += i;
+		size -= i;
+	}
+	return true;
+}
+
+static void * thread_metrics(void * arg) {
+	int sock;
+	int i;
+	int len;
+	char request[512];
+	char header[128];
+	struct timeval timeout = {REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000};
+
+	(void)arg;
+	while (1) {
+		sock = accept(sock_listen, NULL, NULL);
+		if (sock == -1) {
+			continue;
+		}
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (void *)&timeout, sizeof timeout);
+		setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (void *)&timeout, sizeof timeout);
+
+		/* read the request headers, the content of the request is ignored */
+		len = 0;
+		while (len < (int)(sizeof request) - 1) {
+			i = recv(sock, request + len, sizeof request - 1 - len, 0);
+			if (i <= 0) {
+				break;
+			}
+			len += i;
+			request[len] = 0;
+			if (strstr(request, "\r\n\r\n") != NULL) {
+				break;
+			}
+		}
+
+		/* compose and send the page */
+		page.len = 0;
+		page.full = false;
+		render_cb(&page);
+		if (page.full) {
+			cnt_truncated += 1;
+		}
+		len = snprintf(header, sizeof header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\nConnection: close\r\n\r\n", page.len);
+		if (send_all(sock, header, len)) {
+			send_all(sock, page.data, page.len);
+		}
+		close(sock);
+	}
+	return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int metrics_start(const char * port, metrics_render_t render) {
+	int i;
+	int one = 1;
+	struct addrinfo hints;
+	struct addrinfo *result; /* store result of getaddrinfo */
+	struct addrinfo *q; /* pointer to move into *result data */
+
+	if ((render == NULL) || thread_running) {
+		return METRICS_ERROR;
+	}
+	render_cb = render;
+
+	/* only listen on the loopback interface */
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	i = getaddrinfo("localhost", port, &hints, &result);
+	if (i != 0) {
+		return METRICS_ERROR;
+	}
+	for (q=result; q!=NULL; q=q->ai_next) {
+		sock_listen = socket(q->ai_family, q->ai_socktype, q->ai_protocol);
+		if (sock_listen == -1) {
+			continue; /* socket failed, try next field */
+		}
+		setsockopt(sock_listen, SOL_SOCKET, SO_REUSEADDR, (void *)&one, sizeof one);
+		if ((bind(sock_listen, q->ai_addr, q->ai_addrlen) == 0) && (listen(sock_listen, LISTEN_BACKLOG) == 0)) {
+			break; /* success, get out of loop */
+		}
+		close(sock_listen);
+		sock_listen = -1;
+	}
+	freeaddrinfo(result);
+	if (sock_listen == -1) {
+		return METRICS_ERROR;
+	}
+
+	i = pthread_create(&thrid_metrics, NULL, thread_metrics, NULL);
+	if (i != 0) {
+		close(sock_listen);
+		sock_listen = -1;
+		return METRICS_ERROR;
+	}
+	thread_running = true;
+	return METRICS_SUCCESS;
+}
+
+void metrics_stop(void) {
+	if (thread_running) {
+		pthread_cancel(thrid_metrics);
+		pthread_join(thrid_metrics, NULL);
+		thread_running = false;
+		free(page.data);
+		page.data = NULL;
+		page.size = 0;
+	}
+	if (sock_listen != -1) {
+		close(sock_listen);
+		sock_listen = -1;
+	}
+}
+
+uint32_t metrics_truncated(void) {
+	return cnt_truncated;
+}
+
+void metrics_printf(struct metrics_buf_s * mb, const char * format, ...) {
+	int i;
+	int size;
+	char * data;
+	va_list args;
+
+	if (mb->full) {
+		return;
+	}
+	va_start(args, format);
+	i = vsnprintf((mb->data == NULL) ? NULL : (mb->data + mb->len), mb->size - mb->len, format, args);
+	va_end(args);
+	if (i < 0) {
+		return;
+	}
+	if (mb->len + i >= mb->size) {
+		/* grow the page, or drop this text and the rest so the page is only cut between lines */
+		size = (mb->size == 0) ? METRICS_BUFF_SIZE : mb->size;
+		while ((size <= mb->len + i) && (size < METRICS_BUFF_MAX)) {
+			size *= 2;
+		}
+		data = (size > mb->len + i) ? realloc(mb->data, size) : NULL;
+		if (data == NULL) {
+			if (mb->data != NULL) {
+				mb->data[mb->len] = 0;
+			}
+			mb->full = true;
+			return;
+		}
+		mb->data = data;
+		mb->size = size;
+		va_start(args, format);
+		vsnprintf(mb->data + mb->len, mb->size - mb->len, format, args);
+		va_end(args);
+	}
+	mb->len += i;
+}
+
+void metrics_family(struct metrics_buf_s * mb, const char * name, const char * type, const char * help) {
+	metrics_printf(mb, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_sample(struct metrics_buf_s * mb, const char * name, const char * labels, uint64_t value) {
+	if (labels == NULL) {
+		metrics_printf(mb, "%s %llu\n", name, (unsigned long long)value);
+	} else {
+		metrics_printf(mb, "%s{%s} %llu\n", name, labels, (unsigned long long)value);
+	}
+}
+
+void metrics_histogram(struct metrics_buf_s * mb, const char * name, const char * labels, const struct hist_s * snap) {
+	int i;
+	int k = HIST_LE_MIN;
+	uint32_t cumul = 0;
+	const char * sep = (labels == NULL) ? "" : ",";
+
+	if (labels == NULL) {
+		labels = "";
+	}
+	/* "le" is inclusive: each bound is the highest value of the bucket starting at a power of 2, so cumulative counts are exact */
+	for (i = 0; (i < HIST_BUCKET_NB) && (k <= HIST_LE_MAX); ++i) {
+		cumul += snap->count[i];
+		if (hist_bucket_low(i) == (1u << k)) {
+			metrics_printf(mb, "%s_bucket{%s%sle=\"%.6f\"} %u\n", name, labels, sep, (double)hist_bucket_high(i) / 1e6, cumul);
+			++k;
+		}
+	}
+	metrics_printf(mb, "%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, hist_total(snap));
+	if (*labels == 0) {
+		metrics_printf(mb, "%s_sum %.6f\n", name, (double)hist_sum(snap) / 1e6);
+		metrics_printf(mb, "%s_count %u\n", name, hist_total(snap));
+	} else {
+		metrics_printf(mb, "%s_sum{%s} %.6f\n", name, labels, (double)hist_sum(snap) / 1e6);
+		metrics_printf(mb, "%s_count{%s} %u\n", name, labels, hist_total(snap));
+	}
+}
+
+/* --- EOF ------------------------------------------------------------------ */
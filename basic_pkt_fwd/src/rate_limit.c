@@ -0,0 +1,165 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Per-device uplink rate limiting with token buckets
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>		/* memset */
+
+#include "rate_limit.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NIL				0xFFFF /* no bucket */
+#define MTOKENS_PER_PKT	1000
+#define MS_PER_HOUR		3600000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static unsigned hash_addr(uint32_t devaddr);
+
+static void lru_unlink(struct rate_table_s * t, uint16_t i);
+
+static void lru_push_first(struct rate_table_s * t, uint16_t i);
+
+static void hash_unlink(struct rate_table_s * t, uint16_t i);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* DevAddr low bits are assigned by the network server, mix them all anyway */
+static unsigned hash_addr(uint32_t devaddr) {
+	return (unsigned)((devaddr * 0x9E3779B1u) >> 16) & (RATE_HASH_SIZE - 1);
+}
+
+static void lru_unlink(struct rate_table_s * t, uint16_t i) {
+	struct rate_bucket_s * b = &t->b[i];
+
+	if (b->lru_prev != NIL) {
+		t->b[b->lru_prev].lru_next = b->lru_next;
+	} else {
+		t->lru_first = b->lru_next;
+	}
+	if (b->lru_next != NIL) {
+		t->b[b->lru_next].lru_prev = b->lru_prev;
+	} else {
+		t->lru_last = b->lru_prev;
+	}
+}
+
+static void lru_push_first(struct rate_table_s * t, uint16_t i) {
+	t->b[i].lru_prev = NIL;
+	t->b[i].lru_next = t->lru_first;
+	if (t->lru_first != NIL) {
+		t->b[t->lru_first].lru_prev = i;
+	} else {
+		t->lru_last = i;
+	}
+	t->lru_first = i;
+}
+
+static void hash_unlink(struct rate_table_s * t, uint16_t i) {
+	uint16_t * link = &t->head[hash_addr(t->b[i].devaddr)];
+
+	while (*link != i) {
+		link = &t->b[*link].hash_next;
+	}
+	*link = t->b[i].hash_next;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void rate_table_init(struct rate_table_s * t) {
+	memset(t, 0, sizeof *t);
+	memset(t->head, 0xFF, sizeof t->head); /* all NIL */
+	t->lru_first = NIL;
+	t->lru_last = NIL;
+}
+
+enum rate_verdict_e rate_check(struct rate_table_s * t, uint32_t devaddr, const struct rate_limit_s * lim, uint64_t now_ms) {
+	unsigned h = hash_addr(devaddr);
+	uint16_t i;
+	struct rate_bucket_s * b;
+	uint64_t refill;
+	uint32_t max = lim->burst * MTOKENS_PER_PKT;
+
+	for (i = t->head[h]; (i != NIL) && (t->b[i].devaddr != devaddr); i = t->b[i].hash_next);
+	if (i != NIL) {
+		lru_unlink(t, i);
+	} else {
+		/* new device: take a free bucket, or evict the least recently used one */
+		if (t->nb < RATE_TABLE_SIZE) {
+			i = (uint16_t)t->nb++;
+		} else {
+			i = t->lru_last;
+			lru_unlink(t, i);
+			hash_unlink(t, i);
+			t->evictions += 1;
+		}
+		b = &t->b[i];
+		b->devaddr = devaddr;
+		b->mtokens = max;
+		b->last_ms = now_ms;
+		b->over = 0;
+		b->dropped = 0;
+		b->hash_next = t->head[h];
+		t->head[h] = i;
+	}
+	lru_push_first(t, i);
+	b = &t->b[i];
+
+	/* refill, limits can change with the class of the device */
+	refill = ((now_ms - b->last_ms) * lim->per_hour * MTOKENS_PER_PKT) / MS_PER_HOUR;
+	if (refill > 0) {
+		b->last_ms = now_ms; /* time is only consumed with tokens, frequent packets keep their partial refill */
+		b->mtokens = ((uint64_t)b->mtokens + refill > max) ? max : (b->mtokens + (uint32_t)refill);
+	}
+	if (b->mtokens >= MTOKENS_PER_PKT) {
+		b->mtokens -= MTOKENS_PER_PKT;
+		return RATE_PASS;
+	}
+	b->over += 1;
+	if ((lim->downsample > 0) && ((b->over % lim->downsample) == 0)) {
+		return RATE_SAMPLED;
+	}
+	b->dropped += 1;
+	return RATE_DROP;
+}
+
+unsigned rate_top_offenders(struct rate_table_s * t, struct rate_offender_s * top, unsigned nb_max) {
+	unsigned i, j, nb = 0;
+
+	for (i = 0; i < t->nb; ++i) {
+		if (t->b[i].dropped == 0) {
+			continue;
+		}
+		/* insertion in the sorted array, the smallest falls off the end */
+		for (j = nb; (j > 0) && (top[j - 1].dropped < t->b[i].dropped); --j) {
+			if (j < nb_max) {
+				top[j] = top[j - 1];
+			}
+		}
+		if (j < nb_max) {
+			top[j].devaddr = t->b[i].devaddr;
+			top[j].dropped = t->b[i].dropped;
+			if (nb < nb_max) {
+				++nb;
+			}
+		}
+		t->b[i].dropped = 0;
+	}
+	return nb;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,127 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Compact binary encoding of the received packets carried by PUSH_DATA_BIN
+	datagrams
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>		/* memset, memcpy */
+
+#include "rxpk_bin.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int put_varint(uint8_t * buff, uint64_t v);
+
+static uint64_t zigzag(int64_t v);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* 7 bits per byte, least significant group first, bit 7 set when more bytes follow */
+static int put_varint(uint8_t * buff, uint64_t v) {
+	int i = 0;
+
+	while (v >= 0x80) {
+		buff[i++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	buff[i++] = (uint8_t)v;
+	return i;
+}
+
+/* small differences of both signs give small varints: 0, -1, 1, -2... -> 0, 1, 2, 3... */
+static uint64_t zigzag(int64_t v) {
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void rxpk_bin_reset(struct rxpk_bin_s * ctx) {
+	memset(ctx, 0, sizeof *ctx);
+}
+
+int rxpk_bin_serialize(struct rxpk_bin_s * ctx, const struct lgw_pkt_rx_s * p, uint64_t time_us, uint8_t * buff) {
+	int i = 7;
+	float rssi = -p->rssi;
+	int snr;
+
+	/* fixed header */
+	switch (p->status) {
+		case STAT_CRC_OK:	buff[0] = RXPK_BIN_STAT_OK; break;
+		case STAT_CRC_BAD:	buff[0] = RXPK_BIN_STAT_BAD; break;
+		case STAT_NO_CRC:	buff[0] = RXPK_BIN_STAT_NOCRC; break;
+		default: return -1;
+	}
+	if (time_us != 0) {
+		buff[0] |= RXPK_BIN_TIME;
+	}
+	buff[1] = (uint8_t)((p->if_chain & 0x0F) | ((p->rf_chain & 0x01) << 4));
+	buff[2] = 0;
+	buff[3] = 0;
+	buff[4] = (rssi <= 0) ? 0 : ((rssi >= 255) ? 255 : (uint8_t)(rssi + 0.5));
+	buff[5] = 0;
+	buff[6] = 0;
+	if (p->modulation == MOD_LORA) {
+		switch (p->datarate) {
+			case DR_LORA_SF7:	buff[2] = 7; break;
+			case DR_LORA_SF8:	buff[2] = 8; break;
+			case DR_LORA_SF9:	buff[2] = 9; break;
+			case DR_LORA_SF10:	buff[2] = 10; break;
+			case DR_LORA_SF11:	buff[2] = 11; break;
+			case DR_LORA_SF12:	buff[2] = 12; break;
+			default: return -1;
+		}
+		switch (p->bandwidth) {
+			case BW_125KHZ:	break;
+			case BW_250KHZ:	buff[2] |= 0x10; break;
+			case BW_500KHZ:	buff[2] |= 0x20; break;
+			default: return -1;
+		}
+		switch (p->coderate) {
+			case 0:				break; /* CR0 case (mostly false sync), "OFF" */
+			case CR_LORA_4_5:	buff[3] = 1; break;
+			case CR_LORA_4_6:	buff[3] = 2; break;
+			case CR_LORA_4_7:	buff[3] = 3; break;
+			case CR_LORA_4_8:	buff[3] = 4; break;
+			default: return -1;
+		}
+		snr = (p->snr < 0) ? (int)(10 * p->snr - 0.5) : (int)(10 * p->snr + 0.5); /* tenths of dB, like "%.1f" */
+		buff[5] = (uint8_t)snr;
+		buff[6] = (uint8_t)((uint16_t)snr >> 8);
+	} else if (p->modulation == MOD_FSK) {
+		buff[0] |= RXPK_BIN_FSK;
+	} else {
+		return -1;
+	}
+
+	/* varint fields, differences with the previous record */
+	i += put_varint(buff + i, zigzag((int32_t)(p->count_us - ctx->tmst)));
+	ctx->tmst = p->count_us;
+	if (time_us != 0) {
+		i += put_varint(buff + i, zigzag((int64_t)(time_us - ctx->time_us)));
+		ctx->time_us = time_us;
+	}
+	i += put_varint(buff + i, zigzag((int32_t)(p->freq_hz - ctx->freq_hz)));
+	ctx->freq_hz = p->freq_hz;
+	if (p->modulation == MOD_FSK) {
+		i += put_varint(buff + i, p->datarate);
+	}
+	i += put_varint(buff + i, p->size);
+
+	/* raw payload */
+	memcpy(buff + i, p->payload, p->size);
+	return i + p->size;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
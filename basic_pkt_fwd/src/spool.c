@@ -0,0 +1,306 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Persistent store-and-forward queue for upstream datagrams
+
+	File layout: a header followed by the data area. Each record is a 32b
+	length followed by the datagram, padded to a multiple of 4 bytes. A
+	length of WRAP_MARK means the next record is at the start of the data
+	area. The tail is never moved onto the head, so head == tail only when
+	the queue is empty. Each record is synced to the file before the header
+	counting it is updated, so a crash can only lose the last datagram
+	stored, and the records are counted again when the file is opened.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <string.h>		/* memcpy */
+#include <unistd.h>		/* close, ftruncate */
+#include <fcntl.h>		/* open */
+#include <sys/mman.h>	/* mmap, msync */
+#include <sys/stat.h>	/* fstat */
+
+#include "spool.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SPOOL_MAGIC		0x4C4F4F53 /* "SPOL" */
+#define SPOOL_VERSION	1
+#define HEADER_SIZE		64 /* data area starts after the header */
+#define WRAP_MARK		0xFFFFFFFF
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct spool_hdr_s {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t data_size; /* size of the data area */
+	uint32_t head; /* offset of the oldest record */
+	uint32_t tail; /* offset where the next record will be written */
+	uint32_t count; /* number of records */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
+
+static uint8_t * map = NULL; /* whole file */
+static size_t map_size = 0;
+static struct spool_hdr_s * hdr = NULL;
+static uint8_t * data = NULL;
+static uintptr_t page_mask = 0; /* msync works on whole pages */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+@brief Size taken in the data area by a record of a datagram
+*/
+static uint32_t record_size(int size);
+
+/**
+@brief Read the length field of a record
+*/
+static uint32_t read_len(uint32_t offset);
+
+static void write_len(uint32_t offset, uint32_t len);
+
+/**
+@brief Write the pages of a range of the file, from its offset in the file
+*/
+static void sync_range(uint32_t start, uint32_t len, int flags);
+
+/**
+@brief Move the head to the start of the data area if it is on a wrap marker
+*/
+static void skip_wrap(void);
+
+/**
+@brief Find room for a record at the tail, writing a wrap marker if needed
+@param offset pointer receiving the offset of the record in the data area
+@return true if there is room for the record
+*/
+static bool make_room(uint32_t rec_size, uint32_t * offset);
+
+/**
+@brief Count the records from the head to the tail
+@return number of records, -1 if the records do not lead from the head to the tail
+*/
+static int32_t count_records(void);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint32_t record_size(int size) {
+	return 4 + (((uint32_t)size + 3) & ~3u);
+}
+
+static uint32_t read_len(uint32_t offset) {
+	uint32_t len;
+
+	memcpy(&len, data + offset, 4);
+	return len;
+}
+
+static void write_len(uint32_t offset, uint32_t len) {
+	memcpy(data + offset, &len, 4);
+}
+
+static void sync_range(uint32_t start, uint32_t len, int flags) {
+	uintptr_t first = (uintptr_t)(map + start) & ~page_mask;
+	uintptr_t last = (uintptr_t)(map + start + len);
+
+	msync((void *)first, last - first, flags);
+}
+
+static void skip_wrap(void) {
+	if ((hdr->count > 0) && ((hdr->head >= hdr->data_size) || (read_len(hdr->head) == WRAP_MARK))) {
+		hdr->head = 0;
+	}
+}
+
+static bool make_room(uint32_t rec_size, uint32_t * offset) {
+	if (hdr->count == 0) {
+		hdr->head = 0;
+		hdr->tail = 0;
+		*offset = 0;
+		return true;
+	}
+	*offset = hdr->tail;
+	if (hdr->tail > hdr->head) {
+		if (hdr->data_size - hdr->tail >= rec_size) {
+			return true;
+		}
+		if (hdr->head <= rec_size) {
+			return false;
+		}
+		/* not enough room at the end of the data area, wrap (the marker is on file before the header moves the tail) */
+		if (hdr->tail < hdr->data_size) {
+			write_len(hdr->tail, WRAP_MARK);
+			sync_range(HEADER_SIZE + hdr->tail, 4, MS_SYNC);
+		}
+		*offset = 0;
+		return true;
+	}
+	return (hdr->head - hdr->tail > rec_size);
+}
+
+static int32_t count_records(void) {
+	uint32_t offset = hdr->head;
+	uint32_t len;
+	int32_t nb = 0;
+	bool wrapped = false;
+
+	while (offset != hdr->tail) {
+		if ((offset >= hdr->data_size) || (read_len(offset) == WRAP_MARK)) {
+			if (wrapped) {
+				return -1;
+			}
+			wrapped = true;
+			offset = 0;
+			continue;
+		}
+		len = read_len(offset);
+		if ((len == 0) || (len > hdr->data_size / 4) || (offset + record_size(len) > hdr->data_size)) {
+			return -1;
+		}
+		offset += record_size(len);
+		++nb;
+	}
+	return nb;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int spool_open(const char * path, uint32_t size) {
+	int fd;
+	struct stat st;
+	void * m;
+
+	if ((map != NULL) || (size < SPOOL_SIZE_MIN)) {
+		return SPOOL_ERROR;
+	}
+	page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+	size &= ~3u;
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1) {
+		return SPOOL_ERROR;
+	}
+	if ((fstat(fd, &st) != 0) || ((st.st_size != (off_t)(HEADER_SIZE + size)) && (ftruncate(fd, HEADER_SIZE + size) != 0))) {
+		close(fd);
+		return SPOOL_ERROR;
+	}
+	m = mmap(NULL, HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); /* the mapping keeps the file open */
+	if (m == MAP_FAILED) {
+		return SPOOL_ERROR;
+	}
+	map = (uint8_t *)m;
+	map_size = HEADER_SIZE + size;
+	hdr = (struct spool_hdr_s *)map;
+	data = map + HEADER_SIZE;
+
+	/* keep the content of a previous run only if it is consistent, the count is checked against the records */
+	if ((hdr->magic != SPOOL_MAGIC) || (hdr->version != SPOOL_VERSION) || (hdr->data_size != size) || (hdr->head >= size) || (hdr->tail > size) || (count_records() != (int32_t)hdr->count)) {
+		hdr->magic = SPOOL_MAGIC;
+		hdr->version = SPOOL_VERSION;
+		hdr->data_size = size;
+		hdr->head = 0;
+		hdr->tail = 0;
+		hdr->count = 0;
+		msync(map, HEADER_SIZE, MS_ASYNC);
+	}
+	return SPOOL_SUCCESS;
+}
+
+void spool_close(void) {
+	if (map == NULL) {
+		return;
+	}
+	msync(map, map_size, MS_SYNC);
+	munmap(map, map_size);
+	map = NULL;
+	hdr = NULL;
+	data = NULL;
+}
+
+int spool_push(const uint8_t * dgram, int size) {
+	uint32_t rec_size = record_size(size);
+	uint32_t offset;
+	int nb_lost = 0;
+
+	if ((map == NULL) || (size <= 0) || (rec_size > hdr->data_size / 4)) {
+		return SPOOL_ERROR;
+	}
+	while (!make_room(rec_size, &offset)) {
+		spool_pop(); /* queue full, discard the oldest datagram */
+		++nb_lost;
+	}
+	write_len(offset, (uint32_t)size);
+	memcpy(data + offset + 4, dgram, size);
+
+	/* the record is on file before the header counts it, then only the header is written */
+	sync_range(HEADER_SIZE + offset, rec_size, MS_SYNC);
+	hdr->tail = offset + rec_size;
+	hdr->count += 1;
+	sync_range(0, sizeof(struct spool_hdr_s), MS_ASYNC);
+	return nb_lost;
+}
+
+int spool_peek(uint8_t * dgram, int max_size) {
+	uint32_t len;
+
+	if ((map == NULL) || (hdr->count == 0)) {
+		return 0;
+	}
+	skip_wrap();
+	len = read_len(hdr->head);
+	if ((len == 0) || (hdr->head + record_size(len) > hdr->data_size)) {
+		hdr->count = 0; /* corrupted, start again from an empty queue */
+		hdr->head = 0;
+		hdr->tail = 0;
+		return 0;
+	}
+	if (len > (uint32_t)max_size) {
+		return SPOOL_ERROR;
+	}
+	memcpy(dgram, data + hdr->head + 4, len);
+	return (int)len;
+}
+
+void spool_pop(void) {
+	if ((map == NULL) || (hdr->count == 0)) {
+		return;
+	}
+	skip_wrap();
+	hdr->head += record_size(read_len(hdr->head));
+	hdr->count -= 1;
+	if ((hdr->count == 0) || (hdr->head > hdr->data_size)) {
+		hdr->count = 0; /* empty, or corrupted */
+		hdr->head = 0;
+		hdr->tail = 0;
+	}
+}
+
+uint32_t spool_count(void) {
+	return (map == NULL) ? 0 : hdr->count;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,248 @@
+/*
+  (C)2013 Semtech-Cycleo, decoding code moved from basic_pkt_fwd.c
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Decoding of the JSON "txpk" object carried by PULL_RESP datagrams
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* sscanf */
+#include <string.h>		/* memset, strcmp, strlen */
+
+#include "parson.h"
+#include "base64.h"
+#include "loragw_hal.h"
+#include "txpk_parse.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
+
+static const char * const status_names[TXPK_STATUS_NB] = {
+	[TXPK_OK]           = "no error",
+	[TXPK_ERR_JSON]     = "invalid JSON",
+	[TXPK_ERR_NO_TXPK]  = "no \"txpk\" object in JSON",
+	[TXPK_ERR_TX_MODE]  = "only \"immediate\" and \"timestamp\" modes supported",
+	[TXPK_ERR_NO_FREQ]  = "no mandatory \"txpk.freq\" object in JSON",
+	[TXPK_ERR_NO_RFCH]  = "no mandatory \"txpk.rfch\" object in JSON",
+	[TXPK_ERR_NO_MODU]  = "no mandatory \"txpk.modu\" object in JSON",
+	[TXPK_ERR_MODU]     = "invalid modulation in \"txpk.modu\"",
+	[TXPK_ERR_FSK]      = "FSK modulation not supported yet",
+	[TXPK_ERR_NO_DATR]  = "no mandatory \"txpk.datr\" object in JSON",
+	[TXPK_ERR_DATR]     = "format error in \"txpk.datr\"",
+	[TXPK_ERR_DATR_SF]  = "format error in \"txpk.datr\", invalid SF",
+	[TXPK_ERR_DATR_BW]  = "format error in \"txpk.datr\", invalid BW",
+	[TXPK_ERR_NO_CODR]  = "no mandatory \"txpk.codr\" object in JSON",
+	[TXPK_ERR_CODR]     = "format error in \"txpk.codr\"",
+	[TXPK_ERR_NO_SIZE]  = "no mandatory \"txpk.size\" object in JSON",
+	[TXPK_ERR_NO_DATA]  = "no mandatory \"txpk.data\" object in JSON"
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int txpk_parse_datr(const char * str, struct lgw_pkt_tx_s * txpkt) {
+	short x0, x1;
+
+	if (sscanf(str, "SF%2hdBW%3hd", &x0, &x1) != 2) {
+		return TXPK_ERR_DATR;
+	}
+	switch (x0) {
+		case  7: txpkt->datarate = DR_LORA_SF7;  break;
+		case  8: txpkt->datarate = DR_LORA_SF8;  break;
+		case  9: txpkt->datarate = DR_LORA_SF9;  break;
+		case 10: txpkt->datarate = DR_LORA_SF10; break;
+		case 11: txpkt->datarate = DR_LORA_SF11; break;
+		case 12: txpkt->datarate = DR_LORA_SF12; break;
+		default: return TXPK_ERR_DATR_SF;
+	}
+	switch (x1) {
+		case 125: txpkt->bandwidth = BW_125KHZ; break;
+		case 250: txpkt->bandwidth = BW_250KHZ; break;
+		case 500: txpkt->bandwidth = BW_500KHZ; break;
+		default: return TXPK_ERR_DATR_BW;
+	}
+	return TXPK_OK;
+}
+
+int txpk_parse_codr(const char * str, uint8_t * coderate) {
+	if      (strcmp(str, "4/5") == 0) *coderate = CR_LORA_4_5;
+	else if (strcmp(str, "4/6") == 0) *coderate = CR_LORA_4_6;
+	else if (strcmp(str, "2/3") == 0) *coderate = CR_LORA_4_6;
+	else if (strcmp(str, "4/7") == 0) *coderate = CR_LORA_4_7;
+	else if (strcmp(str, "4/8") == 0) *coderate = CR_LORA_4_8;
+	else if (strcmp(str, "1/2") == 0) *coderate = CR_LORA_4_8;
+	else return TXPK_ERR_CODR;
+	return TXPK_OK;
+}
+
+int txpk_parse_obj(const JSON_Object * txpk_obj, struct lgw_pkt_tx_s * txpkt, int * data_size) {
+	int i;
+	int status;
+	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
+	const char *str; /* pointer to sub-strings in the JSON data */
+
+	memset(txpkt, 0, sizeof *txpkt);
+
+	/* Parse "immediate" tag, or target timestamp (mandatory) */
+	i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
+	if (i == 1) {
+		/* TX procedure: send immediately */
+		txpkt->tx_mode = IMMEDIATE;
+	} else {
+		val = json_object_get_value(txpk_obj,"tmst");
+		if (val == NULL) {
+			return TXPK_ERR_TX_MODE;
+		}
+		/* TX procedure: send on timestamp value */
+		txpkt->tx_mode = TIMESTAMPED;
+		txpkt->count_us = (uint32_t)json_value_get_number(val);
+	}
+
+	/* Parse "No CRC" flag (optional field) */
+	val = json_object_get_value(txpk_obj,"ncrc");
+	if (val != NULL) {
+		txpkt->no_crc = (bool)json_value_get_boolean(val);
+	}
+
+	/* parse target frequency (mandatory) */
+	val = json_object_get_value(txpk_obj,"freq");
+	if (val == NULL) {
+		return TXPK_ERR_NO_FREQ;
+	}
+	txpkt->freq_hz = (uint32_t)(1e6 * json_value_get_number(val));
+
+	/* parse RF chain used for TX (mandatory) */
+	val = json_object_get_value(txpk_obj,"rfch");
+	if (val == NULL) {
+		return TXPK_ERR_NO_RFCH;
+	}
+	txpkt->rf_chain = (uint8_t)json_value_get_number(val);
+
+	/* parse TX power (optional field) */
+	val = json_object_get_value(txpk_obj,"powe");
+	if (val != NULL) {
+		txpkt->rf_power = (int8_t)json_value_get_number(val);
+	}
+
+	/* Parse modulation (mandatory) */
+	str = json_object_get_string(txpk_obj, "modu");
+	if (str == NULL) {
+		return TXPK_ERR_NO_MODU;
+	}
+	if (strcmp(str, "LORA") == 0) {
+		/* Lora modulation */
+		txpkt->modulation = MOD_LORA;
+
+		/* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
+		str = json_object_get_string(txpk_obj, "datr");
+		if (str == NULL) {
+			return TXPK_ERR_NO_DATR;
+		}
+		status = txpk_parse_datr(str, txpkt);
+		if (status != TXPK_OK) {
+			return status;
+		}
+
+		/* Parse ECC coding rate (mandatory) */
+		str = json_object_get_string(txpk_obj, "codr");
+		if (str == NULL) {
+			return TXPK_ERR_NO_CODR;
+		}
+		status = txpk_parse_codr(str, &txpkt->coderate);
+		if (status != TXPK_OK) {
+			return status;
+		}
+
+		/* Parse signal polarity switch (optional field) */
+		val = json_object_get_value(txpk_obj,"ipol");
+		if (val != NULL) {
+			txpkt->invert_pol = (bool)json_value_get_boolean(val);
+		}
+
+		/* parse Lora preamble length (optional field, optimum min value enforced) */
+		val = json_object_get_value(txpk_obj,"prea");
+		if (val != NULL) {
+			i = (int)json_value_get_number(val);
+			if (i >= MIN_LORA_PREAMB) {
+				txpkt->preamble = (uint16_t)i;
+			} else {
+				txpkt->preamble = (uint16_t)MIN_LORA_PREAMB;
+			}
+		} else {
+			txpkt->preamble = (uint16_t)MIN_LORA_PREAMB;
+		}
+
+	} else if (strcmp(str, "FSK") == 0) {
+		/* FSK modulation */
+		txpkt->modulation = MOD_FSK;
+
+		// TODO
+		return TXPK_ERR_FSK;
+
+	} else {
+		return TXPK_ERR_MODU;
+	}
+
+	/* Parse payload length (mandatory) */
+	val = json_object_get_value(txpk_obj,"size");
+	if (val == NULL) {
+		return TXPK_ERR_NO_SIZE;
+	}
+	txpkt->size = (uint16_t)json_value_get_number(val);
+
+	/* Parse payload data (mandatory) */
+	str = json_object_get_string(txpk_obj, "data");
+	if (str == NULL) {
+		return TXPK_ERR_NO_DATA;
+	}
+	*data_size = b64_to_bin(str, strlen(str), txpkt->payload, sizeof txpkt->payload);
+
+	return TXPK_OK;
+}
+
+int txpk_parse(const char * json, struct lgw_pkt_tx_s * txpkt, int * data_size) {
+	JSON_Value *root_val = NULL;
+	JSON_Object *txpk_obj = NULL;
+	int status;
+
+	/* try to parse JSON */
+	root_val = json_parse_string_with_comments(json);
+	if (root_val == NULL) {
+		return TXPK_ERR_JSON;
+	}
+
+	/* look for JSON sub-object 'txpk' */
+	txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
+	if (txpk_obj == NULL) {
+		status = TXPK_ERR_NO_TXPK;
+	} else {
+		status = txpk_parse_obj(txpk_obj, txpkt, data_size);
+	}
+
+	/* free the JSON parse tree from memory */
+	json_value_free(root_val);
+	return status;
+}
+
+const char * txpk_strerror(int status) {
+	if ((status < 0) || (status >= (int)ARRAY_SIZE(status_names))) {
+		return "unknown error";
+	}
+	return status_names[status];
+}
+
+/* --- EOF ------------------------------------------------------------------ */
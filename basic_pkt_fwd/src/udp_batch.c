@@ -0,0 +1,121 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Batched UDP send and receive, one sendmmsg/recvmmsg system call for
+	several datagrams when the C library and the kernel support it
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* sendmmsg and recvmmsg are GNU extensions */
+#define _GNU_SOURCE
+
+#include <stdbool.h>	/* bool type */
+#include <stddef.h>		/* NULL */
+#include <errno.h>		/* errno, ENOSYS */
+#include <sys/socket.h>	/* sendmsg, recvmsg, sendmmsg, recvmmsg */
+
+#include "udp_batch.h"
+
+/* recvmmsg appeared in glibc 2.12 (Linux 2.6.33), sendmmsg in glibc 2.14 (Linux 3.0) */
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+	#if __GLIBC_PREREQ(2, 12)
+		#define HAVE_RECVMMSG
+	#endif
+	#if __GLIBC_PREREQ(2, 14)
+		#define HAVE_SENDMMSG
+	#endif
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
+
+/* cleared the first time the kernel reports it does not implement the call */
+#ifdef HAVE_SENDMMSG
+static bool use_sendmmsg = true;
+#endif
+#ifdef HAVE_RECVMMSG
+static bool use_recvmmsg = true;
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int udp_send_batch(int sock, struct msghdr * msgs, int nb, int flags, unsigned * syscalls) {
+	int i = 0;
+	int sent = 0;
+#ifdef HAVE_SENDMMSG
+	int j, k;
+	struct mmsghdr mm[UDP_BATCH_MAX];
+
+	while (use_sendmmsg && (i < nb)) {
+		k = (nb - i > UDP_BATCH_MAX) ? UDP_BATCH_MAX : nb - i;
+		for (j = 0; j < k; ++j) {
+			mm[j].msg_hdr = msgs[i + j];
+		}
+		j = sendmmsg(sock, mm, k, flags);
+		*syscalls += 1;
+		if ((j == -1) && (errno == ENOSYS)) {
+			use_sendmmsg = false;
+			break;
+		} else if (j == -1) {
+			i += 1; /* skip the datagram that failed */
+		} else {
+			sent += j;
+			i += (j < k) ? j + 1 : j; /* stopped on a failed datagram, skip it */
+		}
+	}
+#endif
+	for (; i < nb; ++i) {
+		if (sendmsg(sock, &msgs[i], flags) != -1) {
+			sent += 1;
+		}
+		*syscalls += 1;
+	}
+	return sent;
+}
+
+int udp_recv_batch(int sock, struct msghdr * msgs, int * lens, int nb, unsigned * syscalls) {
+	int i;
+#ifdef HAVE_RECVMMSG
+	int j;
+	struct mmsghdr mm[UDP_BATCH_MAX];
+
+	if (nb > UDP_BATCH_MAX) {
+		nb = UDP_BATCH_MAX;
+	}
+	if (use_recvmmsg) {
+		for (j = 0; j < nb; ++j) {
+			mm[j].msg_hdr = msgs[j];
+		}
+		i = recvmmsg(sock, mm, nb, MSG_DONTWAIT, NULL);
+		*syscalls += 1;
+		if (i >= 0) {
+			for (j = 0; j < i; ++j) {
+				msgs[j] = mm[j].msg_hdr;
+				lens[j] = (int)mm[j].msg_len;
+			}
+			return i;
+		} else if (errno != ENOSYS) {
+			return 0; /* nothing to read, or pending socket error */
+		}
+		use_recvmmsg = false;
+	}
+#endif
+	for (i = 0; i < nb; ++i) {
+		lens[i] = recvmsg(sock, &msgs[i], MSG_DONTWAIT);
+		*syscalls += 1;
+		if (lens[i] == -1) {
+			break;
+		}
+	}
+	return i;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,59 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	ISO 8601 UTC timestamps of the "time" fields, with microseconds
+
+	The date and time down to the second are formatted once per second and
+	kept in a cache, so most timestamps only need their 6 microsecond digits
+	written. Each cache belongs to one thread (no shared state, no gmtime
+	static buffer).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _TIMESTAMP_H
+#define _TIMESTAMP_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <time.h>		/* time_t, timespec */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define TIMESTAMP_SIZE	27 /* "YYYY-MM-DDThh:mm:ss.uuuuuuZ" */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct timestamp_s {
+	time_t sec; /* second of the cached prefix */
+	int len; /* size of the prefix, 0 = empty cache */
+	char prefix[32]; /* "YYYY-MM-DDThh:mm:ss." */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty a timestamp cache
+@param ts pointer to the cache
+*/
+void timestamp_init(struct timestamp_s * ts);
+
+/**
+@brief Format a UTC time as "YYYY-MM-DDThh:mm:ss.uuuuuuZ"
+@param ts pointer to the cache, only used by the calling thread
+@param t UTC time, the nanoseconds are truncated to microseconds
+@param buff buffer receiving the string, null terminated (TIMESTAMP_SIZE + 1 bytes)
+@return size of the string (TIMESTAMP_SIZE for years 0 to 9999, the string is truncated when larger), -1 if the time cannot be converted
+*/
+int timestamp_format(struct timestamp_s * ts, const struct timespec * t, char * buff);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
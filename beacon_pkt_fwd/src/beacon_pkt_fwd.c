@@ -37,7 +37,6 @@ Maintainer: Sylvain Miermont
 #include <unistd.h>		/* getopt, access */
 #include <stdlib.h>		/* atoi, exit */
 #include <errno.h>		/* error messages */
-#include <math.h>		/* modf */
 
 #include <sys/socket.h> /* socket specific definitions */
 #include <netinet/in.h> /* INET constants and stuff */
@@ -48,6 +47,8 @@ Maintainer: Sylvain Miermont
 
 #include "parson.h"
 #include "base64.h"
+#include "timestamp.h"
+#include "time_ref.h"
 #include "loragw_hal.h"
 #include "loragw_gps.h"
 #include "loragw_aux.h"
@@ -90,7 +91,17 @@ Maintainer: Sylvain Miermont
 #define PKT_PULL_RESP	3
 #define PKT_PULL_ACK	4
 
-#define	NB_PKT_MAX		8 /* max number of packets per fetch/send cycle */
+#ifdef LGW_PKT_FIFO_SIZE
+	#define NB_PKT_MAX	LGW_PKT_FIFO_SIZE /* max number of packets per fetch/send cycle: the whole concentrator FIFO */
+#else
+	#define NB_PKT_MAX	16
+#endif
+#define DEFAULT_FETCH_BATCH	8 /* default number of packets per fetch */
+#define FETCH_BATCH_MIN	2 /* smallest batch in adaptive mode */
+
+#define STATUS_SIZE		200 /* max size of the status report JSON object */
+#define RXPK_MAX_SIZE	600 /* max size of the JSON object of one packet (255-byte payload) */
+#define UP_BUFF_SIZE	(12 + 9 + (NB_PKT_MAX * (RXPK_MAX_SIZE + 1)) + 1 + STATUS_SIZE + 3) /* max size of an upstream datagram */
 
 #define MIN_LORA_PREAMB	6 /* minimum Lora preamble length for this application */
 
@@ -116,6 +127,10 @@ static int keepalive_time = DEFAULT_KEEPALIVE; /* send a PULL_DATA request every
 /* statistics collection configuration variables */
 static unsigned stat_interval = DEFAULT_STAT; /* time interval (in sec) at which statistics are collected and displayed */
 
+/* packet fetch configuration variables */
+static bool fetch_adaptive = false; /* size each fetch from the recent FIFO occupancy */
+static volatile unsigned fetch_batch = DEFAULT_FETCH_BATCH; /* max number of packets per fetch, updated by thread_up in adaptive mode */
+
 /* gateway <-> MAC protocol variables */
 static uint32_t net_mac_h; /* Most Significant Nibble, network order */
 static uint32_t net_mac_l; /* Least Significant Nibble, network order */
@@ -178,7 +193,7 @@ static struct coord_s meas_gps_err; /* GPS position of the gateway */
 
 static pthread_mutex_t mx_stat_rep = PTHREAD_MUTEX_INITIALIZER; /* control access to the status report */
 static bool report_ready = false; /* true when there is a new report to send to the server */
-static char status_report[200]; /* status report as a JSON object */
+static char status_report[STATUS_SIZE]; /* status report as a JSON object */
 
 /* beacon parameters */
 static uint32_t beacon_period = 1; /* set beaconing period, must be a sub-multiple of 86400 (nb of sec in a day) */
@@ -197,6 +212,8 @@ int parse_gateway_configuration(const char * conf_file);
 
 uint16_t crc_ccit(const uint8_t * data, unsigned size);
 
+static unsigned fetch_batch_adapt(unsigned batch, int nb_pkt, unsigned * occupancy);
+
 /* threads */
 void thread_up(void);
 void thread_down(void);
@@ -455,6 +472,25 @@ int parse_gateway_configuration(const char * conf_file) {
 		MSG("INFO: upstream PUSH_DATA time-out is configured to %u ms\n", (unsigned)(push_timeout_half.tv_usec / 500));
 	}
 	
+	/* get the number of packets per fetch (optional), a number or "auto" */
+	val = json_object_get_value(conf_obj, "fetch_batch_size");
+	if (json_value_get_type(val) == JSONString) {
+		if (strcmp(json_value_get_string(val), "auto") == 0) {
+			fetch_adaptive = true;
+			MSG("INFO: packets per fetch will follow the FIFO occupancy (%u max)\n", NB_PKT_MAX);
+		} else {
+			MSG("WARNING: invalid fetch_batch_size \"%s\", using %u\n", json_value_get_string(val), fetch_batch);
+		}
+	} else if (val != NULL) {
+		fetch_batch = (unsigned)json_value_get_number(val);
+		if (fetch_batch < 1) {
+			fetch_batch = 1;
+		} else if (fetch_batch > NB_PKT_MAX) {
+			fetch_batch = NB_PKT_MAX;
+		}
+		MSG("INFO: packets per fetch is configured to %u\n", fetch_batch);
+	}
+	
 	/* packet filtering parameters */
 	val = json_object_get_value(conf_obj, "forward_crc_valid");
 	if (json_value_get_type(val) == JSONBoolean) {
@@ -553,6 +589,33 @@ uint16_t crc_ccit(const uint8_t * data, unsigned size) {
 	return x;
 }
 
+/* size of the next fetch: doubled when the last one filled the batch, then back towards twice the average FIFO occupancy, one packet per fetch */
+static unsigned fetch_batch_adapt(unsigned batch, int nb_pkt, unsigned * occupancy) {
+	unsigned target;
+	
+	/* an empty FIFO says nothing about the size of the next burst */
+	if (nb_pkt <= 0) {
+		return batch;
+	}
+	
+	/* moving average of the packets per fetch, in 1/16 packet, weight 1/8 */
+	*occupancy = *occupancy - (*occupancy / 8) + (2 * (unsigned)nb_pkt);
+	if ((unsigned)nb_pkt >= batch) {
+		target = 2 * batch;
+	} else {
+		target = (*occupancy + 7) / 8; /* twice the average, rounded up */
+		if (target < batch) {
+			target = batch - 1;
+		}
+	}
+	if (target < FETCH_BATCH_MIN) {
+		target = FETCH_BATCH_MIN;
+	} else if (target > NB_PKT_MAX) {
+		target = NB_PKT_MAX;
+	}
+	return target;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
 
@@ -873,6 +936,7 @@ int main(void)
 		printf("# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
 		printf("# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
 		printf("# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
+		printf("# packets per fetch: %u%s\n", fetch_batch, (fetch_adaptive ? " max (adaptive)" : " max"));
 		printf("# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
 		printf("# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
 		printf("### [DOWNSTREAM] ###\n");
@@ -946,13 +1010,15 @@ void thread_up(void) {
 	struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
 	struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
 	int nb_pkt;
+	unsigned occupancy = 0; /* average packets per fetch (adaptive batch) */
 	
 	/* local copy of GPS time reference */
 	bool ref_ok = false; /* determine if GPS time reference must be used or not */
 	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
+	struct time_ref_s fetch_ref; /* same, precomputed for the conversion of the fetch */
 	
 	/* data buffers */
-	uint8_t buff_up[5000]; /* buffer to compose the upstream packet */
+	uint8_t buff_up[UP_BUFF_SIZE]; /* buffer to compose the upstream packet */
 	int buff_index;
 	uint8_t buff_ack[32]; /* buffer to receive acknowledges */
 	
@@ -961,8 +1027,9 @@ void thread_up(void) {
 	uint8_t token_l; /* random token for acknowledgement matching */
 	
 	/* GPS synchronization variables */
-	struct timespec pkt_utc_time;
-	struct tm * x; /* broken-up UTC time */
+	uint32_t pkt_count_us[NB_PKT_MAX]; /* timestamps of the fetch */
+	struct timespec pkt_utc_time[NB_PKT_MAX]; /* same, converted to UTC time */
+	struct timestamp_s pkt_ts; /* date and time of the last second formatted */
 	
 	/* report management variable */
 	bool send_report = false;
@@ -974,6 +1041,8 @@ void thread_up(void) {
 		exit(EXIT_FAILURE);
 	}
 	
+	timestamp_init(&pkt_ts);
+	
 	/* pre-fill the data buffer with fixed fields */
 	buff_up[0] = PROTOCOL_VERSION;
 	buff_up[3] = PKT_PUSH_DATA;
@@ -984,12 +1053,15 @@ void thread_up(void) {
 	
 		/* fetch packets */
 		pthread_mutex_lock(&mx_concent);
-		nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
+		nb_pkt = lgw_receive(fetch_batch, rxpkt);
 		pthread_mutex_unlock(&mx_concent);
 		if (nb_pkt == LGW_HAL_ERROR) {
 			MSG("ERROR: [up] failed packet fetch, exiting\n");
 			exit(EXIT_FAILURE);
 		} 
+		if (fetch_adaptive) {
+			fetch_batch = fetch_batch_adapt(fetch_batch, nb_pkt, &occupancy);
+		}
 		
 		/* check if there are status report to send */
 		send_report = report_ready; /* copy the variable so it doesn't change mid-function */
@@ -1011,6 +1083,17 @@ void thread_up(void) {
 			ref_ok = false;
 		}
 		
+		/* convert the timestamps of the whole fetch to UTC time at once, with integer operations */
+		if (ref_ok == true) {
+			ref_ok = time_ref_init(&fetch_ref, &local_ref);
+		}
+		if (ref_ok == true) {
+			for (i=0; i < nb_pkt; ++i) {
+				pkt_count_us[i] = rxpkt[i].count_us;
+			}
+			time_ref_cnt2utc(&fetch_ref, pkt_count_us, pkt_utc_time, nb_pkt);
+		}
+		
 		/* start composing datagram with the header */
 		token_h = (uint8_t)rand(); /* random token */
 		token_l = (uint8_t)rand(); /* random token */
@@ -1083,18 +1166,15 @@ void thread_up(void) {
 			
 			/* Packet RX time (GPS based) */
 			if (ref_ok == true) {
-				/* convert packet timestamp to UTC absolute time */
-				j = lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time);
-				if (j == LGW_GPS_SUCCESS) {
-					/* split the UNIX timestamp to its calendar components */
-					x = gmtime(&(pkt_utc_time.tv_sec));
-					j = snprintf((char *)(buff_up + buff_index), 38, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (pkt_utc_time.tv_nsec)/1000); /* ISO 8601 format */
-					if ((j>=0) && (j < 38)) {
-						buff_index += j;
-					} else {
-						MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-						exit(EXIT_FAILURE);
-					}
+				/* ISO 8601 format, the date and time are only converted when the second changes */
+				memcpy((void *)(buff_up + buff_index), (void *)",\"time\":\"", 9);
+				j = timestamp_format(&pkt_ts, &pkt_utc_time[i], (char *)(buff_up + buff_index + 9));
+				if (j == TIMESTAMP_SIZE) {
+					buff_up[buff_index + 9 + j] = '"';
+					buff_index += 9 + j + 1;
+				} else {
+					MSG("ERROR: [up] timestamp_format returned %d, expected %d\n", j, TIMESTAMP_SIZE);
+					exit(EXIT_FAILURE);
 				}
 			}
 			
@@ -1363,12 +1443,10 @@ void thread_down(void) {
 	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
 	const char *str; /* pointer to sub-strings in the JSON data */
 	short x0, x1;
-	short x2, x3, x4;
-	double x5, x6;
 	
 	/* variables to send on UTC timestamp */
 	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
-	struct tm utc_vector; /* for collecting the elements of the UTC time */
+	struct time_ref_s tx_ref; /* same, precomputed for the conversion */
 	struct timespec utc_tx; /* UTC time that needs to be converted to timestamp */
 	
 	/* beacon variables */
@@ -1629,25 +1707,15 @@ void thread_down(void) {
 						continue;
 					}
 					
-					i = sscanf (str, "%4hd-%2hd-%2hdT%2hd:%2hd:%9lf", &x0, &x1, &x2, &x3, &x4, &x5);
-					if (i != 6 ) {
+					/* RFC 3339 time, converted with integer arithmetic only (no mktime, independent of the timezone of the host) */
+					if (time_ref_parse(str, &utc_tx) == false) {
 						MSG("WARNING: [down] \"txpk.time\" must follow ISO 8601 format, TX aborted\n");
 						json_value_free(root_val);
 						continue;
 					}
-					x5 = modf(x5, &x6); /* x6 get the integer part of x5, x5 the fractional part */
-					utc_vector.tm_year = x0 - 1900; /* years since 1900 */
-					utc_vector.tm_mon = x1 - 1; /* months since January */
-					utc_vector.tm_mday = x2; /* day of the month 1-31 */
-					utc_vector.tm_hour = x3; /* hours since midnight */
-					utc_vector.tm_min = x4; /* minutes after the hour */
-					utc_vector.tm_sec = (int)x6;
-					utc_tx.tv_sec = mktime(&utc_vector) - timezone;
-					utc_tx.tv_nsec = (long)(1e9 * x5);
 					
 					/* transform UTC time to timestamp */
-					i = lgw_utc2cnt(local_ref, utc_tx, &(txpkt.count_us));
-					if (i != LGW_GPS_SUCCESS) {
+					if ((time_ref_init(&tx_ref, &local_ref) == false) || (time_ref_utc2cnt(&tx_ref, &utc_tx, &(txpkt.count_us)) == false)) {
 						MSG("WARNING: [down] could not convert UTC time to timestamp, TX aborted\n");
 						json_value_free(root_val);
 						continue;
@@ -0,0 +1,68 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	ISO 8601 UTC timestamps of the "time" fields, with microseconds
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>		/* snprintf */
+#include <string.h>		/* memcpy */
+
+#include "timestamp.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void timestamp_init(struct timestamp_s * ts) {
+	ts->sec = 0;
+	ts->len = 0;
+}
+
+int timestamp_format(struct timestamp_s * ts, const struct timespec * t, char * buff) {
+	struct tm x;
+	long usec = t->tv_nsec / 1000;
+	int i;
+
+	/* normalized time: the date and time are formatted once per second, then only the microseconds change */
+	if ((usec >= 0) && (usec <= 999999)) {
+		if ((ts->len == 0) || (ts->sec != t->tv_sec)) {
+			if (gmtime_r(&(t->tv_sec), &x) == NULL) {
+				return -1;
+			}
+			ts->len = snprintf(ts->prefix, sizeof ts->prefix, "%04i-%02i-%02iT%02i:%02i:%02i.", x.tm_year+1900, x.tm_mon+1, x.tm_mday, x.tm_hour, x.tm_min, x.tm_sec);
+			ts->sec = t->tv_sec;
+		}
+		if (ts->len == TIMESTAMP_SIZE - 7) {
+			memcpy(buff, ts->prefix, ts->len);
+			for (i = ts->len + 5; i >= ts->len; --i) {
+				buff[i] = '0' + (usec % 10);
+				usec /= 10;
+			}
+			buff[TIMESTAMP_SIZE - 1] = 'Z';
+			buff[TIMESTAMP_SIZE] = 0;
+			return TIMESTAMP_SIZE;
+		}
+	}
+
+	/* year out of 0-9999 or time not normalized: same output as a single snprintf (truncated) */
+	if (gmtime_r(&(t->tv_sec), &x) == NULL) {
+		return -1;
+	}
+	return snprintf(buff, TIMESTAMP_SIZE + 1, "%04i-%02i-%02iT%02i:%02i:%02i.%06liZ", x.tm_year+1900, x.tm_mon+1, x.tm_mday, x.tm_hour, x.tm_min, x.tm_sec, t->tv_nsec / 1000);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
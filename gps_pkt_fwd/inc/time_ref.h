@@ -0,0 +1,85 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Fixed-point conversions between concentrator timestamps and UTC time, with
+	a GPS time reference, and parsing of RFC 3339 UTC times
+
+	The crystal error of the reference is turned once into integer
+	corrections, so converting the timestamps of a whole fetch only takes
+	integer operations, in a single loop without branches on the data.
+	Results are the same as lgw_cnt2utc within 2 ns, and as lgw_utc2cnt
+	within 1 us.
+
+	Dates are converted with arithmetic only (days from the civil calendar),
+	without mktime, the TZ database or the timezone of the host.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+#ifndef _TIME_REF_H
+#define _TIME_REF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <time.h>		/* time_t, timespec */
+
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* time reference, precomputed for integer conversions */
+struct time_ref_s {
+	uint32_t count_us; /* concentrator counter at the reference */
+	time_t sec; /* UTC time at the reference, seconds */
+	int32_t nsec; /* UTC time at the reference, nanoseconds */
+	int32_t drift_q32; /* (1000 / xtal_err - 1000) ns per counter microsecond, Q32 */
+	int32_t skew_q32; /* (1000 * xtal_err - 1000) ns per UTC microsecond, Q32 */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Precompute the integer conversion factors of a time reference
+@param tr pointer to the precomputed reference
+@param ref GPS time reference, as updated by lgw_gps_sync
+@return false if the reference is not usable (same checks as lgw_cnt2utc)
+*/
+bool time_ref_init(struct time_ref_s * tr, const struct tref * ref);
+
+/**
+@brief Convert concentrator timestamps to UTC time
+@param tr pointer to the precomputed reference
+@param count_us array of concentrator timestamps, taken as later than the reference (32-bit counter wrap)
+@param utc array receiving the UTC times, same size
+@param nb number of timestamps to convert
+*/
+void time_ref_cnt2utc(const struct time_ref_s * tr, const uint32_t * count_us, struct timespec * utc, int nb);
+
+/**
+@brief Convert a UTC time to a concentrator timestamp
+@param tr pointer to the precomputed reference
+@param utc UTC time, normalized
+@param count_us pointer receiving the concentrator timestamp
+@return false if the time is more than one counter period (71 minutes) away from the reference
+*/
+bool time_ref_utc2cnt(const struct time_ref_s * tr, const struct timespec * utc, uint32_t * count_us);
+
+/**
+@brief Parse a RFC 3339 date and time, "YYYY-MM-DDThh:mm:ss[.f...](Z|+hh:mm|-hh:mm)"
+@param str null terminated string, without time offset the time is taken as UTC
+@param utc pointer receiving the UTC time, fractions of second are truncated to nanoseconds
+@return false if the string is not a valid date and time, or not representable as a time_t
+*/
+bool time_ref_parse(const char * str, struct timespec * utc);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
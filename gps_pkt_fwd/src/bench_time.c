@@ -0,0 +1,234 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Check and benchmark of the fixed-point time conversions against the HAL:
+	time_ref_cnt2utc versus lgw_cnt2utc, time_ref_utc2cnt versus lgw_utc2cnt,
+	and the round trip from timestamp to UTC time and back, on random GPS time
+	references
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+#include <stdio.h>		/* printf, fprintf */
+#include <stdlib.h>		/* atoi, rand, srand */
+#include <time.h>		/* clock_gettime, timespec */
+#include <unistd.h>		/* getopt */
+
+#include "loragw_gps.h"
+#include "time_ref.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_TS			16 /* timestamps per reference, one full fetch */
+#define DEFAULT_ITER	100000 /* default number of random references */
+#define DELTA_MAX		4200000000U /* us, below one counter period at +10 ppm */
+#define ERR_MAX_NS		1000 /* the conversions must agree within 1 us */
+#define ERR_MAX_US		1 /* same, in counter microseconds */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+	MSG("Usage: bench_time [-n references] [-s seed]\n");
+	MSG("  converts %i timestamps with each random GPS time reference, default %i references\n", NB_TS, DEFAULT_ITER);
+}
+
+static double elapsed_ns(const struct timespec * start, const struct timespec * stop) {
+	return 1e9 * (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec);
+}
+
+static uint32_t rand32(void) {
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* a reference as lgw_gps_sync leaves it, the crystal error often at the limits */
+static void rand_ref(struct tref * ref) {
+	int i;
+
+	ref->systime = time(NULL);
+	ref->count_us = rand32();
+	ref->utc.tv_sec = 1400000000 + (time_t)(rand32() % 700000000); /* 2014 to 2036 */
+	ref->utc.tv_nsec = rand32() % 1000000000;
+	i = rand() % 4;
+	if (i == 0) {
+		ref->xtal_err = 0.99999;
+	} else if (i == 1) {
+		ref->xtal_err = 1.00001;
+	} else {
+		ref->xtal_err = 0.99999 + 0.00002 * ((double)rand() / RAND_MAX);
+	}
+}
+
+/* signed difference a - b of two timestamps, modulo 2^32 */
+static int32_t diff_us(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b);
+}
+
+/* signed difference a - b, nanoseconds */
+static int64_t diff_ns(const struct timespec * a, const struct timespec * b) {
+	return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000 + (a->tv_nsec - b->tv_nsec);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+	int i, n;
+	int iter = DEFAULT_ITER;
+	unsigned seed = 1;
+	struct tref ref;
+	struct time_ref_s tr;
+	uint32_t count_us[NB_TS];
+	struct timespec utc[NB_TS];
+	struct timespec hal_utc[NB_TS];
+	struct timespec tx_utc[NB_TS];
+	uint32_t tx_count_us[NB_TS];
+	uint32_t hal_count_us[NB_TS];
+	uint32_t back_count_us[NB_TS];
+	struct timespec t0, t1;
+	double t_fix = 0, t_hal = 0;
+	double t_tx_fix = 0, t_tx_hal = 0;
+	int64_t d, d_max = 0;
+	int32_t u, u_max = 0, rt_max = 0;
+	long nb_err = 0;
+	long nb_tx_err = 0;
+	long nb_rt_err = 0;
+	long nb_hal_err = 0;
+
+	while ((i = getopt(argc, argv, "hn:s:")) != -1) {
+		switch (i) {
+			case 'n':
+				iter = atoi(optarg);
+				if (iter < 1) {
+					usage();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				seed = (unsigned)atoi(optarg);
+				break;
+			default:
+				usage();
+				return (i == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	srand(seed);
+
+	for (n = 0; n < iter; ++n) {
+		rand_ref(&ref);
+		if (time_ref_init(&tr, &ref) == false) {
+			MSG("ERROR: reference rejected, xtal_err %.7f\n", ref.xtal_err);
+			return EXIT_FAILURE;
+		}
+		/* later than the reference, some after the 32-bit counter wraps */
+		for (i = 0; i < NB_TS; ++i) {
+			count_us[i] = ref.count_us + ((i == 0) ? 0 : (rand32() % DELTA_MAX));
+		}
+		/* downlink times, any nanosecond (the HAL converts negative delays to unsigned, undefined) */
+		for (i = 0; i < NB_TS; ++i) {
+			u = rand32() % (DELTA_MAX / 1000000);
+			tx_utc[i].tv_sec = ref.utc.tv_sec + u;
+			tx_utc[i].tv_nsec = rand32() % 1000000000;
+			if ((u == 0) && (tx_utc[i].tv_nsec < ref.utc.tv_nsec)) {
+				tx_utc[i].tv_nsec = ref.utc.tv_nsec;
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		time_ref_cnt2utc(&tr, count_us, utc, NB_TS);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_fix += elapsed_ns(&t0, &t1);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < NB_TS; ++i) {
+			if (lgw_cnt2utc(ref, count_us[i], &hal_utc[i]) != LGW_GPS_SUCCESS) {
+				++nb_hal_err;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_hal += elapsed_ns(&t0, &t1);
+
+		for (i = 0; i < NB_TS; ++i) {
+			d = diff_ns(&utc[i], &hal_utc[i]);
+			d = (d < 0) ? -d : d;
+			d_max = (d > d_max) ? d : d_max;
+			if ((d >= ERR_MAX_NS) || (utc[i].tv_nsec < 0) || (utc[i].tv_nsec >= 1000000000)) {
+				++nb_err;
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < NB_TS; ++i) {
+			if (time_ref_utc2cnt(&tr, &tx_utc[i], &tx_count_us[i]) == false) {
+				++nb_tx_err;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_tx_fix += elapsed_ns(&t0, &t1);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < NB_TS; ++i) {
+			if (lgw_utc2cnt(ref, tx_utc[i], &hal_count_us[i]) != LGW_GPS_SUCCESS) {
+				++nb_hal_err;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		t_tx_hal += elapsed_ns(&t0, &t1);
+
+		for (i = 0; i < NB_TS; ++i) {
+			u = diff_us(tx_count_us[i], hal_count_us[i]);
+			u = (u < 0) ? -u : u;
+			u_max = (u > u_max) ? u : u_max;
+			if (u > ERR_MAX_US) {
+				++nb_tx_err;
+			}
+		}
+
+		/* round trip, the UTC times of the uplinks converted back to timestamps */
+		for (i = 0; i < NB_TS; ++i) {
+			if (time_ref_utc2cnt(&tr, &utc[i], &back_count_us[i]) == false) {
+				++nb_rt_err;
+				continue;
+			}
+			u = diff_us(back_count_us[i], count_us[i]);
+			u = (u < 0) ? -u : u;
+			rt_max = (u > rt_max) ? u : rt_max;
+			if (u > ERR_MAX_US) {
+				++nb_rt_err;
+			}
+		}
+	}
+
+	printf("##### time_ref versus HAL, %i references, %i timestamps each, seed %u #####\n", iter, NB_TS, seed);
+	printf("# cnt2utc: max difference %lli ns, %li over %i ns, %li HAL errors\n", (long long)d_max, nb_err, ERR_MAX_NS, nb_hal_err);
+	printf("# cnt2utc: time_ref %.1f ns per timestamp, HAL %.1f ns per timestamp\n", t_fix / ((double)iter * NB_TS), t_hal / ((double)iter * NB_TS));
+	printf("# utc2cnt: max difference %i us, %li over %i us or rejected\n", u_max, nb_tx_err, ERR_MAX_US);
+	printf("# utc2cnt: time_ref %.1f ns per time, HAL %.1f ns per time\n", t_tx_fix / ((double)iter * NB_TS), t_tx_hal / ((double)iter * NB_TS));
+	printf("# round trip cnt2utc then utc2cnt: max difference %i us, %li over %i us or rejected\n", rt_max, nb_rt_err, ERR_MAX_US);
+	printf("##### END #####\n");
+	return ((nb_err > 0) || (nb_tx_err > 0) || (nb_rt_err > 0) || (nb_hal_err > 0)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,203 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	Fixed-point conversions between concentrator timestamps and UTC time, with
+	a GPS time reference, and parsing of RFC 3339 UTC times
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "time_ref.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/* same limits as the HAL, a reference outside is not used */
+#define XERR_MIN	0.99999
+#define XERR_MAX	1.00001
+
+#define NS_PER_SEC	1000000000
+
+#define US_MAX		4294967296LL /* one period of the 32-bit microsecond counter */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int32_t q32(double x);
+
+static const char * digits(const char * s, int nb, int * v);
+
+static int64_t days_from_civil(int y, int m, int d);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* rounded, no libm needed */
+static int32_t q32(double x) {
+	x *= 4294967296.0;
+	return (int32_t)((x < 0) ? (x - 0.5) : (x + 0.5));
+}
+
+/* exactly nb decimal digits, returns the end of the field or NULL */
+static const char * digits(const char * s, int nb, int * v) {
+	*v = 0;
+	for (; nb > 0; --nb, ++s) {
+		if ((*s < '0') || (*s > '9')) {
+			return NULL;
+		}
+		*v = (*v * 10) + (*s - '0');
+	}
+	return s;
+}
+
+/* days since 1970-01-01 of a date of the proleptic Gregorian calendar (eras of 400 years, years starting in March) */
+static int64_t days_from_civil(int y, int m, int d) {
+	int era, yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = ((y >= 0) ? y : (y - 399)) / 400;
+	yoe = y - era * 400; /* 0-399 */
+	doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + d - 1; /* 0-365 */
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy; /* 0-146096 */
+	return (int64_t)era * 146097 + doe - 719468;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+bool time_ref_init(struct time_ref_s * tr, const struct tref * ref) {
+	if ((ref->systime == 0) || (ref->xtal_err > XERR_MAX) || (ref->xtal_err < XERR_MIN)) {
+		return false;
+	}
+	if ((ref->utc.tv_nsec < 0) || (ref->utc.tv_nsec >= NS_PER_SEC)) {
+		return false;
+	}
+	tr->count_us = ref->count_us;
+	tr->sec = ref->utc.tv_sec;
+	tr->nsec = (int32_t)ref->utc.tv_nsec;
+
+	/* at most +/-0.01 ns per microsecond, 1 ns of error over the 72 minutes of the counter */
+	tr->drift_q32 = q32(1000.0 / ref->xtal_err - 1000.0);
+	tr->skew_q32 = q32(1000.0 * ref->xtal_err - 1000.0);
+	return true;
+}
+
+void time_ref_cnt2utc(const struct time_ref_s * tr, const uint32_t * count_us, struct timespec * utc, int nb) {
+	uint32_t delta, sec;
+	int32_t nsec, carry;
+	int i;
+
+	for (i = 0; i < nb; ++i) {
+		delta = count_us[i] - tr->count_us; /* modulo 2^32, a wrapped counter is later than the reference */
+		sec = delta / 1000000;
+		/* below 2.05e9 with a normalized reference, the carry is -1 to 2 seconds */
+		nsec = tr->nsec + (int32_t)(delta - sec * 1000000) * 1000 + (int32_t)(((int64_t)delta * tr->drift_q32) >> 32);
+		carry = (nsec >= NS_PER_SEC) + (nsec >= 2 * NS_PER_SEC) - (nsec < 0);
+		utc[i].tv_sec = tr->sec + (time_t)sec + carry;
+		utc[i].tv_nsec = nsec - carry * NS_PER_SEC;
+	}
+}
+
+bool time_ref_utc2cnt(const struct time_ref_s * tr, const struct timespec * utc, uint32_t * count_us) {
+	int64_t delta_ns, delta_us;
+
+	delta_ns = (int64_t)(utc->tv_sec - tr->sec) * NS_PER_SEC + (utc->tv_nsec - tr->nsec);
+	delta_us = delta_ns / 1000;
+	if ((delta_us > US_MAX) || (delta_us < -US_MAX)) {
+		return false;
+	}
+	/* truncated to the microsecond, as lgw_utc2cnt, and modulo 2^32 */
+	*count_us = tr->count_us + (uint32_t)((delta_ns + ((delta_us * tr->skew_q32) >> 32)) / 1000);
+	return true;
+}
+
+bool time_ref_parse(const char * str, struct timespec * utc) {
+	static const char layout[] = "0000-00-00T00:00:00"; /* '0' for a digit */
+	static const uint8_t mdays[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	int year, mon, day, hour, min, sec;
+	int off = 0; /* time offset, minutes */
+	int32_t nsec = 0;
+	int32_t scale = NS_PER_SEC / 10;
+	int64_t t;
+	const char * s;
+	int i;
+
+	/* fixed part, 'T' may also be 't' or a space (RFC 3339, section 5.6) */
+	for (i = 0; layout[i] != 0; ++i) {
+		if (layout[i] == '0') {
+			if ((str[i] < '0') || (str[i] > '9')) {
+				return false;
+			}
+		} else if ((str[i] != layout[i]) && !((layout[i] == 'T') && ((str[i] == 't') || (str[i] == ' ')))) {
+			return false;
+		}
+	}
+	digits(str, 4, &year);
+	digits(str + 5, 2, &mon);
+	digits(str + 8, 2, &day);
+	digits(str + 11, 2, &hour);
+	digits(str + 14, 2, &min);
+	digits(str + 17, 2, &sec);
+	s = str + i;
+
+	/* fraction of second, digits beyond the nanosecond are ignored */
+	if (*s == '.') {
+		++s;
+		if ((*s < '0') || (*s > '9')) {
+			return false;
+		}
+		for (; (*s >= '0') && (*s <= '9'); ++s) {
+			nsec += (*s - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	/* "Z", "+hh:mm", "-hh:mm", or nothing for UTC */
+	if ((*s == 'Z') || (*s == 'z')) {
+		++s;
+	} else if ((*s == '+') || (*s == '-')) {
+		if ((digits(s + 1, 2, &i) == NULL) || (i > 23) || (s[3] != ':')) {
+			return false;
+		}
+		off = i * 60;
+		if ((digits(s + 4, 2, &i) == NULL) || (i > 59)) {
+			return false;
+		}
+		off = (*s == '-') ? -(off + i) : (off + i);
+		s += 6;
+	}
+	if (*s != 0) {
+		return false;
+	}
+
+	/* second 60 is a leap second, counted as the first second of the next minute (POSIX time) */
+	if ((mon < 1) || (mon > 12) || (day < 1) || (day > mdays[mon - 1]) || (hour > 23) || (min > 59) || (sec > 60)) {
+		return false;
+	}
+	if ((mon == 2) && (day == 29) && (((year % 4) != 0) || (((year % 100) == 0) && ((year % 400) != 0)))) {
+		return false;
+	}
+
+	t = days_from_civil(year, mon, day) * 86400 + hour * 3600 + (min - off) * 60 + sec;
+	utc->tv_sec = (time_t)t;
+	if ((int64_t)utc->tv_sec != t) {
+		return false; /* beyond 2038 with a 32-bit time_t */
+	}
+	utc->tv_nsec = nsec;
+	return true;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
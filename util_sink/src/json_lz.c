@@ -0,0 +1,196 @@
+/*
+  (C)2026 SemtechKerlinkLoRaPacketForwarder-patched contributors
+
+Description:
+	LZ77 compression of the JSON body of PUSH_DATA datagrams, with a preset
+	dictionary of the keys and common values of the rxpk objects
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: SemtechKerlinkLoRaPacketForwarder-patched contributors
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>		/* memset, memcpy */
+
+#include "json_lz.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NIL			0xFFFF /* no position */
+#define MIN_MATCH	4 /* a match costs 3 bytes */
+#define MAX_MATCH	(0x7F + MIN_MATCH)
+#define MAX_LITERAL	0x80
+
+/* rxpk dictionary: keys and usual values of the rxpk (and stat) objects, other bands first, a typical EU868 object last; changing it requires a new identifier */
+static const char rxpk_dict[] =
+	"\"stat\":{\"time\":\"\",\"rxnb\":0,\"rxok\":0,\"rxfw\":0,\"ackr\":100.0,\"dwnb\":0,\"txnb\":0}"
+	"\"freq\":470.300000\"freq\":433.175000\"freq\":923.200000\"freq\":902.300000\"freq\":903.900000"
+	"\"freq\":904.600000\"freq\":905.300000\"freq\":868.800000,\"stat\":1,\"modu\":\"FSK\",\"datr\":50000,"
+	"\"datr\":\"SF8BW500\"\"datr\":\"SF10BW500\"\"datr\":\"SF12BW500\"\"datr\":\"SF7BW250\""
+	"\"codr\":\"4/8\"\"codr\":\"4/7\"\"codr\":\"4/6\"\"codr\":\"OFF\",\"stat\":-1,\"stat\":0,\"rfch\":1,"
+	"\"freq\":867.100000,\"freq\":867.300000,\"freq\":867.500000,\"freq\":867.700000,\"freq\":867.900000,"
+	"\"data\":\"AAEAAAAAAAAA\"\"data\":\"gA\"\"data\":\"QA\"\"data\":\"QAE\"\"data\":\"YA\""
+	"\"datr\":\"SF12BW125\"\"datr\":\"SF11BW125\"\"datr\":\"SF10BW125\"\"datr\":\"SF9BW125\"\"datr\":\"SF8BW125\""
+	",\"rssi\":-10,\"rssi\":-9,\"rssi\":-11,\"lsnr\":-1,\"lsnr\":1,\"size\":2,\"size\":1"
+	"{\"rxpk\":[{\"tmst\":3,\"time\":\"20T00:00:00.000000Z\",\"chan\":0,\"rfch\":0,\"freq\":868.300000,\"stat\":1,"
+	"\"modu\":\"LORA\",\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"lsnr\":9.5,\"rssi\":-10,\"size\":2,\"data\":\"Q\"}]}"
+	"},{\"tmst\":1,\"time\":\"20\",\"chan\":1,\"rfch\":0,\"freq\":868.100000,\"stat\":1,\"modu\":\"LORA\",\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"lsnr\":";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static unsigned hash4(const uint8_t * p);
+
+static void insert(struct json_lz_s * lz, unsigned pos);
+
+static int put_literals(uint8_t * dst, int o, int dst_max, const uint8_t * src, unsigned nb);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static unsigned hash4(const uint8_t * p) {
+	uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+
+	return (unsigned)((v * 2654435761u) >> (32 - JSON_LZ_HASH_BITS));
+}
+
+static void insert(struct json_lz_s * lz, unsigned pos) {
+	unsigned h = hash4(lz->buff + pos);
+
+	lz->prev[pos] = lz->head[h];
+	lz->head[h] = (uint16_t)pos;
+}
+
+/* literal runs of 1 to 128 bytes, one control byte each */
+static int put_literals(uint8_t * dst, int o, int dst_max, const uint8_t * src, unsigned nb) {
+	unsigned run;
+
+	while (nb > 0) {
+		run = (nb > MAX_LITERAL) ? MAX_LITERAL : nb;
+		if (o + 1 + (int)run > dst_max) {
+			return -1;
+		}
+		dst[o++] = (uint8_t)(run - 1);
+		memcpy(dst + o, src, run);
+		o += run;
+		src += run;
+		nb -= run;
+	}
+	return o;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void json_lz_init(struct json_lz_s * lz, unsigned level) {
+	unsigned i;
+
+	lz->level = (level < 1) ? 1 : ((level > JSON_LZ_LEVEL_MAX) ? JSON_LZ_LEVEL_MAX : level);
+	lz->dict_len = sizeof rxpk_dict - 1;
+	memcpy(lz->buff, rxpk_dict, lz->dict_len);
+	memset(lz->head, 0xFF, sizeof lz->head); /* all NIL */
+	for (i = 0; i + MIN_MATCH <= lz->dict_len; ++i) {
+		insert(lz, i);
+	}
+	memcpy(lz->dict_head, lz->head, sizeof lz->dict_head); /* the chains of the data only grow from there */
+}
+
+int json_lz_compress(struct json_lz_s * lz, const uint8_t * src, int size, uint8_t * dst, int dst_max) {
+	unsigned n = lz->dict_len + (unsigned)size;
+	unsigned i = lz->dict_len;
+	unsigned lit = i; /* start of the pending literals */
+	unsigned cand, chain, len, max_len, k;
+	unsigned best_len, best_dist = 0;
+	uint8_t * b = lz->buff;
+	int o = 0;
+
+	if ((size < 0) || (n > JSON_LZ_WINDOW)) {
+		return -1;
+	}
+	memcpy(b + lz->dict_len, src, size);
+	memcpy(lz->head, lz->dict_head, sizeof lz->head);
+
+	while (i + MIN_MATCH <= n) {
+		/* longest match among the last candidates with the same hash */
+		max_len = ((n - i) < MAX_MATCH) ? (n - i) : MAX_MATCH;
+		best_len = 0;
+		cand = lz->head[hash4(b + i)];
+		for (chain = lz->level; (cand != NIL) && (chain > 0); --chain, cand = lz->prev[cand]) {
+			if (b[cand + best_len] != b[i + best_len]) {
+				continue; /* cannot be longer than the best one */
+			}
+			for (len = 0; (len < max_len) && (b[cand + len] == b[i + len]); ++len);
+			if (len > best_len) {
+				best_len = len;
+				best_dist = i - cand;
+				if (len == max_len) {
+					break;
+				}
+			}
+		}
+		insert(lz, i);
+		if (best_len < MIN_MATCH) {
+			++i;
+			continue;
+		}
+
+		/* pending literals, then the match: control byte and distance */
+		o = put_literals(dst, o, dst_max, b + lit, i - lit);
+		if ((o < 0) || (o + 3 > dst_max)) {
+			return -1;
+		}
+		dst[o++] = (uint8_t)(0x80 | (best_len - MIN_MATCH));
+		dst[o++] = (uint8_t)best_dist;
+		dst[o++] = (uint8_t)(best_dist >> 8);
+		for (k = i + 1; (k < i + best_len) && (k + MIN_MATCH <= n); ++k) {
+			insert(lz, k);
+		}
+		i += best_len;
+		lit = i;
+	}
+	return put_literals(dst, o, dst_max, b + lit, n - lit);
+}
+
+int json_lz_decompress(int dict, const uint8_t * src, int size, uint8_t * dst, int dst_max) {
+	const unsigned dict_len = sizeof rxpk_dict - 1;
+	unsigned c, len, dist, k;
+	int i = 0;
+	int o = 0;
+
+	if (dict != JSON_LZ_DICT_RXPK) {
+		return -1;
+	}
+	while (i < size) {
+		c = src[i++];
+		if (c < 0x80) {
+			len = c + 1;
+			if ((i + (int)len > size) || (o + (int)len > dst_max)) {
+				return -1;
+			}
+			memcpy(dst + o, src + i, len);
+			i += len;
+			o += len;
+		} else {
+			len = (c & 0x7F) + MIN_MATCH;
+			if (i + 2 > size) {
+				return -1;
+			}
+			dist = (unsigned)src[i] | ((unsigned)src[i + 1] << 8);
+			i += 2;
+			if ((dist == 0) || (dist > (unsigned)o + dict_len) || (o + (int)len > dst_max)) {
+				return -1;
+			}
+			/* byte by byte, a match can overlap its own output */
+			for (k = 0; k < len; ++k, ++o) {
+				dst[o] = (dist > (unsigned)o) ? (uint8_t)rxpk_dict[dict_len - (dist - o)] : dst[o - dist];
+			}
+		}
+	}
+	return o;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -8,6 +8,8 @@
 
 Description:
 	Network sink, receives UDP packets on certain ports and discards them
+	Binary PUSH_DATA_BIN and compressed PUSH_DATA_LZ datagrams are decoded
+	(and acknowledged) to validate those encodings of a packet forwarder
 
 License: Revised BSD License, see LICENSE.TXT file include in the project
 Maintainer: Sylvain Miermont
@@ -25,6 +27,7 @@ Maintainer: Sylvain Miermont
 #endif
 
 #include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
 #include <stdio.h>		/* printf, fprintf, sprintf, fopen, fputs */
 
 #include <string.h>		/* memset */
@@ -37,6 +40,8 @@ Maintainer: Sylvain Miermont
 #include <arpa/inet.h>  /* IP address conversion stuff */
 #include <netdb.h>		/* gai_strerror */
 
+#include "json_lz.h"
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
@@ -45,6 +50,167 @@ Maintainer: Sylvain Miermont
 #define STR(x)			STRINGIFY(x)
 #define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define PROTOCOL_VERSION	1
+#define PKT_PUSH_DATA		0
+#define PKT_PUSH_ACK		1
+#define PKT_PUSH_DATA_BIN	6
+#define PKT_PUSH_DATA_LZ	7
+
+/* binary record header, byte 0 */
+#define BIN_STAT_MASK		0x03
+#define BIN_FSK				0x04
+#define BIN_TIME			0x08
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+/* totals by encoding, to compare the bytes per packet */
+static unsigned long json_pkt = 0;
+static unsigned long json_byte = 0;
+static unsigned long bin_pkt = 0;
+static unsigned long bin_byte = 0;
+static unsigned long lz_pkt = 0;
+static unsigned long lz_byte = 0;
+static unsigned long lz_json_byte = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* read a varint (7 bits per byte, least significant group first), returns false if truncated */
+static bool get_varint(const uint8_t * buff, int size, int * idx, uint64_t * v) {
+	int shift = 0;
+	
+	*v = 0;
+	while ((*idx < size) && (shift < 64)) {
+		*v |= (uint64_t)(buff[*idx] & 0x7F) << shift;
+		shift += 7;
+		if ((buff[(*idx)++] & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int64_t unzigzag(uint64_t v) {
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* count the rxpk objects of a JSON PUSH_DATA body (null terminated), the JSON is not decoded */
+static int count_rxpk(const uint8_t * json) {
+	const char * p = (const char *)json;
+	int nb_pkt = 0;
+	
+	while ((p = strstr(p, "\"tmst\"")) != NULL) {
+		++nb_pkt;
+		++p;
+	}
+	return nb_pkt;
+}
+
+/* decompress a PUSH_DATA_LZ into json (null terminated), returns the number of packets or -1 if the datagram is invalid, 0 for a probe */
+static int decode_push_data_lz(const uint8_t * buff, int size, uint8_t * json, int json_max) {
+	int json_size;
+	
+	if (size == 12) {
+		return 0; /* empty probe */
+	}
+	if (size < 15) {
+		printf("  PUSH_DATA_LZ: truncated header\n");
+		return -1;
+	}
+	json_size = buff[13] | (buff[14] << 8);
+	if (buff[12] != JSON_LZ_DICT_RXPK) {
+		printf("  PUSH_DATA_LZ: unknown dictionary %u\n", buff[12]);
+		return -1;
+	}
+	if (json_lz_decompress(buff[12], buff + 15, size - 15, json, json_max - 1) != json_size) {
+		printf("  PUSH_DATA_LZ: invalid stream or size (%i bytes announced)\n", json_size);
+		return -1;
+	}
+	json[json_size] = 0;
+	return count_rxpk(json);
+}
+
+/* decode and display the records of a PUSH_DATA_BIN, returns the number of packets or -1 if the datagram is invalid */
+static int decode_push_data_bin(const uint8_t * buff, int size) {
+	static const char * const stat_str[4] = {"1", "-1", "0", "?"};
+	static const char * const bw_str[4] = {"125", "250", "500", "?"};
+	static const char * const codr_str[8] = {"OFF", "4/5", "4/6", "4/7", "4/8", "?", "?", "?"};
+	int idx = 12;
+	int nb_pkt = 0;
+	int j;
+	const uint8_t * h;
+	uint64_t v;
+	uint32_t tmst = 0;
+	uint64_t time_us = 0;
+	uint32_t freq_hz = 0;
+	uint64_t datarate = 0;
+	uint64_t pl_size;
+	time_t t;
+	struct tm * x;
+	char time_str[96];
+	
+	while (idx < size) {
+		/* fixed header */
+		if (idx + 7 > size) {
+			MSG("ERROR: record %i truncated in its header\n", nb_pkt);
+			return -1;
+		}
+		h = buff + idx;
+		idx += 7;
+	
+		/* varint fields, coded as differences with the previous record */
+		if (!get_varint(buff, size, &idx, &v)) {
+			MSG("ERROR: record %i truncated in tmst\n", nb_pkt);
+			return -1;
+		}
+		tmst += (uint32_t)unzigzag(v);
+		time_str[0] = 0;
+		if (h[0] & BIN_TIME) {
+			if (!get_varint(buff, size, &idx, &v)) {
+				MSG("ERROR: record %i truncated in time\n", nb_pkt);
+				return -1;
+			}
+			time_us += (uint64_t)unzigzag(v);
+			t = (time_t)(time_us / 1000000);
+			x = gmtime(&t);
+			snprintf(time_str, sizeof time_str, " time %04i-%02i-%02iT%02i:%02i:%02i.%06uZ", x->tm_year + 1900, x->tm_mon + 1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (unsigned)(time_us % 1000000));
+		}
+		if (!get_varint(buff, size, &idx, &v)) {
+			MSG("ERROR: record %i truncated in freq\n", nb_pkt);
+			return -1;
+		}
+		freq_hz += (uint32_t)unzigzag(v);
+		if ((h[0] & BIN_FSK) && !get_varint(buff, size, &idx, &datarate)) {
+			MSG("ERROR: record %i truncated in datarate\n", nb_pkt);
+			return -1;
+		}
+		if (!get_varint(buff, size, &idx, &pl_size) || (pl_size > 255) || (idx + (int)pl_size > size)) {
+			MSG("ERROR: record %i truncated in its payload\n", nb_pkt);
+			return -1;
+		}
+	
+		/* same fields and units as the JSON rxpk object */
+		printf("  rxpk %i: tmst %u%s chan %u rfch %u freq %.6f stat %s", nb_pkt, tmst, time_str, h[1] & 0x0F, (h[1] >> 4) & 0x01, (double)freq_hz / 1e6, stat_str[h[0] & BIN_STAT_MASK]);
+		if (h[0] & BIN_FSK) {
+			printf(" modu FSK datr %llu", (unsigned long long)datarate);
+		} else {
+			printf(" modu LORA datr SF%uBW%s codr %s lsnr %.1f", h[2] & 0x0F, bw_str[(h[2] >> 4) & 0x03], codr_str[h[3] & 0x07], (double)(int16_t)(h[5] | (h[6] << 8)) / 10);
+		}
+		printf(" rssi %i size %u data ", -(int)h[4], (unsigned)pl_size);
+		for (j = 0; j < (int)pl_size; ++j) {
+			printf("%02X", buff[idx + j]);
+		}
+		printf("\n");
+		idx += (int)pl_size;
+		++nb_pkt;
+	}
+	return nb_pkt;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
 
@@ -64,7 +230,10 @@ int main(int argc, char **argv)
 	struct sockaddr_storage dist_addr;
 	socklen_t addr_len = sizeof dist_addr;
 	uint8_t databuf[4096];
+	uint8_t jsonbuf[8192]; /* decompressed PUSH_DATA_LZ */
 	int byte_nb;
+	int nb_pkt;
+	uint8_t ack[4];
 	
 	/* check if port number was passed as parameter */
 	if (argc != 2) {
@@ -114,12 +283,61 @@ int main(int argc, char **argv)
 	freeaddrinfo(result);
 	
 	while (1) {
-		byte_nb = recvfrom(sock, databuf, sizeof databuf, 0, (struct sockaddr *)&dist_addr, &addr_len);
+		byte_nb = recvfrom(sock, databuf, sizeof databuf - 1, 0, (struct sockaddr *)&dist_addr, &addr_len);
 		if (byte_nb == -1) {
 			MSG("ERROR: recvfrom returned %s \n", strerror(errno));
 			exit(EXIT_FAILURE);
 		}
 		getnameinfo((struct sockaddr *)&dist_addr, addr_len, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST);
 		printf("Got packet from host %s port %s, %i bytes long\n", host_name, port_name, byte_nb);
+		if ((byte_nb < 12) || (databuf[0] != PROTOCOL_VERSION)) {
+			continue;
+		}
+		
+		if (databuf[3] == PKT_PUSH_DATA) {
+			/* JSON is not decoded, only the rxpk objects are counted */
+			databuf[byte_nb] = 0;
+			nb_pkt = count_rxpk(databuf + 12);
+			if (nb_pkt > 0) {
+				json_pkt += nb_pkt;
+				json_byte += byte_nb;
+				printf("  PUSH_DATA: %i packets, %.1f bytes/packet (total JSON: %lu packets, %.1f bytes/packet)\n", nb_pkt, (double)byte_nb / nb_pkt, json_pkt, (double)json_byte / json_pkt);
+			}
+		} else if (databuf[3] == PKT_PUSH_DATA_BIN) {
+			nb_pkt = decode_push_data_bin(databuf, byte_nb);
+			if (nb_pkt < 0) {
+				continue; /* not acknowledged, the forwarder goes back to JSON */
+			}
+			if (nb_pkt > 0) {
+				bin_pkt += nb_pkt;
+				bin_byte += byte_nb;
+				printf("  PUSH_DATA_BIN: %i packets, %.1f bytes/packet (total binary: %lu packets, %.1f bytes/packet)\n", nb_pkt, (double)byte_nb / nb_pkt, bin_pkt, (double)bin_byte / bin_pkt);
+			}
+			
+			/* acknowledge binary datagrams (probes included), the forwarder keeps using that encoding */
+			ack[0] = PROTOCOL_VERSION;
+			ack[1] = databuf[1];
+			ack[2] = databuf[2];
+			ack[3] = PKT_PUSH_ACK;
+			sendto(sock, (void *)ack, sizeof ack, 0, (struct sockaddr *)&dist_addr, addr_len);
+		} else if (databuf[3] == PKT_PUSH_DATA_LZ) {
+			nb_pkt = decode_push_data_lz(databuf, byte_nb, jsonbuf, sizeof jsonbuf);
+			if (nb_pkt < 0) {
+				continue; /* not acknowledged, the forwarder goes back to JSON */
+			}
+			if (nb_pkt > 0) {
+				lz_pkt += nb_pkt;
+				lz_byte += byte_nb;
+				lz_json_byte += 12 + (databuf[13] | (databuf[14] << 8));
+				printf("  PUSH_DATA_LZ: %i packets, %.1f bytes/packet, ratio %.2f (total compressed: %lu packets, %.1f bytes/packet, ratio %.2f)\n", nb_pkt, (double)byte_nb / nb_pkt, (double)(12 + (databuf[13] | (databuf[14] << 8))) / byte_nb, lz_pkt, (double)lz_byte / lz_pkt, (double)lz_json_byte / lz_byte);
+			}
+			
+			/* acknowledge compressed datagrams (probes included), the forwarder keeps using that encoding */
+			ack[0] = PROTOCOL_VERSION;
+			ack[1] = databuf[1];
+			ack[2] = databuf[2];
+			ack[3] = PKT_PUSH_ACK;
+			sendto(sock, (void *)ack, sizeof ack, 0, (struct sockaddr *)&dist_addr, addr_len);
+		}
 	}
 }